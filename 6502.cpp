@@ -1,595 +1,1082 @@
 #include "6502.h"
 
+// Execute() keeps the registers and the cycle budget in locals the compiler can hold in host
+// registers. That only works while their addresses never leave this file, so the helpers
+// taking them are always inlined and calls into other modules get copies.
+#ifdef _MSC_VER
+#define FORCE_INLINE __forceinline
+#else
+#define FORCE_INLINE inline __attribute__((always_inline))
+#endif
 
-static byte FetchByte(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+
+static FORCE_INLINE byte FetchByte(struct CPU* cpu, struct memory* mem, size_t* Cycles)
 {
-	byte Data = mem->Data[cpu->pc++];
+	const word Address = cpu->pc++;
 	(*Cycles)--;
-	return Data;
+	if (mem->PageFlags[Address >> 8] & PAGE_BANK)
+	{
+		return MapperRead(mem, Address);
+	}
+	return mem->Data[Address];
 }
 
 
-static byte ReadByte(const word Address, struct memory* mem, size_t* Cycles)
+static FORCE_INLINE byte ReadByte(const word Address, struct memory* mem, size_t* Cycles)
 {
-	byte Data = mem->Data[Address];
 	(*Cycles)--;
-	return Data;
+	if (mem->PageFlags[Address >> 8] & PAGE_READ_SLOW)
+	{
+		return BusRead(mem, Address, *Cycles);
+	}
+	return mem->Data[Address];
 }
 
 
-static void WriteByte(const word Address, const word data, struct memory* mem, size_t* Cycles)
+static FORCE_INLINE void WriteByte(const word Address, const word data, struct memory* mem, size_t* Cycles)
 {
-	mem->Data[Address] = data;
 	(*Cycles)--;
+	if (mem->PageFlags[Address >> 8] & PAGE_WRITE_SLOW)
+	{
+		BusWrite(mem, Address, data, *Cycles);
+		return;
+	}
+	mem->Data[Address] = data;
 }
 
-static word FetchWord(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+static FORCE_INLINE word FetchWord(struct CPU* cpu, struct memory* mem, size_t* Cycles)
 {
-	word Data = mem->Data[cpu->pc];
-	cpu->pc++;
-
-	Data |= (mem->Data[cpu->pc] << 8);
-	cpu->pc++;
-	(*Cycles) -= 2;
+	word Data = FetchByte(cpu, mem, Cycles);
+	Data |= FetchByte(cpu, mem, Cycles) << 8;
 	return Data;
 }
 
-void WriteWord(const word Address, const word data, struct memory* mem, size_t* Cycles)
+static FORCE_INLINE void StoreWord(const word Address, const word data, struct memory* mem, size_t* Cycles)
 {
-	mem->Data[Address] = data & 0x00FF;
-	mem->Data[Address + 1] = data >> 8;
-	(*Cycles) -= 2;
+	WriteByte(Address, data & 0x00FF, mem, Cycles);
+	WriteByte(Address + 1, data >> 8, mem, Cycles);
 }
 
-word ReadWord(struct memory* mem, const word Address, size_t* cycles)
+static FORCE_INLINE word LoadWord(struct memory* mem, const word Address, size_t* cycles)
 {
 	byte LowByte = ReadByte(Address, mem, cycles);
 	byte HighByte = ReadByte(Address + 1, mem, cycles);
 	return LowByte | (HighByte << 8);
 }
 
-static void SetStatusFlags(struct CPU* cpu, const byte reg)
+static FORCE_INLINE void SetStatusFlags(struct CPU* cpu, const byte reg)
 {
 	cpu->Flags[zeroFlag] = (reg == 0);
 	cpu->Flags[negativeFlag - 1] = (reg & 0x80) > 0; // not working because number that are bigger than 128 will detect as negative
 }
 
-static byte ZeroPage(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+static FORCE_INLINE word StackAddress(const struct CPU* cpu)
+{
+	return 0x100 | cpu->sp;
+}
+
+static FORCE_INLINE void PushByte(const byte Value, struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	(*Cycles) -= 2;
+	if (mem->PageFlags[StackAddress(cpu) >> 8] & PAGE_WRITE_SLOW)
+	{
+		BusWrite(mem, StackAddress(cpu), Value, *Cycles);
+	}
+	else
+	{
+		mem->Data[StackAddress(cpu)] = Value;
+	}
+	cpu->sp--;
+}
+
+static FORCE_INLINE byte PullByte(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	(*Cycles)--;
+	cpu->sp++;
+	return mem->PageFlags[StackAddress(cpu) >> 8] & PAGE_READ_SLOW ? BusRead(mem, StackAddress(cpu), *Cycles) : mem->Data[StackAddress(cpu)];
+}
+
+// JSR pushes the address of its last byte, RTS adds the one back
+static FORCE_INLINE void PushReturn(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	StoreWord(StackAddress(cpu) - 1, cpu->pc - 1, mem, Cycles);
+	cpu->sp -= 2;
+}
+
+static FORCE_INLINE word PullWord(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	word Value = LoadWord(mem, StackAddress(cpu) + 1, Cycles);
+	cpu->sp += 2;
+	(*Cycles)--;
+	return Value;
+}
+
+// Hands the registers to code outside this file, which works on the caller's CPU. Reload
+// them with *cpu = *Host after anything that may change them.
+static FORCE_INLINE struct CPU* Spill(struct CPU* Host, const struct CPU* cpu)
+{
+	*Host = *cpu;
+	return Host;
+}
+
+static FORCE_INLINE byte ZeroPage(struct CPU* cpu, struct memory* mem, size_t* Cycles)
 {
 	byte ZeroPageAddress = FetchByte(cpu, mem, Cycles);
 	return ReadByte(ZeroPageAddress, mem, Cycles);
 }
 
-static byte ZeroPageX(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+static FORCE_INLINE byte ZeroPageX(struct CPU* cpu, struct memory* mem, size_t* Cycles)
 {
 	byte ZeroPageAddress = FetchByte(cpu, mem, Cycles);
 	ZeroPageAddress += cpu->x;
-	Cycles--;
+	(*Cycles)--;
 	return ReadByte(ZeroPageAddress, mem, Cycles);
 }
 
-static byte ZeroPageY(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+static FORCE_INLINE byte ZeroPageY(struct CPU* cpu, struct memory* mem, size_t* Cycles)
 {
 	byte ZeroPageAddress = FetchByte(cpu, mem, Cycles);
 	ZeroPageAddress += cpu->y;
-	Cycles--;
+	(*Cycles)--;
 	return ReadByte(ZeroPageAddress, mem, Cycles);
 }
 
 
-static byte Absolute(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+static FORCE_INLINE byte Absolute(struct CPU* cpu, struct memory* mem, size_t* Cycles)
 {
 	word AbsAddress = FetchWord(cpu, mem, Cycles);
 	return ReadByte(AbsAddress, mem, Cycles);
 }
 
 
-void ResetCpu(struct CPU* cpu, struct memory* mem)
+// abs,X / abs,Y loads, one cycle more when the index crosses a page
+static FORCE_INLINE byte AbsoluteIndexed(struct CPU* cpu, struct memory* mem, const byte Index, size_t* Cycles)
 {
-	cpu->pc = 0xFFFC;
-	cpu->sp = 0xFF;
-	cpu->acc = cpu->x = cpu->y = 0;
+	word AbsAddress = FetchWord(cpu, mem, Cycles);
+	word AbsAddressIndexed = AbsAddress + Index;
+	byte Data = ReadByte(AbsAddressIndexed, mem, Cycles);
+	if (AbsAddressIndexed - AbsAddress >= 0xFF)
+	{
+		(*Cycles)--;
+	}
+	return Data;
+}
 
-	memset(cpu->Flags, 0, sizeof(cpu->Flags));
-	memset(mem->Data, 0, sizeof(mem->Data));
-	
-	memset(mem->Data, 0, sizeof(mem->Data));
+static FORCE_INLINE byte IndirectY(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	byte ZeroPageAddress = FetchByte(cpu, mem, Cycles);
+	word EffectiveAddress = LoadWord(mem, ZeroPageAddress, Cycles);
+	byte Data = ReadByte(EffectiveAddress + cpu->y, mem, Cycles);
+	if ((EffectiveAddress + cpu->y) - EffectiveAddress >= 0xFF)
+	{
+		(*Cycles)--;
+	}
+	return Data;
 }
 
-uint32_t Execute(struct CPU* cpu, struct memory* mem, uint32_t cycles)
+// Edge coverage for fuzzing: AFL's prev ^ cur scheme over control transfer targets
+static void CoverEdge(struct memory* mem, const word Target)
 {
-	const size_t numCycles = cycles;
-	while (cycles > 0)
+	if (mem->Coverage)
 	{
-		byte Instruction = FetchByte(cpu, mem, &cycles);
+		const word Location = Target * 40503u;
+		byte* Counter = &mem->Coverage[Location ^ mem->CoveragePrev];
+		*Counter += 1 + (*Counter == 0xFF);	// never wraps back to zero
+		mem->CoveragePrev = Location >> 1;
+	}
+}
 
-		switch (Instruction)
-		{
-		case LDA_IM:
-		{
-			cpu->acc = FetchByte(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case LDA_ZP:
-		{
-			cpu->acc = ZeroPage(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case LDA_ZPX:
-		{
-			cpu->acc = ZeroPageX(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case LDA_ABS:
-		{
-			cpu->acc = Absolute(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case LDA_ABSX:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressX = AbsAddress + cpu->x;
-			cpu->acc = ReadByte(AbsAddressX, mem, &cycles);
-			if (AbsAddressX - AbsAddress >= 0xFF)
-			{
-				cycles--;
-			}
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case LDA_ABSY:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressY = AbsAddress + cpu->y;
-			cpu->acc = ReadByte(AbsAddressY, mem, &cycles);
-			if (AbsAddressY - AbsAddress >= 0xFF)
-			{
-				cycles--;
-			}
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case LDA_INDX:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			ZeroPageAddress += cpu->x;
-			cycles--;
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			cpu->acc = ReadByte(EffectiveAddress, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case LDA_INDY:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			cpu->acc = ReadByte(EffectiveAddress + cpu->y, mem, &cycles);
-			if ((EffectiveAddress + cpu->y) - EffectiveAddress > 0xFF)
-			{
-				cycles--;
-			}
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case LDX_IM:
-		{
-			cpu->x = FetchByte(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case LDX_ZP:
-		{
-			cpu->x = ZeroPage(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case LDX_ZPY:
-		{
-			cpu->x = ZeroPageY(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case LDX_ABS:
+// BEQ/BNE once the opcode is fetched. Backward branches are where the loop recognizers look,
+// only BNE closes the copy and fill loops RunBulkLoop() knows.
+static FORCE_INLINE void Branch(struct CPU* cpu, struct CPU* Host, struct memory* mem, const bool Condition, const bool BulkLoops, size_t* Cycles)
+{
+	byte offset = FetchByte(cpu, mem, Cycles);
+	if (Condition)
+	{
+		const word PCold = cpu->pc;
+		cpu->pc += (int8_t)offset;
+		(*Cycles)--;
+
+		const bool PageChanged = (cpu->pc >> 8) != (PCold >> 8);
+		if (PageChanged)
 		{
-			cpu->x = Absolute(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case LDX_ABSY:
+			(*Cycles) -= 2;
+		}
+		CoverEdge(mem, cpu->pc);
+		if (cpu->pc < PCold)
 		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressY = AbsAddress + cpu->y;
-			cpu->x = ReadByte(AbsAddressY, mem, &cycles);
-			if (AbsAddressY - AbsAddress >= 0xFF)
+			size_t Left = *Cycles;
+			if (BulkLoops && RunBulkLoop(Spill(Host, cpu), mem, PCold - 2, &Left))
 			{
-				cycles--;
+				*cpu = *Host;
 			}
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case LDY_IM:
-		{
-			cpu->y = FetchByte(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case LDY_ZP:
-		{
-			cpu->y = ZeroPage(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case LDY_ZPX:
-		{
-			cpu->y = ZeroPageX(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case LDY_ABS:
-		{
-			cpu->y = Absolute(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case LDY_ABSX:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressX = AbsAddress + cpu->x;
-			cpu->y = ReadByte(AbsAddressX, mem, &cycles);
-			if (AbsAddressX - AbsAddress >= 0xFF)
+			else
 			{
-				cycles--;
+				SkipIdleLoop(Spill(Host, cpu), mem, PCold - 2, &Left);
 			}
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case STA_ZP:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			WriteByte(ZeroPageAddress, cpu->acc, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case STA_ZPX:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			ZeroPageAddress += cpu->x;
-			WriteByte(ZeroPageAddress, cpu->acc, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case STX_ZP:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			WriteByte(ZeroPageAddress, cpu->x, mem, &cycles);
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case STX_ZPY:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			ZeroPageAddress += cpu->y;
-			WriteByte(ZeroPageAddress, cpu->x, mem, &cycles);
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case STY_ZP:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			WriteByte(ZeroPageAddress, cpu->y, mem, &cycles);
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case STY_ZPX:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			ZeroPageAddress += cpu->x;
-			WriteByte(ZeroPageAddress, cpu->y, mem, &cycles);
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case STA_ABS:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			WriteWord(AbsAddress, cpu->acc, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case STX_ABS:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			WriteWord(AbsAddress, cpu->x, mem, &cycles);
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case STY_ABS:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			WriteWord(AbsAddress, cpu->y, mem, &cycles);
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case STA_ABSX:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressX = AbsAddress + cpu->x;
-			WriteWord(AbsAddressX, cpu->acc, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case STA_ABSY:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressY = AbsAddress + cpu->y;
-			WriteWord(AbsAddressY, cpu->acc, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case STA_INDX:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			ZeroPageAddress += cpu->x;
-			cycles--;
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			WriteByte(EffectiveAddress, cpu->acc, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case STA_INDY:
-		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			WriteByte(EffectiveAddress + cpu->y, cpu->acc, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case TSX:
-		{
-			cpu->x = cpu->sp;
-			cycles--;
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case TXS:
-		{
-			cpu->sp = cpu->x;
-			cycles--;
-		} break;
-		case PHA:
-		{
-			pushByteOntoStack(cpu->acc, cpu, mem, &cycles);
-		} break;
-		case PHP:
-		{
-			pushByteOntoStack(*cpu->Flags, cpu, mem, &cycles);
-		} break;
-		case PLA:
-		{
-			cpu->acc = popByteOntoStack(cpu, mem, &cycles);
-		} break;
-		case PLP:
-		{
-			*cpu->Flags = popByteOntoStack(cpu, mem, &cycles);
-		} break;
-		case AND_IM:
-		{
-			cpu->acc &= FetchByte(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case OR_IM:
-		{
-			cpu->acc |= FetchByte(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case EOR_IM:
-		{
-			cpu->acc ^= FetchByte(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case AND_ZP:
-		{
-			cpu->acc &= ZeroPage(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case OR_ZP:
-		{
-			cpu->acc |= ZeroPage(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case EOR_ZP:
-		{
-			cpu->acc ^= ZeroPage(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case AND_ZPX:
-		{
-			cpu->acc &= ZeroPageX(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case OR_ZPX:
-		{
-			cpu->acc |= ZeroPageX(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case EOR_ZPX:
-		{
-			cpu->acc ^= ZeroPageX(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case AND_ABS:
-		{
-			cpu->acc &= Absolute(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case OR_ABS:
-		{
-			cpu->acc |= Absolute(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case EOR_ABS:
-		{
-			cpu->acc ^= Absolute(cpu, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case AND_ABSX:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressX = AbsAddress + cpu->x;
-			cpu->acc &= ReadByte(AbsAddressX, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case OR_ABSX:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressX = AbsAddress + cpu->x;
-			cpu->acc |= ReadByte(AbsAddressX, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case EOR_ABSX:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressX = AbsAddress + cpu->x;
-			cpu->acc ^= ReadByte(AbsAddressX, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case AND_ABSY:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressY = AbsAddress + cpu->y;
-			cpu->acc &= ReadByte(AbsAddressY, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case OR_ABSY:
-		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressY = AbsAddress + cpu->y;
-			cpu->acc |= ReadByte(AbsAddressY, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case EOR_ABSY:
+			*Cycles = Left;
+		}
+	}
+	else
+	{
+		CoverEdge(mem, cpu->pc);
+	}
+}
+
+static FORCE_INLINE byte PackFlags(struct CPU* cpu, const bool BreakCommand)
+{
+	return cpu->Flags[carryFlag]
+		| (cpu->Flags[zeroFlag] << 1)
+		| (cpu->Flags[interruptDisable] << 2)
+		| (cpu->Flags[decimalMode] << 3)
+		| (BreakCommand << 4)
+		| (1 << 5)
+		| (cpu->Flags[overflowFlag] << 6)
+		| (cpu->Flags[negativeFlag - 1] << 7);
+}
+
+static FORCE_INLINE void UnpackFlags(struct CPU* cpu, const byte Status)
+{
+	cpu->Flags[carryFlag] = (Status >> 0) & 1;
+	cpu->Flags[zeroFlag] = (Status >> 1) & 1;
+	cpu->Flags[interruptDisable] = (Status >> 2) & 1;
+	cpu->Flags[decimalMode] = (Status >> 3) & 1;
+	cpu->Flags[breakCommand] = 0;
+	cpu->Flags[overflowFlag] = (Status >> 6) & 1;
+	cpu->Flags[negativeFlag - 1] = (Status >> 7) & 1;
+}
+
+static FORCE_INLINE void Interrupt(struct CPU* cpu, struct memory* mem, const word Vector, const bool BreakCommand, size_t* Cycles)
+{
+	StoreWord(StackAddress(cpu) - 1, cpu->pc, mem, Cycles);
+	cpu->sp -= 2;
+	PushByte(PackFlags(cpu, BreakCommand), cpu, mem, Cycles);
+	cpu->Flags[interruptDisable] = 1;
+	cpu->pc = LoadWord(mem, Vector, Cycles);
+}
+
+// Called between slices only: IRQ and NMI are never polled inside the dispatch loop,
+// AssertIrq/TriggerNmi and the instructions that clear the I flag end the running slice instead.
+static FORCE_INLINE void ServiceInterrupts(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	if (mem->NmiPending)
+	{
+		mem->NmiPending = 0;
+		Interrupt(cpu, mem, NMI_VECTOR, false, Cycles);
+		(*Cycles)--;
+	}
+	else if (mem->IrqLines && !cpu->Flags[interruptDisable])
+	{
+		Interrupt(cpu, mem, IRQ_VECTOR, false, Cycles);
+		(*Cycles)--;
+	}
+}
+
+// Fetches the next opcode of an enabled fused sequence, provided the dispatch loop would
+// have run it next: the slice isn't over, nothing stopped it and its page has no hooks.
+// Checked per step, the previous instruction may have rewritten the opcode.
+static FORCE_INLINE bool FuseNext(struct CPU* cpu, struct CPU* Host, struct memory* mem, const int Sequence, const byte Opcode, size_t* Cycles)
+{
+	if (!(mem->Fusion->Enabled & (1u << Sequence))
+		|| mem->Clock - *Cycles >= mem->Deadline
+		|| (mem->PageFlags[cpu->pc >> 8] & (PAGE_BREAK | PAGE_LEARN | PAGE_BANK))
+		|| mem->Data[cpu->pc] != Opcode)
+	{
+		return false;
+	}
+	FetchByte(cpu, mem, Cycles);
+	mem->Instructions++;
+	mem->Fusion->Runs++;
+	if (mem->Stats)
+	{
+		CollectStats(Spill(Host, cpu), mem, Opcode);
+	}
+	return true;
+}
+
+// Superinstructions for FUSED_SEQUENCES: the same steps as the cases in Execute(), run back
+// to back without going around the dispatch loop. Called for opcodes that start an enabled
+// sequence, returns false if Instruction has no handler and still has to be dispatched.
+static FORCE_INLINE bool RunFused(struct CPU* cpu, struct CPU* Host, struct memory* mem, const byte Instruction, size_t* Cycles)
+{
+	switch (Instruction)
+	{
+	case LDA_IM:
+	{
+		cpu->acc = FetchByte(cpu, mem, Cycles);
+		SetStatusFlags(cpu, cpu->acc);
+		if (FuseNext(cpu, Host, mem, FUSE_LDA_IM_STA_ZP, STA_ZP, Cycles))
 		{
-			word AbsAddress = FetchWord(cpu, mem, &cycles);
-			word AbsAddressY = AbsAddress + cpu->y;
-			cpu->acc ^= ReadByte(AbsAddressY, mem, &cycles);
+			byte ZeroPageAddress = FetchByte(cpu, mem, Cycles);
+			WriteByte(ZeroPageAddress, cpu->acc, mem, Cycles);
 			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case AND_INDX:
+		}
+		else if (FuseNext(cpu, Host, mem, FUSE_LDA_IM_STA_ABS, STA_ABS, Cycles))
 		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			ZeroPageAddress += cpu->x;
-			cycles--;
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			cpu->acc &= ReadByte(EffectiveAddress, mem, &cycles);
+			word AbsAddress = FetchWord(cpu, mem, Cycles);
+			WriteByte(AbsAddress, cpu->acc, mem, Cycles);
+			(*Cycles)--;
 			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case OR_INDX:
+		}
+	} break;
+	case LDA_ABSX:
+	{
+		cpu->acc = AbsoluteIndexed(cpu, mem, cpu->x, Cycles);
+		SetStatusFlags(cpu, cpu->acc);
+		if (FuseNext(cpu, Host, mem, FUSE_LDA_ABSX_STA_ABSY, STA_ABSY, Cycles))
 		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			ZeroPageAddress += cpu->x;
-			cycles--;
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			cpu->acc |= ReadByte(EffectiveAddress, mem, &cycles);
+			word AbsAddress = FetchWord(cpu, mem, Cycles);
+			WriteByte(AbsAddress + cpu->y, cpu->acc, mem, Cycles);
+			(*Cycles)--;
 			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case EOR_INDX:
+		}
+	} break;
+	case DEX_IM:
+	case DEY_IM:
+	case INX_IM:
+	case INY_IM:
+	{
+		const bool IndexX = Instruction == DEX_IM || Instruction == INX_IM;	// no pointer into cpu, it would pin the registers to memory
+		const byte Value = (IndexX ? cpu->x : cpu->y) + (Instruction == INX_IM || Instruction == INY_IM ? 1 : -1);
+		if (IndexX)
 		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			ZeroPageAddress += cpu->x;
-			cycles--;
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			cpu->acc ^= ReadByte(EffectiveAddress, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case AND_INDY:
+			cpu->x = Value;
+		}
+		else
 		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			EffectiveAddress += cpu->y;
-			cpu->acc &= ReadByte(EffectiveAddress, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case OR_INDY:
+			cpu->y = Value;
+		}
+		(*Cycles)--;
+		SetStatusFlags(cpu, Value);
+
+		const int Sequence = Instruction == DEX_IM ? FUSE_DEX_BNE
+			: Instruction == DEY_IM ? FUSE_DEY_BNE
+			: Instruction == INX_IM ? FUSE_INX_BNE : FUSE_INY_BNE;
+		if (FuseNext(cpu, Host, mem, Sequence, BNE, Cycles))
 		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			EffectiveAddress += cpu->y;
-			cpu->acc |= ReadByte(EffectiveAddress, mem, &cycles);
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case EOR_INDY:
+			Branch(cpu, Host, mem, !cpu->Flags[zeroFlag], true, Cycles);
+		}
+	} break;
+	case LDA_INDY:
+	{
+		cpu->acc = IndirectY(cpu, mem, Cycles);
+		SetStatusFlags(cpu, cpu->acc);
+		if (FuseNext(cpu, Host, mem, FUSE_LDA_INDY_STA_INDY_INY, STA_INDY, Cycles))
 		{
-			byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
-			word EffectiveAddress = ReadWord(mem, ZeroPageAddress, &cycles);
-			EffectiveAddress += cpu->y;
-			cpu->acc ^= ReadByte(EffectiveAddress, mem, &cycles);
+			byte ZeroPageAddress = FetchByte(cpu, mem, Cycles);
+			word EffectiveAddress = LoadWord(mem, ZeroPageAddress, Cycles);
+			WriteByte(EffectiveAddress + cpu->y, cpu->acc, mem, Cycles);
 			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case TAX_IM:
-		{
-			cpu->x = cpu->acc;
-			cycles--;
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case TAY_IM:
-		{
-			cpu->y = cpu->acc;
-			cycles--;
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case TXA_IM:
+			if (FuseNext(cpu, Host, mem, FUSE_LDA_INDY_STA_INDY_INY, INY_IM, Cycles))
+			{
+				cpu->y++;
+				(*Cycles)--;
+				SetStatusFlags(cpu, cpu->y);
+			}
+		}
+	} break;
+	default:
+	{
+		return false;
+	}
+	}
+	return true;
+}
+
+// Out of line versions of the bus and stack helpers, for the other modules
+void WriteWord(const word Address, const word data, struct memory* mem, size_t* Cycles)
+{
+	StoreWord(Address, data, mem, Cycles);
+}
+
+word ReadWord(struct memory* mem, const word Address, size_t* cycles)
+{
+	return LoadWord(mem, Address, cycles);
+}
+
+word SPtoWord(struct CPU* cpu)
+{
+	return StackAddress(cpu);
+}
+
+void pushPCToStack(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	PushReturn(cpu, mem, Cycles);
+}
+
+word popWordFromStack(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	return PullWord(cpu, mem, Cycles);
+}
+
+void pushByteOntoStack(byte value, struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	PushByte(value, cpu, mem, Cycles);
+}
+
+byte popByteOntoStack(struct CPU* cpu, struct memory* mem, size_t* Cycles)
+{
+	return PullByte(cpu, mem, Cycles);
+}
+
+void ResetCpu(struct CPU* cpu, struct memory* mem)
+{
+	cpu->Registers = 0;
+	cpu->pc = RESET_VECTOR;
+	cpu->sp = 0xFF;
+
+	memset(cpu->Flags, 0, sizeof(cpu->Flags));
+	memset(mem->Data, 0, sizeof(mem->Data));
+	
+	memset(mem->Data, 0, sizeof(mem->Data));
+
+	mem->Clock = 0;
+	mem->Deadline = 0;
+	mem->NextEvent = NO_EVENT;
+	mem->Instructions = 0;
+	mem->BusAccesses = 0;
+	mem->IdleSince = NO_EVENT;
+	memset(mem->Events, 0, sizeof(mem->Events));
+	mem->IrqLines = 0;
+	mem->NmiPending = 0;
+
+	memset(mem->PageFlags, 0, sizeof(mem->PageFlags));
+	memset(mem->Devices, 0, sizeof(mem->Devices));
+
+	memset(mem->Breakpoints, 0, sizeof(mem->Breakpoints));
+	memset(mem->Traps, 0, sizeof(mem->Traps));
+	mem->StopReason = STOP_NONE;
+	mem->StopAddress = 0;
+
+	mem->Timeline = NULL;
+	mem->Recorder = NULL;
+	mem->Memo = NULL;
+	mem->Fusion = NULL;
+	mem->Stats = NULL;
+	mem->DataHash = 0;
+	mem->Coverage = NULL;
+	mem->CoveragePrev = 0;
+	mem->Checkpoints = NULL;
+	mem->Mapper = NULL;
+	mem->Shared = NULL;
+}
+
+// The registers live in cpu, a local copy, until the call returns. Host is only up to date
+// while traps, hooks and the other modules run.
+uint32_t Execute(struct CPU* Host, struct memory* mem, size_t cycles)
+{
+	struct CPU Registers = *Host;
+	struct CPU* const cpu = &Registers;
+	const size_t numCycles = cycles;
+	const uint64_t End = mem->Clock + cycles;
+	int Resume = mem->StopReason == STOP_BREAKPOINT ? cpu->pc : -1;	// don't stop on the breakpoint we stopped at
+
+	mem->StopReason = STOP_NONE;
+	mem->Clock = End;	// the current cycle is always mem->Clock - cycles
+	while (mem->Clock - cycles < End && !mem->StopReason)
+	{
+		uint64_t Deadline = End;
+		mem->IdleSince = NO_EVENT;	// events and interrupts may change what an idle loop reads
+		if (mem->Memo)
 		{
-			cpu->acc = cpu->x;
-			cycles--;
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case TYA_IM:
+			StopLearning(mem);
+		}
+		if (!DevicesFrozen(mem))
 		{
-			cpu->acc = cpu->y;
-			cycles--;
-			SetStatusFlags(cpu, cpu->acc);
-		} break;
-		case INX_IM:
+			RunDueEvents(mem, mem->Clock - cycles);
+			Deadline = mem->NextEvent < Deadline ? mem->NextEvent : Deadline;
+		}
+		if (mem->Recorder)
 		{
-			cpu->x++;
-			cycles--;
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case INY_IM:
+			const uint64_t Next = RecorderTick(mem, mem->Clock - cycles);
+			Deadline = Next < Deadline ? Next : Deadline;
+		}
+		if (mem->Timeline)
 		{
-			cpu->y++;
-			cycles--;
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case DEX_IM:
+			const uint64_t Next = TimelineTick(Spill(Host, cpu), mem, mem->Clock - cycles);
+			Deadline = Next < Deadline ? Next : Deadline;
+		}
+		if (mem->Checkpoints)
 		{
-			cpu->x--;
-			cycles--;
-			SetStatusFlags(cpu, cpu->x);
-		} break;
-		case DEY_IM:
+			const uint64_t Next = CheckpointTick(Spill(Host, cpu), mem, mem->Clock - cycles);
+			Deadline = Next < Deadline ? Next : Deadline;
+		}
+		if (mem->Shared)
 		{
-			cpu->y--;
-			cycles--;
-			SetStatusFlags(cpu, cpu->y);
-		} break;
-		case BEQ:
+			const uint64_t Next = SharedTick(cpu, mem, mem->Clock - cycles);
+			Deadline = Next < Deadline ? Next : Deadline;
+		}
+		ServiceInterrupts(cpu, mem, &cycles);
+
+		mem->Deadline = Deadline;
+		while (mem->Clock - cycles < mem->Deadline)
 		{
-			byte offset = FetchByte(cpu, mem, &cycles);
-			if (cpu->Flags[zeroFlag])
+			if (mem->PageFlags[cpu->pc >> 8] & (PAGE_BREAK | PAGE_LEARN))
 			{
-				const word PCold = cpu->pc;
-				cpu->pc += offset;
-				cycles--;
+				if (mem->PageFlags[cpu->pc >> 8] & PAGE_LEARN)
+				{
+					MemoRecordFetch(mem, cpu->pc);
+				}
+				if ((mem->PageFlags[cpu->pc >> 8] & PAGE_BREAK) && cpu->pc != Resume && HitBreakpoint(mem, cpu->pc, BREAK_EXEC))
+				{
+					break;
+				}
+				Resume = -1;
+			}
+
+			byte Instruction = FetchByte(cpu, mem, &cycles);
+			mem->Instructions++;
 
-				const bool PageChanged = (cpu->pc >> 8) != (PCold >> 8);
-				if (PageChanged)
+			if (mem->Stats)
+			{
+				CollectStats(Spill(Host, cpu), mem, Instruction);
+			}
+			if (mem->Fusion)
+			{
+				if (mem->Fusion->Profiling)
+				{
+					ProfileOpcode(mem->Fusion, Instruction);
+				}
+				if (mem->Fusion->Starts[Instruction] && RunFused(cpu, Host, mem, Instruction, &cycles))
 				{
-					cycles -= 2;
+					continue;
 				}
 			}
-		} break;
-		case JSR:
-		{
-			word SubroutineAddress = FetchWord(cpu, mem, &cycles);
-			pushPCToStack(cpu, mem, &cycles);
-			cpu->pc = SubroutineAddress;
-			cycles--;
-		} break;
-		case RTS:
-		{
-			word ReturnAddress = popWordFromStack(cpu, mem, &cycles);
-			cpu->pc = ReturnAddress + 1;
-			cycles -= 2;
-		} break;
-		case JMP_ABS:
-		{
-			word Address = FetchWord(cpu, mem, &cycles);
-			cpu->pc = Address;
-		} break;
-		case JMP_IND:
-		{
-			word Address = FetchWord(cpu, mem, &cycles);
-			Address = ReadWord(mem, Address, &cycles);
-			cpu->pc = Address;
-		} break;
-		default:
-		{
-			printf("Instruction not handled %d\n", Instruction);
-		} break;
+
+			switch (Instruction)
+			{
+			case LDA_IM:
+			{
+				cpu->acc = FetchByte(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case LDA_ZP:
+			{
+				cpu->acc = ZeroPage(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case LDA_ZPX:
+			{
+				cpu->acc = ZeroPageX(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case LDA_ABS:
+			{
+				cpu->acc = Absolute(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case LDA_ABSX:
+			{
+				cpu->acc = AbsoluteIndexed(cpu, mem, cpu->x, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case LDA_ABSY:
+			{
+				cpu->acc = AbsoluteIndexed(cpu, mem, cpu->y, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case LDA_INDX:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				ZeroPageAddress += cpu->x;
+				cycles--;
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				cpu->acc = ReadByte(EffectiveAddress, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case LDA_INDY:
+			{
+				cpu->acc = IndirectY(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case LDX_IM:
+			{
+				cpu->x = FetchByte(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case LDX_ZP:
+			{
+				cpu->x = ZeroPage(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case LDX_ZPY:
+			{
+				cpu->x = ZeroPageY(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case LDX_ABS:
+			{
+				cpu->x = Absolute(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case LDX_ABSY:
+			{
+				cpu->x = AbsoluteIndexed(cpu, mem, cpu->y, &cycles);
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case LDY_IM:
+			{
+				cpu->y = FetchByte(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case LDY_ZP:
+			{
+				cpu->y = ZeroPage(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case LDY_ZPX:
+			{
+				cpu->y = ZeroPageX(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case LDY_ABS:
+			{
+				cpu->y = Absolute(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case LDY_ABSX:
+			{
+				cpu->y = AbsoluteIndexed(cpu, mem, cpu->x, &cycles);
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case STA_ZP:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				WriteByte(ZeroPageAddress, cpu->acc, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case STA_ZPX:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				ZeroPageAddress += cpu->x;
+				cycles--;
+				WriteByte(ZeroPageAddress, cpu->acc, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case STX_ZP:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				WriteByte(ZeroPageAddress, cpu->x, mem, &cycles);
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case STX_ZPY:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				ZeroPageAddress += cpu->y;
+				cycles--;
+				WriteByte(ZeroPageAddress, cpu->x, mem, &cycles);
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case STY_ZP:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				WriteByte(ZeroPageAddress, cpu->y, mem, &cycles);
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case STY_ZPX:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				ZeroPageAddress += cpu->x;
+				cycles--;
+				WriteByte(ZeroPageAddress, cpu->y, mem, &cycles);
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case STA_ABS:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				WriteByte(AbsAddress, cpu->acc, mem, &cycles);
+				cycles--;
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case STX_ABS:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				WriteByte(AbsAddress, cpu->x, mem, &cycles);
+				cycles--;
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case STY_ABS:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				WriteByte(AbsAddress, cpu->y, mem, &cycles);
+				cycles--;
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case STA_ABSX:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				word AbsAddressX = AbsAddress + cpu->x;
+				WriteByte(AbsAddressX, cpu->acc, mem, &cycles);
+				cycles--;
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case STA_ABSY:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				word AbsAddressY = AbsAddress + cpu->y;
+				WriteByte(AbsAddressY, cpu->acc, mem, &cycles);
+				cycles--;
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case STA_INDX:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				ZeroPageAddress += cpu->x;
+				cycles--;
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				WriteByte(EffectiveAddress, cpu->acc, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case STA_INDY:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				WriteByte(EffectiveAddress + cpu->y, cpu->acc, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case TSX:
+			{
+				cpu->x = cpu->sp;
+				cycles--;
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case TXS:
+			{
+				cpu->sp = cpu->x;
+				cycles--;
+			} break;
+			case PHA:
+			{
+				PushByte(cpu->acc, cpu, mem, &cycles);
+			} break;
+			case PHP:
+			{
+				PushByte(PackFlags(cpu, true), cpu, mem, &cycles);
+			} break;
+			case PLA:
+			{
+				cpu->acc = PullByte(cpu, mem, &cycles);
+				cycles -= 2;
+			} break;
+			case PLP:
+			{
+				const byte WasDisabled = cpu->Flags[interruptDisable];
+				UnpackFlags(cpu, PullByte(cpu, mem, &cycles));
+				cycles -= 2;
+				if (WasDisabled && !cpu->Flags[interruptDisable])
+				{
+					YieldToScheduler(mem);		// same as CLI, a pending IRQ is taken before the next slice
+				}
+			} break;
+			case AND_IM:
+			{
+				cpu->acc &= FetchByte(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case OR_IM:
+			{
+				cpu->acc |= FetchByte(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case EOR_IM:
+			{
+				cpu->acc ^= FetchByte(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case AND_ZP:
+			{
+				cpu->acc &= ZeroPage(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case OR_ZP:
+			{
+				cpu->acc |= ZeroPage(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case EOR_ZP:
+			{
+				cpu->acc ^= ZeroPage(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case AND_ZPX:
+			{
+				cpu->acc &= ZeroPageX(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case OR_ZPX:
+			{
+				cpu->acc |= ZeroPageX(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case EOR_ZPX:
+			{
+				cpu->acc ^= ZeroPageX(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case AND_ABS:
+			{
+				cpu->acc &= Absolute(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case OR_ABS:
+			{
+				cpu->acc |= Absolute(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case EOR_ABS:
+			{
+				cpu->acc ^= Absolute(cpu, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case AND_ABSX:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				word AbsAddressX = AbsAddress + cpu->x;
+				cpu->acc &= ReadByte(AbsAddressX, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case OR_ABSX:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				word AbsAddressX = AbsAddress + cpu->x;
+				cpu->acc |= ReadByte(AbsAddressX, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case EOR_ABSX:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				word AbsAddressX = AbsAddress + cpu->x;
+				cpu->acc ^= ReadByte(AbsAddressX, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case AND_ABSY:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				word AbsAddressY = AbsAddress + cpu->y;
+				cpu->acc &= ReadByte(AbsAddressY, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case OR_ABSY:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				word AbsAddressY = AbsAddress + cpu->y;
+				cpu->acc |= ReadByte(AbsAddressY, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case EOR_ABSY:
+			{
+				word AbsAddress = FetchWord(cpu, mem, &cycles);
+				word AbsAddressY = AbsAddress + cpu->y;
+				cpu->acc ^= ReadByte(AbsAddressY, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case AND_INDX:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				ZeroPageAddress += cpu->x;
+				cycles--;
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				cpu->acc &= ReadByte(EffectiveAddress, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case OR_INDX:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				ZeroPageAddress += cpu->x;
+				cycles--;
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				cpu->acc |= ReadByte(EffectiveAddress, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case EOR_INDX:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				ZeroPageAddress += cpu->x;
+				cycles--;
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				cpu->acc ^= ReadByte(EffectiveAddress, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case AND_INDY:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				EffectiveAddress += cpu->y;
+				cpu->acc &= ReadByte(EffectiveAddress, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case OR_INDY:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				EffectiveAddress += cpu->y;
+				cpu->acc |= ReadByte(EffectiveAddress, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case EOR_INDY:
+			{
+				byte ZeroPageAddress = FetchByte(cpu, mem, &cycles);
+				word EffectiveAddress = LoadWord(mem, ZeroPageAddress, &cycles);
+				EffectiveAddress += cpu->y;
+				cpu->acc ^= ReadByte(EffectiveAddress, mem, &cycles);
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case TAX_IM:
+			{
+				cpu->x = cpu->acc;
+				cycles--;
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case TAY_IM:
+			{
+				cpu->y = cpu->acc;
+				cycles--;
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case TXA_IM:
+			{
+				cpu->acc = cpu->x;
+				cycles--;
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case TYA_IM:
+			{
+				cpu->acc = cpu->y;
+				cycles--;
+				SetStatusFlags(cpu, cpu->acc);
+			} break;
+			case INX_IM:
+			{
+				cpu->x++;
+				cycles--;
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case INY_IM:
+			{
+				cpu->y++;
+				cycles--;
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case DEX_IM:
+			{
+				cpu->x--;
+				cycles--;
+				SetStatusFlags(cpu, cpu->x);
+			} break;
+			case DEY_IM:
+			{
+				cpu->y--;
+				cycles--;
+				SetStatusFlags(cpu, cpu->y);
+			} break;
+			case BEQ:
+			{
+				Branch(cpu, Host, mem, cpu->Flags[zeroFlag], false, &cycles);
+			} break;
+			case BNE:
+			{
+				Branch(cpu, Host, mem, !cpu->Flags[zeroFlag], true, &cycles);
+			} break;
+			case JSR:
+			{
+				word SubroutineAddress = FetchWord(cpu, mem, &cycles);
+				mem->IdleSince = NO_EVENT;	// calls, returns and indirect jumps leave any loop SkipIdleLoop() is timing
+				CoverEdge(mem, SubroutineAddress);
+				size_t Left = cycles;
+				if ((mem->PageFlags[SubroutineAddress >> 8] & PAGE_TRAP) && RunTrap(Spill(Host, cpu), mem, SubroutineAddress, &Left))
+				{
+					*cpu = *Host;
+					cycles = Left;
+					break;
+				}
+				if ((mem->PageFlags[SubroutineAddress >> 8] & PAGE_MEMO) && RunMemo(Spill(Host, cpu), mem, SubroutineAddress, &Left))
+				{
+					*cpu = *Host;
+					cycles = Left;
+					break;
+				}
+				PushReturn(cpu, mem, &cycles);
+				cpu->pc = SubroutineAddress;
+				cycles--;
+			} break;
+			case RTS:
+			{
+				if (mem->Memo && mem->Memo->Learning >= 0)
+				{
+					FinishMemo(Spill(Host, cpu), mem, cycles);
+				}
+				word ReturnAddress = PullWord(cpu, mem, &cycles);
+				mem->IdleSince = NO_EVENT;
+				cpu->pc = ReturnAddress + 1;
+				CoverEdge(mem, cpu->pc);
+				cycles -= 2;
+			} break;
+			case JMP_ABS:
+			{
+				word Address = FetchWord(cpu, mem, &cycles);
+				const word Branch = cpu->pc - 3;
+				cpu->pc = Address;
+				CoverEdge(mem, Address);
+				if (Address <= Branch)
+				{
+					size_t Left = cycles;
+					SkipIdleLoop(Spill(Host, cpu), mem, Branch, &Left);
+					cycles = Left;
+				}
+			} break;
+			case JMP_IND:
+			{
+				word Address = FetchWord(cpu, mem, &cycles);
+				Address = LoadWord(mem, Address, &cycles);
+				mem->IdleSince = NO_EVENT;
+				cpu->pc = Address;
+				CoverEdge(mem, Address);
+			} break;
+			case BRK:
+			{
+				cpu->pc++;
+				Interrupt(cpu, mem, IRQ_VECTOR, true, &cycles);
+				mem->IdleSince = NO_EVENT;
+			} break;
+			case RTI:
+			{
+				mem->IdleSince = NO_EVENT;
+				cpu->sp++;
+				UnpackFlags(cpu, ReadByte(StackAddress(cpu), mem, &cycles));
+				cpu->pc = PullWord(cpu, mem, &cycles);
+				cycles--;
+				YieldToScheduler(mem);
+			} break;
+			case SEI:
+			{
+				cpu->Flags[interruptDisable] = 1;
+				cycles--;
+			} break;
+			case CLI:
+			{
+				cpu->Flags[interruptDisable] = 0;
+				cycles--;
+				YieldToScheduler(mem);
+			} break;
+			default:
+			{
+				mem->StopReason = STOP_ILLEGAL;
+				mem->StopAddress = cpu->pc - 1;
+				YieldToScheduler(mem);
+			} break;
+			}
 		}
 	}
 
+	mem->Clock -= cycles;
+	*Host = Registers;
+	if (mem->Checkpoints)
+	{
+		CheckpointTick(Host, mem, mem->Clock);	// a record due right at the end isn't left to the next call
+	}
+	if (mem->Shared)
+	{
+		SharedTick(Host, mem, mem->Clock);	// same for a publish due right at the end
+	}
 	return numCycles - cycles;
 }
\ No newline at end of file
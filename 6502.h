@@ -11,6 +11,40 @@
 #define word unsigned short
 
 #define MAX_MEM 1024 * 64	// the amount of ram
+#define CACHE_LINE 64
+
+#define NMI_VECTOR 0xFFFA	// non-maskable interrupt vector
+#define RESET_VECTOR 0xFFFC	// reset vector
+#define IRQ_VECTOR 0xFFFE	// interrupt request / BRK vector
+
+#define MAX_EVENTS 8		// scheduler slots
+#define NO_EVENT UINT64_MAX
+
+#define PAGE_SIZE 256
+#define NUM_PAGES (MAX_MEM / PAGE_SIZE)
+
+#define MAX_BREAKPOINTS 16
+#define MAX_TRAPS 16			// host routines standing in for guest subroutines
+
+#define MEMO_ROUTINES 8			// subroutines opted into result memoization
+#define MEMO_ENTRIES 16			// cached calls per subroutine
+#define MEMO_READS 64			// distinct input bytes (code included) of one cached call
+#define MEMO_WRITES 32			// distinct bytes one cached call writes
+
+#define STATS_TRIPLES 4096		// hashed 3-gram slots, must be a power of two
+
+#define COVERAGE_MAP_SIZE 65536		// AFL-style edge map, one byte per edge bucket
+
+#define DIFF_MAX_INSTRUCTIONS 64		// longest generated differential test program
+
+#define SAVESTATE_VERSION 1
+#define SAVESTATE_MAX_SIZE (64 + NUM_PAGES * (3 + PAGE_SIZE))	// worst case of SaveState()
+
+#define MAPPER_MAX_SLOTS 4		// switchable windows of one mapper
+
+#define TIMELINE_SNAPSHOTS 64		// snapshots kept for time-travel debugging
+#define TIMELINE_PAGES 1024		// undo pages shared by all snapshots
+#define TIMELINE_INPUTS 65536		// recorded device reads and interrupt line changes
 
 enum INSTRS
 {
@@ -96,13 +130,95 @@ enum INSTRS
 	DEY_IM = 0x88,			// Decrement y register
 
 	BEQ = 0xF0,			// Branch if equal
+	BNE = 0xD0,			// Branch if not equal
 
 	JSR = 0x20,			// jump to subroutine
 	RTS = 0x60,			// return from subroutine
 	JMP_ABS = 0x4C,			// jump to address (absolute addressing mode)
-	JMP_IND = 0x6C			// jump to address (indexed-indirect addressing mode)
+	JMP_IND = 0x6C,			// jump to address (indexed-indirect addressing mode)
+
+	BRK = 0x00,			// force interrupt
+	RTI = 0x40,			// return from interrupt
+	SEI = 0x78,			// set interrupt disable flag
+	CLI = 0x58			// clear interrupt disable flag
 };	
 
+enum PAGE_FLAGS
+{
+	PAGE_IO = 1 << 0,			// reads and writes are routed to the attached device
+	PAGE_BREAK = 1 << 1,			// the page holds an execution breakpoint
+	PAGE_WATCH = 1 << 2,			// the page holds a read or write watchpoint
+	PAGE_TRACK = 1 << 3,			// the page is unchanged since the last snapshot
+	PAGE_TRAP = 1 << 4,			// a JSR target on the page runs a host routine, only JSR looks at it
+	PAGE_MEMO = 1 << 5,			// a JSR target on the page is memoized, only JSR looks at it
+	PAGE_LEARN = 1 << 6,			// a memoized call is being recorded, every access is logged
+	PAGE_HASH = 1 << 7,			// writes update memory::DataHash
+	PAGE_BANK = 1 << 8,			// the attached mapper backs the page or watches writes to it, opcode fetches check it too
+
+	PAGE_READ_SLOW = PAGE_IO | PAGE_WATCH | PAGE_LEARN | PAGE_BANK,
+	PAGE_WRITE_SLOW = PAGE_IO | PAGE_WATCH | PAGE_TRACK | PAGE_LEARN | PAGE_HASH | PAGE_BANK
+};
+
+enum FUSED_SEQUENCES
+{
+	FUSE_LDA_IM_STA_ZP = 0,
+	FUSE_LDA_IM_STA_ABS,
+	FUSE_LDA_ABSX_STA_ABSY,
+	FUSE_DEX_BNE,
+	FUSE_DEY_BNE,
+	FUSE_INX_BNE,
+	FUSE_INY_BNE,
+	FUSE_LDA_INDY_STA_INDY_INY,		// body of a (src),Y copy loop
+
+	FUSE_COUNT
+};
+
+enum STAT_MODES
+{
+	STAT_ZERO_PAGE = 0,			// zp, zp,X, zp,Y
+	STAT_ABSOLUTE,				// abs, abs,X, abs,Y
+	STAT_INDIRECT,				// (zp,X), (zp),Y and the JMP (abs) pointer
+
+	STAT_MODE_COUNT
+};
+
+enum INPUT_TYPE
+{
+	INPUT_READ = 0,				// value returned by a device read
+	INPUT_IRQ,				// IRQ lines changed
+	INPUT_NMI,				// NMI edge
+	INPUT_WRITE				// memory write injected by the host between Execute() calls
+};
+
+enum BREAK_TYPE
+{
+	BREAK_EXEC = 1 << 0,
+	BREAK_READ = 1 << 1,
+	BREAK_WRITE = 1 << 2
+};
+
+enum STOP_REASON
+{
+	STOP_NONE = 0,
+	STOP_BREAKPOINT,
+	STOP_WATCH_READ,
+	STOP_WATCH_WRITE,
+	STOP_ILLEGAL				// opcode the core doesn't implement, StopAddress holds its address
+};
+
+enum VIA_REGISTERS
+{
+	VIA_T1CL = 0x4,			// timer 1 counter low (read clears the T1 interrupt)
+	VIA_T1CH = 0x5,			// timer 1 counter high (write loads and starts timer 1)
+	VIA_T1LL = 0x6,			// timer 1 latch low
+	VIA_T1LH = 0x7,			// timer 1 latch high
+	VIA_T2CL = 0x8,			// timer 2 counter low (read clears the T2 interrupt)
+	VIA_T2CH = 0x9,			// timer 2 counter high (write loads and starts timer 2)
+	VIA_ACR = 0xB,			// auxiliary control register (bit 6: timer 1 free-run)
+	VIA_IFR = 0xD,			// interrupt flag register
+	VIA_IER = 0xE			// interrupt enable register
+};
+
 enum FLAGS
 {
 	carryFlag = 0,
@@ -114,22 +230,115 @@ enum FLAGS
 	negativeFlag
 };
 
-struct CPU
+// The registers Execute() touches on every instruction share one 8 byte word, so a state is
+// loaded and stored with a single access to Registers plus the flags. Each CPU fills a cache
+// line of its own, so arrays of them run by different threads don't false-share.
+struct alignas(CACHE_LINE) CPU
 {
-	word pc;				// program counter
-	byte sp;				// stack pointer
+	union
+	{
+		struct
+		{
+			word pc;		// program counter
+			byte sp;		// stack pointer
 
-	byte acc;				// accumulator
-	byte x;
-	byte y;
+			byte acc;		// accumulator
+			byte x;
+			byte y;
+		};
+		uint64_t Registers;		// all of the above, the two bytes after y stay zero from ResetCpu() on
+	};
 
 	byte Flags[negativeFlag];
 };
 
+static_assert(sizeof(struct CPU) == CACHE_LINE && alignof(struct CPU) == CACHE_LINE, "struct CPU has to fill exactly one cache line");
+
+
+struct memory;
+
+typedef void (*EventHandler)(struct memory* mem, uint64_t Now, void* Context);
+
+struct event
+{
+	uint64_t When;				// absolute cycle the event fires at
+	EventHandler Handler;			// NULL if the slot is free
+	void* Context;
+};
+
+typedef byte (*BusReadHandler)(struct memory* mem, const word Address, const uint64_t Now, void* Context);
+typedef void (*BusWriteHandler)(struct memory* mem, const word Address, const byte Data, const uint64_t Now, void* Context);
+
+struct device
+{
+	BusReadHandler Read;
+	BusWriteHandler Write;
+	void* Context;
+};
+
+struct breakpoint
+{
+	word Address;
+	byte Type;				// BREAK_TYPE bits, zero if the slot is free
+};
+
+typedef void (*TrapHandler)(struct CPU* cpu, struct memory* mem, void* Context);
+
+struct trap
+{
+	word Address;
+	TrapHandler Handler;			// NULL if the slot is free
+	uint32_t Cost;				// cycles charged for the routine body, JSR and RTS come on top
+	void* Context;
+};
+
+struct timeline;
+struct recorder;
+struct memo;
+struct fusion;
+struct stats;
+struct checkpoints;
+struct mapper;
+struct shared_header;
 
 struct memory
 {
 	byte Data[MAX_MEM];
+	word PageFlags[NUM_PAGES];		// PAGE_FLAGS, zero keeps ReadByte/WriteByte on the plain array
+	struct device Devices[NUM_PAGES];
+
+	uint64_t Clock;				// absolute cycle count, during Execute() the cycle the budget runs out at
+	uint64_t Deadline;			// the dispatch loop yields to the scheduler once this cycle is reached
+	uint64_t NextEvent;			// the earliest pending event (NO_EVENT if none)
+	uint64_t Instructions;			// instructions dispatched since ResetCpu()
+	struct event Events[MAX_EVENTS];
+
+	byte IrqLines;				// one bit per device holding the IRQ line low
+	byte NmiPending;			// NMI is edge triggered, latched until serviced
+
+	struct breakpoint Breakpoints[MAX_BREAKPOINTS];
+	struct trap Traps[MAX_TRAPS];
+	byte StopReason;			// why the last Execute() returned early, STOP_NONE if it ran its budget
+	word StopAddress;
+
+	uint64_t BusAccesses;			// slow-path reads and writes, see SkipIdleLoop()
+	word IdleBranch;			// back edge SkipIdleLoop() saw last
+	uint64_t IdleSince;			// cycle it was taken at, NO_EVENT if there is nothing to compare
+	uint64_t IdleInstructions;
+	uint64_t IdleBusAccesses;
+	struct CPU IdleCpu;
+
+	struct timeline* Timeline;		// NULL unless time-travel debugging is attached
+	struct recorder* Recorder;		// NULL unless inputs are being recorded or replayed
+	struct memo* Memo;			// NULL unless subroutine memoization is attached
+	struct fusion* Fusion;			// NULL unless superinstructions are attached
+	struct stats* Stats;			// NULL unless instruction statistics are collected
+	uint64_t DataHash;			// XOR of HashByte() over Data, kept up to date while PAGE_HASH is set
+	byte* Coverage;				// COVERAGE_MAP_SIZE edge counters, NULL unless fuzzing
+	word CoveragePrev;			// previous control transfer target, shifted like AFL does
+	struct checkpoints* Checkpoints;	// NULL unless state hash checkpoints are written
+	struct mapper* Mapper;			// NULL unless banks are switched into the address space
+	struct shared_header* Shared;		// NULL unless the instance is published to other processes
 };
 
 void WriteWord(const word, const word, struct memory*, size_t*);
@@ -141,6 +350,629 @@ word popWordFromStack(struct CPU*, struct memory*, size_t*);
 void pushByteOntoStack(byte, struct CPU*, struct memory*, size_t*);
 byte popByteOntoStack(struct CPU*, struct memory*, size_t*);
 
+int ScheduleEvent(struct memory*, const uint64_t, EventHandler, void*);
+void CancelEvent(struct memory*, const int);
+void RunDueEvents(struct memory*, const uint64_t);
+void AssertIrq(struct memory*, const byte);
+void ReleaseIrq(struct memory*, const byte);
+void TriggerNmi(struct memory*);
+void YieldToScheduler(struct memory*);
+
+void AttachDevice(struct memory*, const word, const word, BusReadHandler, BusWriteHandler, void*);
+void DetachDevice(struct memory*, const word, const word);
+bool DevicesFrozen(const struct memory*);
+byte BusRead(struct memory*, const word, const size_t);
+void BusWrite(struct memory*, const word, const byte, const size_t);
+void StoreByte(struct memory*, const word, const byte);
+
+int SetBreakpoint(struct memory*, const word, const byte);
+void ClearBreakpoint(struct memory*, const word, const byte);
+bool HitBreakpoint(struct memory*, const word, const byte);
+
+int RegisterTrap(struct memory*, const word, TrapHandler, const uint32_t, void*);
+void ClearTrap(struct memory*, const word);
+bool RunTrap(struct CPU*, struct memory*, const word, size_t*);
+
+struct input
+{
+	uint64_t Cycle;
+	word Address;
+	byte Value;
+	byte Type;				// INPUT_TYPE
+};
+
+struct snapshot
+{
+	uint64_t Cycle;
+	struct CPU cpu;
+	byte IrqLines;
+	byte NmiPending;
+	uint64_t InputRead;			// input log positions of the device read and interrupt replay at the snapshot,
+	uint64_t InputIrq;			// both the log head unless the snapshot was re-taken during a replay
+	int Banks[MAPPER_MAX_SLOTS];		// bank selected in each slot of memory::Mapper
+	uint64_t Page;				// first undo page saved after the snapshot
+};
+
+// Periodic snapshots with copy-on-first-write undo pages and a log of every device read
+// and interrupt line change. Re-executing from a snapshot replays the log instead of the
+// devices, scheduler events stay frozen until the replay catches up with the present.
+struct timeline
+{
+	uint64_t Interval;
+	uint64_t NextSnapshot;
+
+	struct snapshot Snapshots[TIMELINE_SNAPSHOTS];
+	uint64_t OldestSnapshot;		// absolute snapshot numbers, index modulo TIMELINE_SNAPSHOTS
+	uint64_t NewestSnapshot;
+	bool HasSnapshots;
+
+	byte PageNumbers[TIMELINE_PAGES];
+	byte Pages[TIMELINE_PAGES][PAGE_SIZE];
+	uint64_t PageHead;
+
+	struct input Inputs[TIMELINE_INPUTS];
+	uint64_t InputHead;
+	byte LastIrqLines;
+
+	bool Replaying;
+	uint64_t Present;			// furthest cycle executed live
+	byte PresentIrqLines;
+	byte PresentNmiPending;
+	uint64_t ReplayRead;			// replay cursors into Inputs
+	uint64_t ReplayIrq;
+};
+
+bool AttachTimeline(struct timeline*, struct CPU*, struct memory*, const uint64_t);
+void DetachTimeline(struct memory*);
+uint64_t TimelineTick(struct CPU*, struct memory*, const uint64_t);
+void TimelineSavePage(struct memory*, const word);
+void RecordRead(struct memory*, const word, const byte, const uint64_t);
+byte ReplayRead(struct memory*, const word);
+bool SeekToCycle(struct CPU*, struct memory*, const uint64_t);
+bool ReverseStep(struct CPU*, struct memory*);
+bool ReverseContinue(struct CPU*, struct memory*);
+
+// Streaming input log: "H6RL", version, start cycle, then one record per input made of
+// a type byte, the LEB128 cycle delta to the previous record and the payload
+struct recorder
+{
+	FILE* Stream;
+	bool Replaying;
+	uint64_t LastCycle;
+	byte LastIrqLines;
+	struct input Next;			// replay lookahead
+	bool HasNext;
+};
+
+bool StartRecording(struct recorder*, struct memory*, FILE*);
+bool StartReplay(struct recorder*, struct memory*, FILE*);
+void StopRecorder(struct memory*);
+void InjectWrite(struct memory*, const word, const byte);
+uint64_t RecorderTick(struct memory*, const uint64_t);
+void RecorderRecordRead(struct memory*, const byte, const uint64_t);
+byte RecorderReplayRead(struct memory*, const word);
+
+// Save states: "H6SS", version, flags, a fixed little-endian register block ending in the
+// selected banks, then either the raw 64 KiB image or one record per page (all zero, raw, or
+// LZ compressed). Instances with writable banks aren't saved, the banks live with the host.
+size_t SaveState(const struct CPU*, const struct memory*, byte*, const size_t, const bool);
+bool LoadState(struct CPU*, struct memory*, const byte*, const size_t);
+bool SaveStateFile(const struct CPU*, const struct memory*, const char*, const bool);
+bool LoadStateFile(struct CPU*, struct memory*, const char*);
+
+struct memo_access
+{
+	word Address;
+	byte Value;
+};
+
+// One recorded call: the registers on entry and every byte the call read before writing it
+// (code included) are the key, the registers before the final RTS and the bytes written are
+// the result. Checking the values again on lookup means a write to the routine's code or
+// inputs can never hit a stale entry.
+struct memo_entry
+{
+	bool Valid;
+	struct CPU In;
+	struct CPU Out;
+	uint64_t Cycles;			// JSR to the end of the final RTS
+	uint64_t Instructions;
+	byte NumReads;
+	byte NumWrites;
+	struct memo_access Reads[MEMO_READS];
+	struct memo_access Writes[MEMO_WRITES];
+};
+
+struct memo_routine
+{
+	word Address;
+	bool Used;
+	bool Disabled;				// touched a device or outgrew the entry, never cached again
+	byte Next;				// round-robin replacement
+	struct memo_entry Entries[MEMO_ENTRIES];
+};
+
+struct memo
+{
+	struct memo_routine Routines[MEMO_ROUTINES];
+	int Learning;				// routine being recorded, -1 if none
+	struct memo_entry Scratch;
+	uint64_t LearnStart;
+	uint64_t LearnInstructions;
+	uint64_t Hits;
+	uint64_t Misses;
+};
+
+void AttachMemo(struct memo*, struct memory*);
+void DetachMemo(struct memory*);
+int MemoizeRoutine(struct memory*, const word);
+bool RunMemo(struct CPU*, struct memory*, const word, size_t*);
+void FinishMemo(struct CPU*, struct memory*, const size_t);
+void StopLearning(struct memory*);
+void MemoRecordRead(struct memory*, const word);
+void MemoRecordFetch(struct memory*, const word);
+void MemoRecordWrite(struct memory*, const word, const byte);
+
+// Superinstructions: an opcode pair profile taken while running normally picks which of the
+// FUSED_SEQUENCES run as one dispatch
+struct fusion
+{
+	bool Profiling;
+	byte Last;				// opcode dispatched before the current one
+	uint32_t Pairs[256][256];		// [first][second] dynamic opcode pair counts
+	uint32_t Enabled;			// one bit per FUSED_SEQUENCES entry
+	byte Starts[256];			// nonzero if an enabled sequence starts with the opcode
+	uint64_t Runs;				// dispatches saved
+};
+
+void AttachFusion(struct fusion*, struct memory*);
+void DetachFusion(struct memory*);
+void ProfileOpcode(struct fusion*, const byte);
+void EnableFusions(struct memory*, const uint32_t);
+int ChooseFusions(struct memory*, const int, const uint32_t);
+
+struct stats_triple
+{
+	uint32_t Key;				// 1 << 24 | first << 16 | second << 8 | third, zero if free
+	uint64_t Count;
+};
+
+// Instruction mix and memory access statistics gathered at dispatch. Fixed-size tables
+// only: 3-grams that don't fit into the hashed table are counted in TriplesDropped.
+// Iterations SkipIdleLoop() and RunBulkLoop() fast-forward are never dispatched, so they
+// aren't counted either.
+struct stats
+{
+	uint64_t Instructions;
+	byte Last[2];				// the two opcodes dispatched before the current one
+	uint64_t Pairs[256][256];		// [first][second]
+	struct stats_triple Triples[STATS_TRIPLES];
+	uint64_t TriplesDropped;
+
+	uint64_t Pages[STAT_MODE_COUNT][NUM_PAGES];	// effective address page per addressing mode
+	uint64_t ZeroPage[PAGE_SIZE];		// zero page accesses per address
+	uint64_t Indexed[STAT_MODE_COUNT];	// indexed accesses that can cross a page
+	uint64_t PageCrosses[STAT_MODE_COUNT];
+	uint64_t Branches;
+	uint64_t BranchesTaken;
+	uint64_t BranchCrosses;			// taken branches landing on another page
+};
+
+void AttachStats(struct stats*, struct memory*);
+void DetachStats(struct memory*);
+void CollectStats(const struct CPU*, struct memory*, const byte);
+uint64_t TripleCount(const struct stats*, const byte, const byte, const byte);
+bool WriteStats(const struct stats*, FILE*);
+
+// In-process fuzzing: every run starts from the golden instance, the input is copied to
+// InputAddress and the guest runs for Cycles. Only the pages the previous run wrote are
+// restored (PAGE_TRACK is cleared by the first write to a page), so host code writing
+// memory::Data from a trap handler has to use StoreByte().
+struct fuzz_target
+{
+	struct CPU GoldenCpu;
+	struct memory Golden;
+	int GoldenBanks[MAPPER_MAX_SLOTS];	// bank selected in each slot of Golden.Mapper, the mapper isn't copied
+	struct CPU cpu;
+	struct memory mem;
+	word InputAddress;
+	word InputSize;				// longer inputs are cut, shorter ones zero padded
+	word LengthAddress;			// input length is stored here as a word, 0 for none
+	size_t Cycles;
+};
+
+void AttachCoverage(struct memory*, byte*);
+void DetachCoverage(struct memory*);
+bool InitFuzzTarget(struct fuzz_target*, const struct CPU*, const struct memory*, byte*, const word, const word, const word, const size_t);
+int FuzzOneInput(struct fuzz_target*, const byte*, const size_t);
+
+// Differential testing: the same generated program and initial state run on two engines,
+// compared at random cycle windows down to single instructions
+struct diff_engine
+{
+	const char* Name;
+	void (*Setup)(struct CPU*, struct memory*, void*);	// attaches the engine's extras, NULL for none
+	void* Context;
+	bool Stepped;				// one Execute() call per instruction, so no fast path can kick in
+};
+
+// Registers, memory and the window schedule all derive from Seed, the program is kept as
+// instructions so the minimizer can drop them one at a time
+struct diff_case
+{
+	uint64_t Seed;
+	uint32_t Cycles;
+	int Count;
+	byte Lengths[DIFF_MAX_INSTRUCTIONS];
+	byte Code[DIFF_MAX_INSTRUCTIONS * 3];
+};
+
+struct diff_harness
+{
+	struct diff_engine Engines[2];
+	struct CPU cpu[2];
+	struct memory mem[2];
+	uint64_t Cases;				// cases run so far
+	uint64_t DivergedAt;			// cycle of the first mismatch of the last failing case
+	struct diff_case Failure;		// minimized, valid once DiffFuzz() returned false
+};
+
+void InitDiffHarness(struct diff_harness*, const struct diff_engine*, const struct diff_engine*);
+void GenerateDiffCase(struct diff_case*, const uint64_t);
+bool RunDiffCase(struct diff_harness*, const struct diff_case*);
+void MinimizeDiffCase(struct diff_harness*, struct diff_case*);
+bool DiffFuzz(struct diff_harness*, const uint64_t, const uint64_t);
+void PrintDiffCase(const struct diff_case*, FILE*);
+void SetupFusedEngine(struct CPU*, struct memory*, void*);
+
+// Zobrist-style state hashing: DataHash changes in O(1) per write, so telling two instances
+// apart is one compare. Host code writing memory::Data directly has to go through StoreByte()
+// (or call RehashMemory() afterwards) for the hash to stay valid.
+uint64_t HashByte(const word, const byte);
+uint64_t HashBankByte(const size_t, const byte);
+void EnableMemoryHash(struct memory*);
+void DisableMemoryHash(struct memory*);
+void RehashMemory(struct memory*);
+void HashRange(struct memory*, const word, const int);
+uint64_t StateHash(const struct CPU*, const struct memory*);
+bool StatesEqual(const struct CPU*, const struct memory*, const struct CPU*, const struct memory*);
+
+// NUMA placement for worker farms. On a single node (or off Linux) nothing is pinned or
+// bound, so callers don't have to check.
+#define NUMA_MAX_NODES 8
+#define NUMA_MAX_CPUS 256
+
+struct numa_topology
+{
+	int NumNodes;				// nodes with CPUs, 1 if the host isn't NUMA
+	int NodeId[NUMA_MAX_NODES];		// kernel node number of each
+	int NumCpus[NUMA_MAX_NODES];
+	int Cpus[NUMA_MAX_NODES][NUMA_MAX_CPUS];
+};
+
+void ReadNumaTopology(struct numa_topology*);
+int WorkerNode(const struct numa_topology*, const int);
+bool PinWorker(const struct numa_topology*, const int);
+bool BindToNode(void*, const size_t, const int);
+
+// Instances carved out of 2 MiB aligned arenas, backed by huge pages where the host allows.
+// The registers get a cache line of their own and memory starts on the next one.
+#define POOL_HUGE_PAGE (2 * 1024 * 1024)
+#define POOL_ARENA_SIZE (16 * POOL_HUGE_PAGE)	// default, about 460 instances
+#define POOL_MAX_ARENAS 1024
+
+struct instance
+{
+	struct CPU cpu;				// holds the free list link while the slot is free
+	struct memory mem;
+};
+
+struct instance_pool
+{
+	size_t ArenaSize;			// a multiple of POOL_HUGE_PAGE
+	size_t SlotSize;			// sizeof(struct instance) rounded up to CACHE_LINE
+	int Node;				// kernel NUMA node new arenas are bound to, -1 for no binding
+	int NumArenas;
+	int HugeArenas;				// arenas backed by explicit huge pages
+	byte* Arenas[POOL_MAX_ARENAS];
+	byte* Bump;				// next never used slot of the newest arena
+	byte* BumpEnd;
+	struct instance* FreeList;
+	uint64_t Live;
+};
+
+void InitInstancePool(struct instance_pool*, const size_t);
+struct instance* AllocInstance(struct instance_pool*);
+void FreeInstance(struct instance_pool*, struct instance*);
+void DestroyInstancePool(struct instance_pool*);
+
+// Searches for input sequences: every time the guest reaches HookAddress the explorer forks
+// one instance per candidate byte, stores it at InputAddress and runs to the next hook.
+// States already seen (by StateHash()) aren't expanded again. Without a Score callback the
+// frontier is breadth-first, with one the best scoring nodes are expanded first.
+struct explore_node
+{
+	struct CPU cpu;
+	struct instance* Snapshot;		// memory at the hook, back in the pool once expanded
+	int Home;				// pool the snapshot came from
+	int Parent;				// -1 for the root
+	int Depth;
+	int64_t Score;
+	byte Input;				// fed at the parent's hook to get here
+};
+
+struct explorer
+{
+	word HookAddress;
+	word InputAddress;
+	int NumInputs;
+	byte Inputs[256];
+	size_t StepCycles;			// budget from one hook to the next, runs that don't get there are dead ends
+	bool (*Goal)(const struct CPU*, const struct memory*, void*);
+	int64_t (*Score)(const struct CPU*, const struct memory*, void*);	// NULL for breadth-first
+	void* Context;
+	int Threads;
+	int MaxNodes;
+	int Batch;				// nodes expanded per parallel round
+	bool Numa;				// pin the workers to NUMA nodes and keep their snapshots local
+	struct explore_node* Nodes;
+	int NumNodes;
+	struct instance_pool Pools[NUMA_MAX_NODES];	// one per NUMA node, only the first without Numa
+	uint64_t* Visited;			// open addressed set of state hashes
+	uint64_t VisitedMask;
+	int Solution;				// node that reached the goal, -1 if none
+	uint64_t Explored;			// candidate runs
+	uint64_t Duplicates;
+	double StatesPerSecond;
+};
+
+void InitExplorer(struct explorer*, const word, const word, const byte*, const int, const size_t);
+int Explore(struct explorer*, const struct CPU*, const struct memory*);
+int SolutionInputs(const struct explorer*, byte*, const int);
+void FreeExplorer(struct explorer*);
+
+// State hash checkpoints: "H6CP", version, start cycle and interval (8 bytes little-endian
+// each), then one record per interval: the cycle it was taken at, the instruction count and
+// a rolling hash of every StateHash() so far. The records are taken at the first instruction
+// boundary at or after each multiple of the interval, wherever the host slices Execute().
+struct checkpoints
+{
+	FILE* Stream;
+	uint64_t Start;
+	uint64_t Interval;			// cycles
+	uint64_t Next;				// cycle the next record is due at
+	uint64_t Rolling;
+	uint64_t Count;				// records written
+};
+
+struct checkpoint_record
+{
+	uint64_t Clock;
+	uint64_t Instructions;
+	uint64_t Hash;
+};
+
+// Where two checkpoint files first disagree. Start is the last record they share (the run's
+// start if there is none), End the first record of each run after it.
+struct checkpoint_window
+{
+	uint64_t Index;				// of the first differing record
+	struct checkpoint_record Start;
+	struct checkpoint_record End[2];	// all zero where a file ended early
+};
+
+bool StartCheckpoints(struct checkpoints*, struct memory*, FILE*, const uint64_t);
+void StopCheckpoints(struct memory*);
+uint64_t CheckpointTick(const struct CPU*, struct memory*, const uint64_t);
+int CompareCheckpoints(FILE*, FILE*, struct checkpoint_window*);
+bool TraceWindow(struct CPU*, struct memory*, const struct checkpoint_window*, FILE*);
+
+// Byte-exact differences between two images, compared a page at a time with AVX2 or SSE2
+// where the host has them. Ranges never cross a page boundary. Instances with a mapper are
+// refused, their banks aren't in the image.
+#define MEMORY_PATCH_MAX_SIZE (32 + NUM_PAGES * (3 + PAGE_SIZE))	// worst case of MakePatch()
+
+// Instruction sets the memory diff and scan kernels can use, the best one the host supports
+// is picked on first use
+enum SIMD_LEVEL
+{
+	SIMD_SCALAR = 0,
+	SIMD_SSE2,
+	SIMD_AVX2
+};
+
+struct memory_range
+{
+	word Address;
+	word Length;
+};
+
+struct memory_diff
+{
+	uint32_t Bytes;				// differing bytes in total
+	int NumRanges;
+	int PageStart[NUM_PAGES + 1];		// the ranges of page p are Ranges[PageStart[p]] up to Ranges[PageStart[p + 1]]
+	struct memory_range Ranges[MAX_MEM / 2];
+};
+
+int SimdLevel();
+int SetSimdLevel(const int);
+bool DiffMemory(const struct memory*, const struct memory*, struct memory_diff*);
+size_t MakePatch(const struct memory_diff*, const struct CPU*, const struct memory*, byte*, const size_t);
+bool ApplyPatch(struct CPU*, struct memory*, const byte*, const size_t);
+
+// Cheat-finder style searches: byte patterns with wildcards over one or many instances, and
+// scans that keep one candidate bit per address and narrow it down frame by frame. Banked
+// instances are searched the way the CPU sees them, through MapperView().
+#define SCAN_MAX_PATTERN 64
+
+enum SCAN_FILTER
+{
+	SCAN_EQUAL = 0,				// equal to the given value
+	SCAN_NOT_EQUAL,
+	SCAN_CHANGED,				// compared to the image of the previous filter
+	SCAN_UNCHANGED,
+	SCAN_INCREASED,
+	SCAN_DECREASED
+};
+
+struct scan_pattern
+{
+	int Length;
+	byte Bytes[SCAN_MAX_PATTERN];
+	byte Mask[SCAN_MAX_PATTERN];		// 0x00 for a wildcard, 0xFF for an exact byte
+};
+
+struct scan_match
+{
+	int Instance;
+	word Address;
+};
+
+struct scan
+{
+	uint64_t Candidates[MAX_MEM / 64];	// bit a & 63 of word a >> 6 for address a
+	uint32_t Count;
+	byte Snapshot[MAX_MEM];			// what the change filters compare against
+};
+
+bool ParsePattern(struct scan_pattern*, const char*);
+int FindPattern(const struct memory* const*, const int, const struct scan_pattern*, struct scan_match*, const int);
+void StartScan(struct scan*, const struct memory*);
+uint32_t FilterScan(struct scan*, const struct memory*, const int, const byte);
+int ScanResults(const struct scan*, word*, const int);
+
+// 6522-style timers, counters are derived from the load cycle whenever the guest reads them
+struct via
+{
+	word Base;
+	word Latch1;
+	word Latch2;
+	uint64_t Start1;			// cycle timer 1 was loaded at
+	uint64_t Start2;
+	word Reload1;				// value timer 1 was loaded with at Start1
+	word Reload2;
+	byte Acr;
+	byte Ifr;
+	byte Ier;
+	byte IrqSource;				// bit this VIA drives in memory::IrqLines
+	int Event1;				// scheduler slot of the pending underflow, -1 if none
+	int Event2;
+};
+
+// Bank switching. The mapper keeps a pointer per slot (a switchable window of the address
+// space) into the host's backing store, so a switch is one pointer store whatever the bank
+// size. Banked pages hold nothing in memory::Data. Save states and timeline snapshots keep
+// the selected banks, StateHash() folds them in together with the contents of RAM banks, and
+// the scanners look through MapperView(). Whatever only works on Data turns a banked instance
+// down: memory diffs and patches and the explorer, and save states and the timeline once the
+// banks are writable, as their contents live outside the instance.
+
+enum MAPPER_TYPE
+{
+	MAPPER_LATCH = 0,			// one window, a bank register anywhere outside device pages
+	MAPPER_UXROM,				// 16 KiB switchable at $8000, the last bank fixed at $C000, writes to $8000-$FFFF select
+	MAPPER_AXROM				// 32 KiB switchable at $8000, writes to $8000-$FFFF select with the low 3 bits
+};
+
+struct mapper_slot
+{
+	word Base;
+	size_t Size;
+	int Bank;				// bank mapped in now
+	byte* Data;				// its backing store
+};
+
+struct mapper
+{
+	int Type;
+	byte* Banks;				// NumBanks * BankSize bytes, owned by the host
+	int NumBanks;
+	size_t BankSize;
+	word Register;				// MAPPER_LATCH only
+	bool Writable;				// RAM banks, stores go to the bank mapped in
+	int NumSlots;
+	struct mapper_slot Slots[MAPPER_MAX_SLOTS];	// slot 0 is the one the bank register switches
+	byte PageSlot[NUM_PAGES];		// slot + 1 backing each page, 0 for pages left to Data
+	uint64_t Switches;
+	uint64_t BankHash;			// XOR of HashBankByte() over writable banks, kept up to date by MapperWrite()
+};
+
+bool InitMapper(struct mapper*, const int, byte*, const size_t);
+bool InitLatchMapper(struct mapper*, byte*, const size_t, const word, const size_t, const word, const bool);
+bool AttachMapper(struct mapper*, struct memory*);
+void DetachMapper(struct memory*);
+void SwitchBank(struct mapper*, const int, const int);
+byte MapperRead(const struct memory*, const word);
+bool MapperWrite(struct memory*, const word, const byte);
+void MapperView(const struct memory*, byte*);
+
+// Guest RAM other processes can watch without copies: the memory struct lives in a memfd (or a
+// named POSIX shared memory object) after a header page and two published frames, and viewers
+// map it read only. The live Data is there for racy peeking. For consistent snapshots the
+// emulator copies Data, the registers and the clock into the older frame at the first slice
+// boundary every Interval cycles. Each frame has its own seqlock, odd while it is being
+// written, and a frame is only rewritten two publishes later, so a viewer copying the newest
+// one only fails if it takes longer than a whole interval. The emulator never waits for a
+// viewer. Host stores between Execute() calls show up with the next publish, or right away
+// with PublishShared().
+#define SHARED_MAGIC "H6SM"
+#define SHARED_VERSION 3
+#define SHARED_HEADER_SIZE 4096
+#define SHARED_INTERVAL 65536		// default cycles between two publishes
+
+struct shared_frame
+{
+	uint64_t Generation;			// only accessed atomically
+	uint64_t Clock;				// memory::Clock and the registers the frame was published with
+	struct CPU cpu;
+	uint32_t DataOffset;			// of the frame's copy of Data from the start of the segment
+};
+
+struct shared_header
+{
+	char Magic[4];
+	uint32_t Version;
+	uint32_t DataOffset;			// of the live memory::Data from the start of the segment
+	uint32_t DataSize;
+	uint64_t Interval;
+	uint64_t NextPublish;			// emulator side
+	uint64_t Published;			// publishes so far, only accessed atomically, Frames[Published & 1] is the newest
+	struct shared_frame Frames[2];
+};
+
+struct shared_memory
+{
+	int Fd;
+	size_t Size;
+	byte* Mapping;				// the header page, the two frames, then mem
+	struct memory* mem;			// the instance to run, ResetCpu() it and attach
+	char Name[64];				// empty for a memfd
+};
+
+struct shared_view
+{
+	int Fd;
+	size_t Size;
+	const byte* Mapping;
+	const struct shared_header* Header;
+	const byte* Data;			// live guest RAM, Header->DataSize bytes
+};
+
+bool CreateSharedMemory(struct shared_memory*, const char*);
+void AttachSharedMemory(struct shared_memory*, const struct CPU*, const uint64_t);
+void DestroySharedMemory(struct shared_memory*);
+uint64_t SharedTick(const struct CPU*, struct memory*, const uint64_t);
+void PublishShared(const struct CPU*, struct memory*);
+bool OpenSharedView(struct shared_view*, const char*, const int);
+void CloseSharedView(struct shared_view*);
+bool SharedSnapshot(const struct shared_view*, byte*, struct CPU*, uint64_t*);
+
+void SkipIdleLoop(struct CPU*, struct memory*, const word, size_t*);
+bool RunBulkLoop(struct CPU*, struct memory*, const word, size_t*);
+
+void AttachVia(struct via*, struct memory*, const word, const byte);
+
 void ResetCpu(struct CPU* cpu, struct memory* mem);
 uint32_t Execute(struct CPU* cpu, struct memory* mem, size_t cycles);
 
@@ -0,0 +1,182 @@
+#include "6502.h"
+
+// Copy and fill loops that count Y up to zero, recognised at their back edge:
+//
+//	LDA (src),Y / STA (dst),Y / INY / BNE	5 bytes
+//	LDA src,Y / STA dst,Y / INY / BNE		7 bytes
+//	STA (dst),Y / INY / BNE			3 bytes
+//	STA dst,Y / INY / BNE			4 bytes
+//
+// The cycle costs below have to match the interpreter's cases for these opcodes.
+#define BULK_INDY_LOAD 5
+#define BULK_ABSY_LOAD 4
+#define BULK_STORE 5
+#define BULK_INY 2
+
+
+static word ReadPointer(const struct memory* mem, const byte ZeroPageAddress)
+{
+	return mem->Data[ZeroPageAddress] | (mem->Data[(word)(ZeroPageAddress + 1)] << 8);
+}
+
+static bool PlainPages(const struct memory* mem, const word Base, const int Count, const word Mask)
+{
+	for (int Page = Base >> 8; Page <= (Base + Count - 1) >> 8; Page++)
+	{
+		if (mem->PageFlags[Page] & Mask)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool Overlaps(const int Base1, const int Count1, const int Base2, const int Count2)
+{
+	return Base1 < Base2 + Count2 && Base2 < Base1 + Count1;
+}
+
+// Called on a taken backward BNE once the first iteration has run. Runs as many of the
+// remaining iterations as fit before the slice deadline with one memmove/memset, leaving
+// registers, flags, cycles and memory exactly as the interpreter would. Returns false if
+// the loop isn't one of the idioms or touches anything but plain RAM.
+bool RunBulkLoop(struct CPU* cpu, struct memory* mem, const word Branch, size_t* Cycles)
+{
+	const word Head = cpu->pc;
+	const byte* Code = &mem->Data[Head];
+	int Src = -1;
+	int Dst;
+	int Load = 0;
+	int Pointers[2] = { -1, -1 };
+
+	if ((mem->PageFlags[Head >> 8] | mem->PageFlags[Branch >> 8]) & (PAGE_BREAK | PAGE_BANK))
+	{
+		return false;
+	}
+
+	switch (Branch - Head)
+	{
+	case 5:
+	{
+		if (Code[0] != LDA_INDY || Code[2] != STA_INDY || Code[4] != INY_IM)
+		{
+			return false;
+		}
+		Pointers[0] = Code[1];
+		Pointers[1] = Code[3];
+		Src = ReadPointer(mem, Code[1]);
+		Dst = ReadPointer(mem, Code[3]);
+		Load = BULK_INDY_LOAD;
+	} break;
+	case 7:
+	{
+		if (Code[0] != LDA_ABSY || Code[3] != STA_ABSY || Code[6] != INY_IM)
+		{
+			return false;
+		}
+		Src = Code[1] | (Code[2] << 8);
+		Dst = Code[4] | (Code[5] << 8);
+		Load = BULK_ABSY_LOAD;
+	} break;
+	case 3:
+	{
+		if (Code[0] != STA_INDY || Code[2] != INY_IM)
+		{
+			return false;
+		}
+		Pointers[0] = Code[1];
+		Dst = ReadPointer(mem, Code[1]);
+	} break;
+	case 4:
+	{
+		if (Code[0] != STA_ABSY || Code[3] != INY_IM)
+		{
+			return false;
+		}
+		Dst = Code[1] | (Code[2] << 8);
+	} break;
+	default:
+	{
+		return false;
+	}
+	}
+
+	const int Y = cpu->y;
+	const int Count = 256 - Y;		// BNE was taken, so Y isn't zero
+	if (Dst + 255 > 0xFFFF || Src + 255 > 0xFFFF
+		|| !PlainPages(mem, Dst + Y, Count, PAGE_IO | PAGE_WATCH | PAGE_LEARN | PAGE_BANK)
+		|| (Load && !PlainPages(mem, Src + Y, Count, PAGE_READ_SLOW))
+		|| Overlaps(Dst + Y, Count, Head, Branch + 2 - Head))
+	{
+		return false;
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		if (Pointers[i] >= 0 && (Overlaps(Dst + Y, Count, Pointers[i], 2) || !PlainPages(mem, Pointers[i], 2, PAGE_READ_SLOW)))
+		{
+			return false;
+		}
+	}
+
+	// every iteration but the last takes the branch, the last one also pays the LDA page
+	// penalty the interpreter charges at Y = 255
+	const uint64_t Taken = 3 + (((Branch + 2) >> 8) != (Head >> 8) ? 2 : 0);
+	const uint64_t Iteration = Load + BULK_STORE + BULK_INY + Taken;
+	const uint64_t Last = Load + (Load ? 1 : 0) + BULK_STORE + BULK_INY + 2;
+	const uint64_t Now = mem->Clock - *Cycles;
+	const uint64_t Budget = mem->Deadline > Now ? mem->Deadline - Now : 0;
+
+	int Iterations = Count;
+	bool Finished = true;
+	if ((Count - 1) * Iteration + Last > Budget)
+	{
+		Iterations = Budget / Iteration < (uint64_t)(Count - 1) ? (int)(Budget / Iteration) : Count - 1;
+		Finished = false;
+	}
+	if (!Iterations)
+	{
+		return false;
+	}
+
+	for (int Page = (Dst + Y) >> 8; Page <= (Dst + Y + Iterations - 1) >> 8; Page++)
+	{
+		if (mem->PageFlags[Page] & PAGE_TRACK)
+		{
+			TimelineSavePage(mem, Page << 8);
+		}
+	}
+
+	HashRange(mem, Dst + Y, Iterations);	// out with the old bytes, in with the new ones below
+	byte* To = &mem->Data[Dst + Y];
+	if (Load)
+	{
+		const byte* From = &mem->Data[Src + Y];
+		if (To > From && To < From + Iterations)
+		{
+			for (int i = 0; i < Iterations; i++)	// forward overlap, replicate like the guest does
+			{
+				To[i] = From[i];
+			}
+			cpu->acc = To[Iterations - 1];
+		}
+		else
+		{
+			cpu->acc = From[Iterations - 1];
+			memmove(To, From, Iterations);
+		}
+	}
+	else
+	{
+		memset(To, cpu->acc, Iterations);
+	}
+	HashRange(mem, Dst + Y, Iterations);
+
+	cpu->y = Y + Iterations;
+	cpu->Flags[zeroFlag] = cpu->y == 0;
+	cpu->Flags[negativeFlag - 1] = (cpu->y & 0x80) > 0;
+	cpu->pc = Finished ? Branch + 2 : Head;
+
+	*Cycles -= (Iterations - 1) * Iteration + (Finished ? Last : Iteration);
+	mem->Instructions += Iterations * (Load ? 4 : 3);
+	return true;
+}
@@ -0,0 +1,118 @@
+#include "6502.h"
+
+
+void AttachDevice(struct memory* mem, const word Base, const word Size, BusReadHandler Read, BusWriteHandler Write, void* Context)
+{
+	for (int Page = Base >> 8; Page <= (Base + Size - 1) >> 8 && Page < NUM_PAGES; Page++)
+	{
+		mem->Devices[Page].Read = Read;
+		mem->Devices[Page].Write = Write;
+		mem->Devices[Page].Context = Context;
+		mem->PageFlags[Page] |= PAGE_IO;
+	}
+}
+
+void DetachDevice(struct memory* mem, const word Base, const word Size)
+{
+	for (int Page = Base >> 8; Page <= (Base + Size - 1) >> 8 && Page < NUM_PAGES; Page++)
+	{
+		memset(&mem->Devices[Page], 0, sizeof(mem->Devices[Page]));
+		mem->PageFlags[Page] &= ~PAGE_IO;
+	}
+}
+
+// Devices are bypassed while the time-travel timeline or an input log replays their inputs
+bool DevicesFrozen(const struct memory* mem)
+{
+	return (mem->Timeline && mem->Timeline->Replaying) || (mem->Recorder && mem->Recorder->Replaying);
+}
+
+// Slow path of ReadByte, only taken for pages with a PAGE_FLAGS bit set
+byte BusRead(struct memory* mem, const word Address, const size_t Cycles)
+{
+	const struct device* Device = &mem->Devices[Address >> 8];
+	mem->BusAccesses++;
+	if (mem->PageFlags[Address >> 8] & PAGE_LEARN)
+	{
+		MemoRecordRead(mem, Address);
+	}
+	if (mem->PageFlags[Address >> 8] & PAGE_WATCH)
+	{
+		HitBreakpoint(mem, Address, BREAK_READ);
+	}
+	if ((mem->PageFlags[Address >> 8] & PAGE_IO) && Device->Read)
+	{
+		if (mem->Timeline && mem->Timeline->Replaying)
+		{
+			return ReplayRead(mem, Address);
+		}
+
+		const bool Replaying = mem->Recorder && mem->Recorder->Replaying;
+		const byte Data = Replaying ? RecorderReplayRead(mem, Address) : Device->Read(mem, Address, mem->Clock - Cycles, Device->Context);
+		if (mem->Timeline)
+		{
+			RecordRead(mem, Address, Data, mem->Clock - Cycles);
+		}
+		if (mem->Recorder && !Replaying)
+		{
+			RecorderRecordRead(mem, Data, mem->Clock - Cycles);
+		}
+		return Data;
+	}
+	if (mem->PageFlags[Address >> 8] & PAGE_BANK)
+	{
+		return MapperRead(mem, Address);
+	}
+	return mem->Data[Address];
+}
+
+// Slow path of WriteByte
+void BusWrite(struct memory* mem, const word Address, const byte Data, const size_t Cycles)
+{
+	const struct device* Device = &mem->Devices[Address >> 8];
+	mem->BusAccesses++;
+	if (mem->PageFlags[Address >> 8] & PAGE_LEARN)
+	{
+		MemoRecordWrite(mem, Address, Data);
+	}
+	if (mem->PageFlags[Address >> 8] & PAGE_WATCH)
+	{
+		HitBreakpoint(mem, Address, BREAK_WRITE);
+	}
+	if (mem->PageFlags[Address >> 8] & PAGE_TRACK)
+	{
+		TimelineSavePage(mem, Address);
+	}
+	if (mem->PageFlags[Address >> 8] & PAGE_IO)
+	{
+		if (Device->Write && !DevicesFrozen(mem))
+		{
+			Device->Write(mem, Address, Data, mem->Clock - Cycles, Device->Context);
+		}
+		return;
+	}
+	if ((mem->PageFlags[Address >> 8] & PAGE_BANK) && MapperWrite(mem, Address, Data))
+	{
+		return;
+	}
+	if (mem->PageFlags[Address >> 8] & PAGE_HASH)
+	{
+		mem->DataHash ^= HashByte(Address, mem->Data[Address]) ^ HashByte(Address, Data);
+	}
+	mem->Data[Address] = Data;
+}
+
+// Stores into guest memory from the host side: devices keeping registers in Data, injected
+// inputs, replayed results. Keeps undo pages and the memory hash in step, no watchpoints.
+void StoreByte(struct memory* mem, const word Address, const byte Data)
+{
+	if (mem->PageFlags[Address >> 8] & PAGE_TRACK)
+	{
+		TimelineSavePage(mem, Address);
+	}
+	if (mem->PageFlags[Address >> 8] & PAGE_HASH)
+	{
+		mem->DataHash ^= HashByte(Address, mem->Data[Address]) ^ HashByte(Address, Data);
+	}
+	mem->Data[Address] = Data;
+}
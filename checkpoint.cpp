@@ -0,0 +1,208 @@
+#include "6502.h"
+
+#define CHECKPOINT_MAGIC "H6CP"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_SIZE 21	// magic, version, start, interval
+#define CHECKPOINT_RECORD_SIZE 24
+
+
+static void PutQword(FILE* Stream, const uint64_t Value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		putc((Value >> (i * 8)) & 0xFF, Stream);
+	}
+}
+
+static bool GetQword(FILE* Stream, uint64_t* Value)
+{
+	*Value = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		const int c = getc(Stream);
+		if (c == EOF)
+		{
+			return false;
+		}
+		*Value |= (uint64_t)c << (i * 8);
+	}
+	return true;
+}
+
+// Order dependent, so two runs going through the same states in a different order differ too
+static uint64_t Fold(const uint64_t Rolling, const uint64_t State)
+{
+	const uint64_t x = ((Rolling << 7 | Rolling >> 57) ^ State) * 0x9E3779B97F4A7C15ull;
+	return x ^ (x >> 32);
+}
+
+bool StartCheckpoints(struct checkpoints* Checkpoints, struct memory* mem, FILE* Stream, const uint64_t Interval)
+{
+	memset(Checkpoints, 0, sizeof(*Checkpoints));
+	Checkpoints->Stream = Stream;
+	Checkpoints->Start = mem->Clock;
+	Checkpoints->Interval = Interval ? Interval : 1;
+	Checkpoints->Next = mem->Clock + Checkpoints->Interval;
+	EnableMemoryHash(mem);
+
+	fwrite(CHECKPOINT_MAGIC, 1, 4, Stream);
+	putc(CHECKPOINT_VERSION, Stream);
+	PutQword(Stream, Checkpoints->Start);
+	PutQword(Stream, Checkpoints->Interval);
+
+	mem->Checkpoints = Checkpoints;
+	return !ferror(Stream);
+}
+
+// Memory hashing stays on, the host may still be using it
+void StopCheckpoints(struct memory* mem)
+{
+	if (mem->Checkpoints)
+	{
+		fflush(mem->Checkpoints->Stream);
+	}
+	mem->Checkpoints = NULL;
+}
+
+// Called at every slice boundary, returns the cycle the next record is due at so the
+// dispatch loop stops there
+uint64_t CheckpointTick(const struct CPU* cpu, struct memory* mem, const uint64_t Now)
+{
+	struct checkpoints* Checkpoints = mem->Checkpoints;
+	if (Now >= Checkpoints->Next)
+	{
+		Checkpoints->Rolling = Fold(Checkpoints->Rolling, StateHash(cpu, mem));
+		PutQword(Checkpoints->Stream, Now);
+		PutQword(Checkpoints->Stream, mem->Instructions);
+		PutQword(Checkpoints->Stream, Checkpoints->Rolling);
+		Checkpoints->Count++;
+		Checkpoints->Next += ((Now - Checkpoints->Next) / Checkpoints->Interval + 1) * Checkpoints->Interval;
+	}
+	return Checkpoints->Next;
+}
+
+// Reads the header and returns the number of records, -1 if it isn't a checkpoint file
+static int64_t OpenCheckpoints(FILE* Stream, uint64_t* Start, uint64_t* Interval)
+{
+	char Magic[4];
+	if (fseek(Stream, 0, SEEK_SET) || fread(Magic, 1, 4, Stream) != 4 || memcmp(Magic, CHECKPOINT_MAGIC, 4)
+		|| getc(Stream) != CHECKPOINT_VERSION || !GetQword(Stream, Start) || !GetQword(Stream, Interval) || fseek(Stream, 0, SEEK_END))
+	{
+		return -1;
+	}
+	const long Size = ftell(Stream);
+	return Size < CHECKPOINT_HEADER_SIZE ? -1 : (Size - CHECKPOINT_HEADER_SIZE) / CHECKPOINT_RECORD_SIZE;
+}
+
+static bool ReadRecord(FILE* Stream, const int64_t Index, struct checkpoint_record* Record)
+{
+	return !fseek(Stream, CHECKPOINT_HEADER_SIZE + Index * CHECKPOINT_RECORD_SIZE, SEEK_SET)
+		&& GetQword(Stream, &Record->Clock) && GetQword(Stream, &Record->Instructions) && GetQword(Stream, &Record->Hash);
+}
+
+static bool SameRecord(FILE* Expected, FILE* Actual, const int64_t Index)
+{
+	struct checkpoint_record a;
+	struct checkpoint_record b;
+	return ReadRecord(Expected, Index, &a) && ReadRecord(Actual, Index, &b)
+		&& a.Clock == b.Clock && a.Instructions == b.Instructions && a.Hash == b.Hash;
+}
+
+// Both files have to be seekable. Since every hash covers the whole run up to its record,
+// the first differing record is found by bisection: a multi-gigacycle run costs a few dozen
+// record reads. Returns 1 and fills Window if the runs diverged, 0 if they agree, -1 if a
+// file is broken or the two weren't taken with the same start and interval.
+int CompareCheckpoints(FILE* Expected, FILE* Actual, struct checkpoint_window* Window)
+{
+	uint64_t Start[2];
+	uint64_t Interval[2];
+	const int64_t Count[2] = { OpenCheckpoints(Expected, &Start[0], &Interval[0]), OpenCheckpoints(Actual, &Start[1], &Interval[1]) };
+	if (Count[0] < 0 || Count[1] < 0 || Start[0] != Start[1] || Interval[0] != Interval[1])
+	{
+		return -1;
+	}
+
+	const int64_t Common = Count[0] < Count[1] ? Count[0] : Count[1];
+	int64_t Low = 0;			// records before Low agree
+	int64_t High = Common;			// the one at High differs or is past the end
+	while (Low < High)
+	{
+		const int64_t Middle = Low + (High - Low) / 2;
+		if (SameRecord(Expected, Actual, Middle))
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+	if (Low == Common && Count[0] == Count[1])
+	{
+		return 0;
+	}
+
+	memset(Window, 0, sizeof(*Window));
+	Window->Index = Low;
+	Window->Start.Clock = Start[0];
+	if (Low > 0)
+	{
+		ReadRecord(Expected, Low - 1, &Window->Start);
+	}
+	if (Low < Count[0])
+	{
+		ReadRecord(Expected, Low, &Window->End[0]);
+	}
+	if (Low < Count[1])
+	{
+		ReadRecord(Actual, Low, &Window->End[1]);
+	}
+	return 1;
+}
+
+// One line per instruction, before it runs: cycle, instruction count, pc, opcode, registers,
+// the raw flag array and the memory hash
+static void TraceInstruction(const struct CPU* cpu, const struct memory* mem, FILE* Stream)
+{
+	char Flags[negativeFlag + 1];
+	for (int i = 0; i < negativeFlag; i++)
+	{
+		Flags[i] = cpu->Flags[i] ? '1' : '0';
+	}
+	Flags[negativeFlag] = 0;
+	fprintf(Stream, "%llu %llu %04X %02X A=%02X X=%02X Y=%02X SP=%02X P=%s M=%016llX\n", (unsigned long long)mem->Clock,
+		(unsigned long long)mem->Instructions, cpu->pc, mem->Data[cpu->pc], cpu->acc, cpu->x, cpu->y, cpu->sp, Flags,
+		(unsigned long long)mem->DataHash);
+}
+
+// The host restores the state the checkpointed run started from. The run is fast forwarded
+// to the start of the window untraced, then stepped and traced up to the later end of the two.
+bool TraceWindow(struct CPU* cpu, struct memory* mem, const struct checkpoint_window* Window, FILE* Stream)
+{
+	const uint64_t End = Window->End[0].Clock > Window->End[1].Clock ? Window->End[0].Clock : Window->End[1].Clock;
+	if (mem->Clock > Window->Start.Clock)
+	{
+		return false;
+	}
+
+	EnableMemoryHash(mem);
+	if (mem->Clock < Window->Start.Clock)
+	{
+		Execute(cpu, mem, Window->Start.Clock - mem->Clock);
+	}
+	if (mem->Clock != Window->Start.Clock)
+	{
+		return false;
+	}
+
+	while (mem->Clock < End)
+	{
+		TraceInstruction(cpu, mem, Stream);
+		Execute(cpu, mem, 1);
+		if (mem->StopReason == STOP_ILLEGAL)
+		{
+			break;
+		}
+	}
+	return !ferror(Stream);
+}
@@ -0,0 +1,62 @@
+#include "6502.h"
+
+// Finds the first window two checkpointed runs disagree in (StartCheckpoints(), functionaltest's
+// fourth argument). Given the save state both runs started from, the window is re-run here with
+// a full instruction trace on stdout; running the tool from each build and diffing the two
+// traces shows the first instruction that went wrong.
+//
+// usage: checkpointdiff expected.h6cp actual.h6cp [start state]
+//
+// exit status 0 if the runs agree, 1 if they diverged, 2 on errors
+
+struct CPU CheckpointDiffcpu;
+struct memory CheckpointDiffmem;
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printf("usage: checkpointdiff expected.h6cp actual.h6cp [start state]\n");
+		return 2;
+	}
+
+	FILE* Expected = fopen(argv[1], "rb");
+	FILE* Actual = fopen(argv[2], "rb");
+	struct checkpoint_window Window;
+	const int Result = Expected && Actual ? CompareCheckpoints(Expected, Actual, &Window) : -1;
+	if (Expected)
+	{
+		fclose(Expected);
+	}
+	if (Actual)
+	{
+		fclose(Actual);
+	}
+	if (Result < 0)
+	{
+		printf("can't compare %s and %s\n", argv[1], argv[2]);
+		return 2;
+	}
+	if (!Result)
+	{
+		printf("runs agree\n");
+		return 0;
+	}
+
+	printf("diverged in window %llu: cycles %llu to %llu / %llu, instructions %llu to %llu / %llu\n",
+		(unsigned long long)Window.Index,
+		(unsigned long long)Window.Start.Clock, (unsigned long long)Window.End[0].Clock, (unsigned long long)Window.End[1].Clock,
+		(unsigned long long)Window.Start.Instructions, (unsigned long long)Window.End[0].Instructions,
+		(unsigned long long)Window.End[1].Instructions);
+	if (argc > 3)
+	{
+		ResetCpu(&CheckpointDiffcpu, &CheckpointDiffmem);
+		if (!LoadStateFile(&CheckpointDiffcpu, &CheckpointDiffmem, argv[3]) || !TraceWindow(&CheckpointDiffcpu, &CheckpointDiffmem, &Window, stdout))
+		{
+			printf("can't re-run the window from %s\n", argv[3]);
+			return 2;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,79 @@
+#include "6502.h"
+
+
+static void UpdatePageFlags(struct memory* mem, const word Address)
+{
+	const int Page = Address >> 8;
+	mem->PageFlags[Page] &= ~(PAGE_BREAK | PAGE_WATCH);
+
+	for (int i = 0; i < MAX_BREAKPOINTS; i++)
+	{
+		const struct breakpoint* Breakpoint = &mem->Breakpoints[i];
+		if (Breakpoint->Type && (Breakpoint->Address >> 8) == Page)
+		{
+			if (Breakpoint->Type & BREAK_EXEC)
+			{
+				mem->PageFlags[Page] |= PAGE_BREAK;
+			}
+			if (Breakpoint->Type & (BREAK_READ | BREAK_WRITE))
+			{
+				mem->PageFlags[Page] |= PAGE_WATCH;
+			}
+		}
+	}
+}
+
+int SetBreakpoint(struct memory* mem, const word Address, const byte Type)
+{
+	int Slot = -1;
+	for (int i = 0; i < MAX_BREAKPOINTS; i++)
+	{
+		if (mem->Breakpoints[i].Type && mem->Breakpoints[i].Address == Address)
+		{
+			Slot = i;
+			break;
+		}
+		if (!mem->Breakpoints[i].Type && Slot < 0)
+		{
+			Slot = i;
+		}
+	}
+	if (Slot < 0)
+	{
+		return -1;
+	}
+
+	mem->Breakpoints[Slot].Address = Address;
+	mem->Breakpoints[Slot].Type |= Type;
+	UpdatePageFlags(mem, Address);
+	return Slot;
+}
+
+void ClearBreakpoint(struct memory* mem, const word Address, const byte Type)
+{
+	for (int i = 0; i < MAX_BREAKPOINTS; i++)
+	{
+		if (mem->Breakpoints[i].Type && mem->Breakpoints[i].Address == Address)
+		{
+			mem->Breakpoints[i].Type &= ~Type;
+		}
+	}
+	UpdatePageFlags(mem, Address);
+}
+
+// Only reached for pages with PAGE_BREAK or PAGE_WATCH set. A hit ends the running
+// slice, Execute() returns once the current instruction has completed.
+bool HitBreakpoint(struct memory* mem, const word Address, const byte Type)
+{
+	for (int i = 0; i < MAX_BREAKPOINTS; i++)
+	{
+		if ((mem->Breakpoints[i].Type & Type) && mem->Breakpoints[i].Address == Address)
+		{
+			mem->StopReason = Type == BREAK_EXEC ? STOP_BREAKPOINT : Type == BREAK_READ ? STOP_WATCH_READ : STOP_WATCH_WRITE;
+			mem->StopAddress = Address;
+			YieldToScheduler(mem);
+			return true;
+		}
+	}
+	return false;
+}
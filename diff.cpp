@@ -0,0 +1,333 @@
+#include "6502.h"
+
+#define DIFF_CODE 0x0200		// program start, a jump-to-self follows the last instruction
+#define DIFF_WINDOW 64			// longest comparison window, in cycles
+#define DIFF_IDIOM_RATE 8		// one generated instruction in DIFF_IDIOM_RATE starts an idiom
+
+struct diff_opcode
+{
+	byte Opcode;
+	byte Length;
+};
+
+// Every opcode the core implements
+static const struct diff_opcode DiffOpcodes[] =
+{
+	{ LDA_IM, 2 }, { LDA_ZP, 2 }, { LDA_ZPX, 2 }, { LDA_ABS, 3 }, { LDA_ABSX, 3 }, { LDA_ABSY, 3 }, { LDA_INDX, 2 }, { LDA_INDY, 2 },
+	{ LDX_IM, 2 }, { LDX_ZP, 2 }, { LDX_ZPY, 2 }, { LDX_ABS, 3 }, { LDX_ABSY, 3 },
+	{ LDY_IM, 2 }, { LDY_ZP, 2 }, { LDY_ZPX, 2 }, { LDY_ABS, 3 }, { LDY_ABSX, 3 },
+	{ STA_ZP, 2 }, { STA_ZPX, 2 }, { STA_ABS, 3 }, { STA_ABSX, 3 }, { STA_ABSY, 3 }, { STA_INDX, 2 }, { STA_INDY, 2 },
+	{ STX_ZP, 2 }, { STX_ZPY, 2 }, { STX_ABS, 3 },
+	{ STY_ZP, 2 }, { STY_ZPX, 2 }, { STY_ABS, 3 },
+	{ TSX, 1 }, { TXS, 1 }, { PHA, 1 }, { PHP, 1 }, { PLA, 1 }, { PLP, 1 },
+	{ AND_IM, 2 }, { AND_ZP, 2 }, { AND_ZPX, 2 }, { AND_ABS, 3 }, { AND_ABSX, 3 }, { AND_ABSY, 3 }, { AND_INDX, 2 }, { AND_INDY, 2 },
+	{ OR_IM, 2 }, { OR_ZP, 2 }, { OR_ZPX, 2 }, { OR_ABS, 3 }, { OR_ABSX, 3 }, { OR_ABSY, 3 }, { OR_INDX, 2 }, { OR_INDY, 2 },
+	{ EOR_IM, 2 }, { EOR_ZP, 2 }, { EOR_ZPX, 2 }, { EOR_ABS, 3 }, { EOR_ABSX, 3 }, { EOR_ABSY, 3 }, { EOR_INDX, 2 }, { EOR_INDY, 2 },
+	{ TAX_IM, 1 }, { TAY_IM, 1 }, { TXA_IM, 1 }, { TYA_IM, 1 },
+	{ INX_IM, 1 }, { DEX_IM, 1 }, { INY_IM, 1 }, { DEY_IM, 1 },
+	{ BEQ, 2 }, { BNE, 2 },
+	{ JSR, 3 }, { RTS, 1 }, { JMP_ABS, 3 }, { JMP_IND, 3 },
+	{ BRK, 1 }, { RTI, 1 }, { SEI, 1 }, { CLI, 1 }
+};
+
+struct diff_idiom
+{
+	int Length;
+	byte Bytes[10];
+};
+
+// Loops and pairs the fast paths look for, using the pointers LoadDiffCase() sets up
+static const struct diff_idiom DiffIdioms[] =
+{
+	{ 7, { LDA_INDY, 0x40, STA_INDY, 0x42, INY_IM, BNE, 0xF9 } },			// (src),Y copy
+	{ 9, { LDA_ABSY, 0x00, 0x30, STA_ABSY, 0x80, 0x31, INY_IM, BNE, 0xF7 } },	// abs,Y copy
+	{ 5, { STA_INDY, 0x42, INY_IM, BNE, 0xFB } },					// (dst),Y fill
+	{ 3, { DEX_IM, BNE, 0xFD } },							// delay loop
+	{ 4, { LDA_ZP, 0x10, BEQ, 0xFC } },						// poll until non-zero
+	{ 4, { LDA_IM, 0x5A, STA_ZP, 0x20 } },
+	{ 6, { LDA_ABSX, 0x00, 0x30, STA_ABSY, 0x00, 0x32 } }
+};
+
+#define NUM_DIFF_OPCODES (int)(sizeof(DiffOpcodes) / sizeof(DiffOpcodes[0]))
+#define NUM_DIFF_IDIOMS (int)(sizeof(DiffIdioms) / sizeof(DiffIdioms[0]))
+
+
+static int OpcodeLength(const byte Opcode)
+{
+	for (int i = 0; i < NUM_DIFF_OPCODES; i++)
+	{
+		if (DiffOpcodes[i].Opcode == Opcode)
+		{
+			return DiffOpcodes[i].Length;
+		}
+	}
+	return 1;
+}
+
+static uint64_t NextRandom(uint64_t* State)
+{
+	uint64_t x = *State;		// xorshift64*
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*State = x;
+	return x * 0x2545F4914F6CDD1Dull;
+}
+
+static void AddInstruction(struct diff_case* Case, int* Offset, const byte* Bytes, const int Length)
+{
+	memcpy(&Case->Code[*Offset], Bytes, Length);
+	Case->Lengths[Case->Count++] = Length;
+	*Offset += Length;
+}
+
+// Appends an idiom instruction by instruction, returns false if it doesn't fit
+static bool AddIdiom(struct diff_case* Case, int* Offset, const struct diff_idiom* Idiom)
+{
+	if (Case->Count + Idiom->Length > DIFF_MAX_INSTRUCTIONS)	// bytes, so never short of instructions
+	{
+		return false;
+	}
+	for (int p = 0; p < Idiom->Length; p += OpcodeLength(Idiom->Bytes[p]))
+	{
+		AddInstruction(Case, Offset, &Idiom->Bytes[p], OpcodeLength(Idiom->Bytes[p]));
+	}
+	return true;
+}
+
+void GenerateDiffCase(struct diff_case* Case, const uint64_t Seed)
+{
+	uint64_t Rng = Seed | 1;
+	memset(Case, 0, sizeof(*Case));
+	Case->Seed = Seed;
+	Case->Cycles = 200 + NextRandom(&Rng) % 800;
+
+	const int Count = 1 + NextRandom(&Rng) % (DIFF_MAX_INSTRUCTIONS - 8);
+	int Offset = 0;
+	while (Case->Count < Count)
+	{
+		const uint64_t r = NextRandom(&Rng);
+		if (r % DIFF_IDIOM_RATE == 0 && AddIdiom(Case, &Offset, &DiffIdioms[(r >> 8) % NUM_DIFF_IDIOMS]))
+		{
+			continue;
+		}
+
+		const struct diff_opcode* Op = &DiffOpcodes[(r >> 8) % NUM_DIFF_OPCODES];
+		byte Bytes[3] = { Op->Opcode, (byte)(r >> 24), (byte)(r >> 32) };
+		if (Op->Opcode == BEQ || Op->Opcode == BNE)
+		{
+			Bytes[1] = (byte)(((r >> 24) & 31) - 16);		// stay near the program
+		}
+		else if (Op->Length == 3 && (r >> 40) & 1)
+		{
+			Bytes[2] = 0x02 + (r >> 41) % 2;			// jump into the program or next to it
+		}
+		else if (Op->Length == 3)
+		{
+			Bytes[2] = 0x30 + (r >> 41) % 4;			// data pages
+		}
+		AddInstruction(Case, &Offset, Bytes, Op->Length);
+	}
+}
+
+// Zero page, stack and four data pages are random, the pointers at $40 and $42 point into
+// the data pages so the indirect modes and copy idioms hit initialised memory
+static void LoadDiffCase(struct CPU* cpu, struct memory* mem, const struct diff_case* Case)
+{
+	uint64_t Rng = Case->Seed ^ 0x9E3779B97F4A7C15ull;
+	ResetCpu(cpu, mem);
+
+	const int Pages[] = { 0x00, 0x01, 0x30, 0x31, 0x32, 0x33 };
+	for (int i = 0; i < (int)(sizeof(Pages) / sizeof(Pages[0])); i++)
+	{
+		for (int j = 0; j < PAGE_SIZE; j += 8)
+		{
+			const uint64_t r = NextRandom(&Rng);
+			memcpy(&mem->Data[(Pages[i] << 8) + j], &r, 8);
+		}
+	}
+	mem->Data[0x0041] = 0x30 + mem->Data[0x0041] % 2;
+	mem->Data[0x0043] = 0x32 + mem->Data[0x0043] % 2;
+
+	const uint64_t r = NextRandom(&Rng);
+	cpu->pc = DIFF_CODE;
+	cpu->acc = (byte)r;
+	cpu->x = (byte)(r >> 8);
+	cpu->y = (byte)(r >> 16);
+	cpu->sp = (byte)(r >> 24);
+	for (int i = 0; i < (int)sizeof(cpu->Flags); i++)
+	{
+		cpu->Flags[i] = (r >> (32 + i)) & 1;
+	}
+
+	int Length = 0;
+	for (int i = 0; i < Case->Count; i++)
+	{
+		Length += Case->Lengths[i];
+	}
+	memcpy(&mem->Data[DIFF_CODE], Case->Code, Length);
+	const word End = DIFF_CODE + Length;
+	mem->Data[End] = JMP_ABS;
+	mem->Data[End + 1] = End & 0xFF;
+	mem->Data[End + 2] = End >> 8;
+
+	const word Vectors[] = { NMI_VECTOR, RESET_VECTOR, IRQ_VECTOR };
+	for (int i = 0; i < 3; i++)
+	{
+		mem->Data[Vectors[i]] = DIFF_CODE & 0xFF;
+		mem->Data[Vectors[i] + 1] = DIFF_CODE >> 8;
+	}
+}
+
+static void RunEngine(const struct diff_engine* Engine, struct CPU* cpu, struct memory* mem, const uint64_t Until)
+{
+	if (!Engine->Stepped)
+	{
+		Execute(cpu, mem, Until - mem->Clock);
+		return;
+	}
+	while (mem->Clock < Until && !mem->StopReason)
+	{
+		Execute(cpu, mem, 1);
+	}
+}
+
+static bool SameState(const struct diff_harness* Harness)
+{
+	const struct CPU* cpu = Harness->cpu;
+	const struct memory* mem = Harness->mem;
+	return cpu[0].pc == cpu[1].pc
+		&& cpu[0].sp == cpu[1].sp
+		&& cpu[0].acc == cpu[1].acc
+		&& cpu[0].x == cpu[1].x
+		&& cpu[0].y == cpu[1].y
+		&& !memcmp(cpu[0].Flags, cpu[1].Flags, sizeof(cpu[0].Flags))
+		&& mem[0].Clock == mem[1].Clock
+		&& mem[0].Instructions == mem[1].Instructions
+		&& mem[0].StopReason == mem[1].StopReason
+		&& !memcmp(mem[0].Data, mem[1].Data, sizeof(mem[0].Data));
+}
+
+void InitDiffHarness(struct diff_harness* Harness, const struct diff_engine* Reference, const struct diff_engine* Candidate)
+{
+	memset(Harness, 0, sizeof(*Harness));
+	Harness->Engines[0] = *Reference;
+	Harness->Engines[1] = *Candidate;
+}
+
+// Runs both engines window by window and compares after each one. Windows are 1 to
+// DIFF_WINDOW cycles, so divergences are caught within a few instructions. Returns true if
+// the engines agreed all the way, otherwise DivergedAt holds the end of the first bad window.
+bool RunDiffCase(struct diff_harness* Harness, const struct diff_case* Case)
+{
+	Harness->Cases++;
+	for (int i = 0; i < 2; i++)
+	{
+		LoadDiffCase(&Harness->cpu[i], &Harness->mem[i], Case);
+		if (Harness->Engines[i].Setup)
+		{
+			Harness->Engines[i].Setup(&Harness->cpu[i], &Harness->mem[i], Harness->Engines[i].Context);
+		}
+	}
+
+	uint64_t Rng = Case->Seed ^ 0xD1B54A32D192ED03ull;
+	uint64_t Until = 0;
+	while (Until < Case->Cycles)
+	{
+		Until += 1 + NextRandom(&Rng) % DIFF_WINDOW;
+		for (int i = 0; i < 2; i++)
+		{
+			RunEngine(&Harness->Engines[i], &Harness->cpu[i], &Harness->mem[i], Until);
+		}
+		if (!SameState(Harness))
+		{
+			Harness->DivergedAt = Until;
+			return false;
+		}
+		if (Harness->mem[0].StopReason)
+		{
+			break;
+		}
+		Until = Harness->mem[0].Clock;
+	}
+	return true;
+}
+
+// Greedy delta debugging: drops single instructions while the case still diverges, then
+// cuts the cycle budget down to the first failing window
+void MinimizeDiffCase(struct diff_harness* Harness, struct diff_case* Case)
+{
+	bool Shrunk = true;
+	while (Shrunk)
+	{
+		Shrunk = false;
+		int Offset = 0;
+		for (int i = 0; i < Case->Count; i++)
+		{
+			struct diff_case Smaller = *Case;
+			const int Length = Case->Lengths[i];
+			memmove(&Smaller.Code[Offset], &Case->Code[Offset + Length], sizeof(Smaller.Code) - Offset - Length);
+			memmove(&Smaller.Lengths[i], &Case->Lengths[i + 1], DIFF_MAX_INSTRUCTIONS - i - 1);
+			Smaller.Count--;
+			if (!RunDiffCase(Harness, &Smaller))
+			{
+				*Case = Smaller;
+				Shrunk = true;
+				break;
+			}
+			Offset += Length;
+		}
+	}
+
+	if (!RunDiffCase(Harness, Case))
+	{
+		Case->Cycles = (uint32_t)Harness->DivergedAt;
+	}
+}
+
+// Runs Cases generated cases starting at Seed. Returns false on the first divergence, with
+// the minimized case in Harness->Failure.
+bool DiffFuzz(struct diff_harness* Harness, const uint64_t Seed, const uint64_t Cases)
+{
+	struct diff_case Case;
+	for (uint64_t i = 0; i < Cases; i++)
+	{
+		GenerateDiffCase(&Case, Seed + i);
+		if (!RunDiffCase(Harness, &Case))
+		{
+			MinimizeDiffCase(Harness, &Case);
+			Harness->Failure = Case;
+			return false;
+		}
+	}
+	return true;
+}
+
+void PrintDiffCase(const struct diff_case* Case, FILE* Stream)
+{
+	fprintf(Stream, "seed %016llx, %u cycles, %d instructions at %04X:\n", (unsigned long long)Case->Seed, Case->Cycles, Case->Count, DIFF_CODE);
+	int Offset = 0;
+	for (int i = 0; i < Case->Count; i++)
+	{
+		fprintf(Stream, "\t%04X:", DIFF_CODE + Offset);
+		for (int j = 0; j < Case->Lengths[i]; j++)
+		{
+			fprintf(Stream, " %02X", Case->Code[Offset + j]);
+		}
+		fprintf(Stream, "\n");
+		Offset += Case->Lengths[i];
+	}
+}
+
+// Candidate engine with every superinstruction enabled, Context is a struct fusion
+void SetupFusedEngine(struct CPU* cpu, struct memory* mem, void* Context)
+{
+	(void)cpu;
+	struct fusion* Fusion = (struct fusion*)Context;
+	if (Fusion->Enabled != (1u << FUSE_COUNT) - 1)
+	{
+		AttachFusion(Fusion, mem);
+		EnableFusions(mem, (1u << FUSE_COUNT) - 1);
+	}
+	mem->Fusion = Fusion;
+}
@@ -0,0 +1,475 @@
+#include <thread>			// before 6502.h, its byte macro breaks the standard headers
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "6502.h"
+
+#define EXPLORE_DEFAULT_NODES 4096	// every pending node holds a full struct memory
+#define EXPLORE_DEFAULT_BATCH 64
+
+// The workers of one Explore(), started once and handed a batch per round: the batch is split
+// by the node the snapshots live on, the workers pull nodes off their own node's queue and then
+// help out on the others, expanding every input of each
+struct explore_round
+{
+	struct explorer* Explorer;
+	const struct numa_topology* Topology;
+	int NumQueues;				// NUMA nodes in use, 1 without Numa
+	const int* Queue[NUMA_MAX_NODES];
+	int Count[NUMA_MAX_NODES];
+	std::atomic<int> Next[NUMA_MAX_NODES];
+	std::mutex Lock;			// guards Visited, NumNodes, Solution and the counters
+	std::mutex PoolLock[NUMA_MAX_NODES];	// one per pool
+	struct instance** Forks;		// one per worker, handed over to the node when its state is kept
+	struct instance** Spares;		// one per worker, the next fork, NULL if the pool ran dry
+	bool Pin;
+
+	std::mutex Handoff;			// guards the fields below
+	std::condition_variable Start;
+	std::condition_variable Done;
+	uint64_t Generation;			// bumped for every batch
+	int Busy;				// workers still on this round
+	bool Quit;
+};
+
+
+void InitExplorer(struct explorer* Explorer, const word HookAddress, const word InputAddress, const byte* Inputs, const int NumInputs,
+	const size_t StepCycles)
+{
+	memset(Explorer, 0, sizeof(*Explorer));
+	Explorer->HookAddress = HookAddress;
+	Explorer->InputAddress = InputAddress;
+	Explorer->NumInputs = NumInputs > 256 ? 256 : NumInputs;
+	memcpy(Explorer->Inputs, Inputs, Explorer->NumInputs);
+	Explorer->StepCycles = StepCycles;
+	Explorer->Threads = std::max(1u, std::thread::hardware_concurrency());
+	Explorer->MaxNodes = EXPLORE_DEFAULT_NODES;
+	Explorer->Batch = EXPLORE_DEFAULT_BATCH;
+	Explorer->Solution = -1;
+}
+
+// Runs to the next hook, false if the budget ran out or something else stopped the guest
+static bool RunToHook(const struct explorer* Explorer, struct CPU* cpu, struct memory* mem)
+{
+	Execute(cpu, mem, Explorer->StepCycles);
+	return mem->StopReason == STOP_BREAKPOINT && cpu->pc == Explorer->HookAddress;
+}
+
+// Adds Hash to the visited set, false if it was there already. Zero marks an empty slot.
+static bool Visit(struct explorer* Explorer, uint64_t Hash)
+{
+	Hash = Hash ? Hash : 1;
+	for (uint64_t i = Hash & Explorer->VisitedMask;; i = (i + 1) & Explorer->VisitedMask)
+	{
+		if (Explorer->Visited[i] == Hash)
+		{
+			return false;
+		}
+		if (!Explorer->Visited[i])
+		{
+			Explorer->Visited[i] = Hash;
+			return true;
+		}
+	}
+}
+
+// mem is copied into a snapshot from pool Home unless Snapshot is false (a goal, never expanded)
+static int AddNode(struct explorer* Explorer, const int Parent, const byte Input, const struct CPU* cpu, const struct memory* mem,
+	const bool Snapshot, const int Home)
+{
+	struct explore_node* Node = &Explorer->Nodes[Explorer->NumNodes];
+	Node->cpu = *cpu;
+	Node->Snapshot = NULL;
+	Node->Home = Home;
+	if (Snapshot)
+	{
+		Node->Snapshot = AllocInstance(&Explorer->Pools[Home]);
+		if (!Node->Snapshot)
+		{
+			return -1;
+		}
+		memcpy(&Node->Snapshot->mem, mem, sizeof(struct memory));
+	}
+	Node->Parent = Parent;
+	Node->Depth = Parent < 0 ? 0 : Explorer->Nodes[Parent].Depth + 1;
+	Node->Score = Explorer->Score ? Explorer->Score(cpu, mem, Explorer->Context) : 0;
+	Node->Input = Input;
+	return Explorer->NumNodes++;
+}
+
+static struct instance* TakeInstance(struct explore_round* Round, const int Home)
+{
+	std::lock_guard<std::mutex> Guard(Round->PoolLock[Home]);
+	return AllocInstance(&Round->Explorer->Pools[Home]);
+}
+
+// Only the visited check and the node index are taken under the lock. A kept state stays where
+// it was run: the fork becomes the node's snapshot and the spare the next fork, so nothing is
+// copied. New nodes are only read once the round is over, so they are filled in afterwards.
+static void ExpandNode(struct explore_round* Round, const int Index, const int Worker, const int Home)
+{
+	struct explorer* Explorer = Round->Explorer;
+	const struct explore_node* Node = &Explorer->Nodes[Index];
+	uint64_t Duplicates = 0;
+
+	for (int i = 0; i < Explorer->NumInputs; i++)
+	{
+		struct CPU* cpu = &Round->Forks[Worker]->cpu;
+		struct memory* mem = &Round->Forks[Worker]->mem;
+		*cpu = Node->cpu;
+		memcpy(mem, &Node->Snapshot->mem, sizeof(*mem));		// StopReason is STOP_BREAKPOINT, so the hook doesn't stop it again
+		StoreByte(mem, Explorer->InputAddress, Explorer->Inputs[i]);
+		const bool AtHook = RunToHook(Explorer, cpu, mem);
+		const bool Goal = Explorer->Goal && Explorer->Goal(cpu, mem, Explorer->Context);
+		const uint64_t Hash = StateHash(cpu, mem);
+		if (AtHook && !Round->Spares[Worker])
+		{
+			Round->Spares[Worker] = TakeInstance(Round, Home);
+		}
+
+		int Added = -1;
+		bool Snapshot = false;
+		{
+			std::lock_guard<std::mutex> Guard(Round->Lock);
+			if (Goal && Explorer->Solution < 0 && Explorer->NumNodes < Explorer->MaxNodes)
+			{
+				Added = Explorer->Solution = Explorer->NumNodes++;
+			}
+			else if (!AtHook || Explorer->NumNodes >= Explorer->MaxNodes || !Round->Spares[Worker])
+			{
+				continue;
+			}
+			else if (!Visit(Explorer, Hash))
+			{
+				Duplicates++;
+				continue;
+			}
+			else
+			{
+				Added = Explorer->NumNodes++;
+				Snapshot = true;
+			}
+		}
+
+		struct explore_node* New = &Explorer->Nodes[Added];
+		New->cpu = *cpu;
+		New->Snapshot = NULL;
+		New->Home = Home;
+		New->Parent = Index;
+		New->Depth = Node->Depth + 1;
+		New->Score = Explorer->Score ? Explorer->Score(cpu, mem, Explorer->Context) : 0;
+		New->Input = Explorer->Inputs[i];
+		if (Snapshot)
+		{
+			New->Snapshot = Round->Forks[Worker];
+			Round->Forks[Worker] = Round->Spares[Worker];
+			Round->Spares[Worker] = NULL;
+		}
+	}
+
+	std::lock_guard<std::mutex> Guard(Round->Lock);
+	Explorer->Explored += Explorer->NumInputs;
+	Explorer->Duplicates += Duplicates;
+}
+
+// New states go to the worker's own node, where its fork was allocated too
+static void ExpandBatch(struct explore_round* Round, const int Worker)
+{
+	const int Home = Round->NumQueues > 1 ? WorkerNode(Round->Topology, Worker) : 0;
+	for (int k = 0; k < Round->NumQueues; k++)
+	{
+		const int q = (Home + k) % Round->NumQueues;
+		for (int i = Round->Next[q]++; i < Round->Count[q]; i = Round->Next[q]++)
+		{
+			ExpandNode(Round, Round->Queue[q][i], Worker, Home);
+		}
+	}
+}
+
+// Sleeps between rounds, the host bumps Generation for every batch and sets Quit at the end
+static void ExploreWorker(struct explore_round* Round, const int Worker)
+{
+	if (Round->Pin)
+	{
+		PinWorker(Round->Topology, Worker);
+	}
+	uint64_t Seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> Guard(Round->Handoff);
+			Round->Start.wait(Guard, [Round, Seen] { return Round->Quit || Round->Generation != Seen; });
+			if (Round->Quit)
+			{
+				return;
+			}
+			Seen = Round->Generation;
+		}
+		ExpandBatch(Round, Worker);
+
+		std::lock_guard<std::mutex> Guard(Round->Handoff);
+		if (!--Round->Busy)
+		{
+			Round->Done.notify_one();
+		}
+	}
+}
+
+// Stable counting sort of the batch by snapshot home into Queues, returns the count per home
+static void SplitBatch(struct explore_round* Round, const int* Batch, const int Count, int* Queues)
+{
+	const struct explore_node* Nodes = Round->Explorer->Nodes;
+	int Start = 0;
+	for (int q = 0; q < Round->NumQueues; q++)
+	{
+		Round->Queue[q] = Queues + Start;
+		Round->Count[q] = 0;
+		Round->Next[q] = 0;
+		for (int i = 0; i < Count; i++)
+		{
+			if (Nodes[Batch[i]].Home == q)
+			{
+				Queues[Start + Round->Count[q]++] = Batch[i];
+			}
+		}
+		Start += Round->Count[q];
+	}
+}
+
+// Breadth-first takes the oldest pending nodes, best-first the highest scores (oldest first on
+// a tie). Nodes before Head are all expanded.
+static int SelectBatch(struct explorer* Explorer, int* Head, int* Batch)
+{
+	while (*Head < Explorer->NumNodes && !Explorer->Nodes[*Head].Snapshot)
+	{
+		(*Head)++;
+	}
+
+	int Count = 0;
+	for (int i = *Head; i < Explorer->NumNodes && (Explorer->Score || Count < Explorer->Batch); i++)
+	{
+		if (Explorer->Nodes[i].Snapshot)
+		{
+			Batch[Count++] = i;
+		}
+	}
+	if (Explorer->Score && Count > Explorer->Batch)
+	{
+		const struct explore_node* Nodes = Explorer->Nodes;
+		std::partial_sort(Batch, Batch + Explorer->Batch, Batch + Count, [Nodes](const int a, const int b)
+			{
+				return Nodes[a].Score != Nodes[b].Score ? Nodes[a].Score > Nodes[b].Score : a < b;
+			});
+		Count = Explorer->Batch;
+	}
+	return Count;
+}
+
+// The guest runs from cpu/mem to the first hook, then the search goes on until Goal is met,
+// nothing is left to expand or MaxNodes states have been kept. The instance isn't changed:
+// the explorer works on copies with memory hashing on and a breakpoint on the hook, and
+// without the timeline, recorder, memo, fusion, stats, coverage, checkpoint and shared memory
+// attachments, which are shared through pointers and not safe to run from several threads.
+// Devices attached with a context have to be stateless for the same reason. With Numa on a
+// multi-node host every worker is pinned to a node and keeps its fork and the states it finds
+// in arenas bound to that node. An instance with a mapper attached isn't explored, its banks
+// live outside the copies. Returns the depth of the solution, -1 if none was found.
+int Explore(struct explorer* Explorer, const struct CPU* cpu, const struct memory* mem)
+{
+	if (mem->Mapper)
+	{
+		Explorer->Solution = -1;
+		return -1;
+	}
+	const auto Start = std::chrono::steady_clock::now();
+	const int Threads = std::max(1, Explorer->Threads);
+	const int Batch = std::max(1, Explorer->Batch);
+	Explorer->Batch = Batch;
+
+	uint64_t Slots = 2;
+	while (Slots < 2 * (uint64_t)Explorer->MaxNodes)
+	{
+		Slots <<= 1;
+	}
+	Explorer->Nodes = new struct explore_node[Explorer->MaxNodes]();	// cache line aligned like the CPU it holds
+	Explorer->Visited = (uint64_t*)calloc(Slots, sizeof(uint64_t));
+	Explorer->VisitedMask = Slots - 1;
+	Explorer->NumNodes = 0;
+	Explorer->Solution = -1;
+	Explorer->Explored = 0;
+	Explorer->Duplicates = 0;
+
+	struct numa_topology Topology;
+	ReadNumaTopology(&Topology);
+	const int NumQueues = Explorer->Numa ? Topology.NumNodes : 1;
+	for (int i = 0; i < NUMA_MAX_NODES; i++)
+	{
+		InitInstancePool(&Explorer->Pools[i], 0);
+		Explorer->Pools[i].Node = NumQueues > 1 && i < NumQueues ? Topology.NodeId[i] : -1;
+	}
+
+	int* Pending = (int*)malloc(2 * Explorer->MaxNodes * sizeof(int));
+	struct instance** Forks = (struct instance**)calloc(Threads, sizeof(struct instance*));
+	struct instance** Spares = (struct instance**)calloc(Threads, sizeof(struct instance*));
+	bool Allocated = Explorer->Nodes && Explorer->Visited && Pending && Forks && Spares && Explorer->MaxNodes > 0;
+	for (int i = 0; Allocated && i < Threads; i++)
+	{
+		Forks[i] = AllocInstance(&Explorer->Pools[NumQueues > 1 ? WorkerNode(&Topology, i) : 0]);
+		Allocated = Forks[i] != NULL;
+	}
+	if (!Allocated)
+	{
+		free(Pending);
+		free(Forks);
+		free(Spares);
+		FreeExplorer(Explorer);
+		return -1;
+	}
+
+	struct CPU* Root = &Forks[0]->cpu;
+	struct memory* RootMem = &Forks[0]->mem;
+	*Root = *cpu;
+	memcpy(RootMem, mem, sizeof(*RootMem));
+	RootMem->Timeline = NULL;
+	RootMem->Recorder = NULL;
+	RootMem->Memo = NULL;
+	RootMem->Fusion = NULL;
+	RootMem->Stats = NULL;
+	RootMem->Coverage = NULL;
+	RootMem->Checkpoints = NULL;
+	RootMem->Shared = NULL;
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		RootMem->PageFlags[Page] &= ~(PAGE_TRACK | PAGE_MEMO | PAGE_LEARN);
+	}
+	EnableMemoryHash(RootMem);
+	SetBreakpoint(RootMem, Explorer->HookAddress, BREAK_EXEC);
+
+	const bool AtHook = RunToHook(Explorer, Root, RootMem);
+	if (Explorer->Goal && Explorer->Goal(Root, RootMem, Explorer->Context))
+	{
+		Explorer->Solution = AddNode(Explorer, -1, 0, Root, RootMem, false, 0);
+	}
+	else if (AtHook)
+	{
+		Visit(Explorer, StateHash(Root, RootMem));
+		AddNode(Explorer, -1, 0, Root, RootMem, true, 0);
+	}
+
+	struct explore_round Round;
+	Round.Explorer = Explorer;
+	Round.Topology = &Topology;
+	Round.NumQueues = NumQueues;
+	Round.Forks = Forks;
+	Round.Spares = Spares;
+	Round.Pin = NumQueues > 1;
+	Round.Generation = 0;
+	Round.Busy = 0;
+	Round.Quit = false;
+
+	// pinned workers all get a thread of their own, the host's thread stays where it was
+	const int Local = Round.Pin ? 0 : 1;
+	const int Spawned = Threads - Local;
+	std::thread* Workers = new std::thread[Spawned];
+	for (int i = 0; i < Spawned; i++)
+	{
+		Workers[i] = std::thread(ExploreWorker, &Round, i + Local);
+	}
+
+	int Head = 0;
+	while (Explorer->Solution < 0 && Explorer->NumNodes < Explorer->MaxNodes)
+	{
+		const int Count = SelectBatch(Explorer, &Head, Pending);
+		if (!Count)
+		{
+			break;
+		}
+		SplitBatch(&Round, Pending, Count, Pending + Explorer->MaxNodes);
+
+		{
+			std::lock_guard<std::mutex> Guard(Round.Handoff);
+			Round.Generation++;
+			Round.Busy = Spawned;
+		}
+		Round.Start.notify_all();
+		if (Local)
+		{
+			ExpandBatch(&Round, 0);
+		}
+		{
+			std::unique_lock<std::mutex> Guard(Round.Handoff);
+			Round.Done.wait(Guard, [&Round] { return !Round.Busy; });
+		}
+
+		for (int i = 0; i < Count; i++)
+		{
+			struct explore_node* Node = &Explorer->Nodes[Pending[i]];
+			FreeInstance(&Explorer->Pools[Node->Home], Node->Snapshot);
+			Node->Snapshot = NULL;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> Guard(Round.Handoff);
+		Round.Quit = true;
+	}
+	Round.Start.notify_all();
+	for (int i = 0; i < Spawned; i++)
+	{
+		Workers[i].join();
+	}
+	delete[] Workers;
+
+	for (int i = 0; i < Threads; i++)
+	{
+		const int Home = NumQueues > 1 ? WorkerNode(&Topology, i) : 0;
+		FreeInstance(&Explorer->Pools[Home], Forks[i]);
+		if (Spares[i])
+		{
+			FreeInstance(&Explorer->Pools[Home], Spares[i]);
+		}
+	}
+	free(Pending);
+	free(Forks);
+	free(Spares);
+	const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	Explorer->StatesPerSecond = Seconds > 0 ? Explorer->Explored / Seconds : 0;
+	return Explorer->Solution < 0 ? -1 : Explorer->Nodes[Explorer->Solution].Depth;
+}
+
+// Inputs that lead from the first hook to the solution, in order. Returns how many there
+// are, only the first Max are stored.
+int SolutionInputs(const struct explorer* Explorer, byte* Inputs, const int Max)
+{
+	if (Explorer->Solution < 0)
+	{
+		return 0;
+	}
+	const int Depth = Explorer->Nodes[Explorer->Solution].Depth;
+	for (int i = Explorer->Solution; Explorer->Nodes[i].Parent >= 0; i = Explorer->Nodes[i].Parent)
+	{
+		const int Step = Explorer->Nodes[i].Depth - 1;
+		if (Step < Max)
+		{
+			Inputs[Step] = Explorer->Nodes[i].Input;
+		}
+	}
+	return Depth;
+}
+
+// Releases the nodes, the solution path is gone afterwards
+void FreeExplorer(struct explorer* Explorer)
+{
+	for (int i = 0; i < NUMA_MAX_NODES; i++)
+	{
+		DestroyInstancePool(&Explorer->Pools[i]);
+	}
+	delete[] Explorer->Nodes;
+	free(Explorer->Visited);
+	Explorer->Nodes = NULL;
+	Explorer->Visited = NULL;
+	Explorer->NumNodes = 0;
+	Explorer->Solution = -1;
+}
@@ -0,0 +1,99 @@
+#include <chrono>			// before 6502.h, its byte macro breaks the standard headers
+#include "6502.h"
+
+// Headless runner for Klaus Dormann's 6502_functional_test.bin (github.com/Klaus2m5/6502_65C02_functional_tests).
+// The image is a flat 64 KiB dump assembled to start at 0x0400; every failed check and the final
+// success both end in a jump-to-self, so the run is over once an instruction leaves pc unchanged.
+//
+// usage: functionaltest [image] [success address, hex] [cycle limit] [checkpoint file]
+//
+// With a checkpoint file the run writes a state hash every FUNCTIONAL_TEST_CHECKPOINT cycles,
+// checkpointdiff then compares two builds without a full trace.
+
+#define FUNCTIONAL_TEST_IMAGE "6502_functional_test.bin"
+#define FUNCTIONAL_TEST_START 0x0400
+#define FUNCTIONAL_TEST_SUCCESS 0x3469	// trap address of the default build of the test
+#define FUNCTIONAL_TEST_LIMIT 200000000ULL
+#define FUNCTIONAL_TEST_SLICE 100000
+#define FUNCTIONAL_TEST_CHECKPOINT 1000000
+
+struct CPU FunctionalTestcpu;
+struct memory FunctionalTestmem;
+struct checkpoints FunctionalTestCheckpoints;
+
+
+static bool LoadImage(struct memory* mem, const char* Path)
+{
+	FILE* File = fopen(Path, "rb");
+	if (!File)
+	{
+		return false;
+	}
+	const size_t Size = fread(mem->Data, 1, sizeof(mem->Data), File);
+	fclose(File);
+	return Size > FUNCTIONAL_TEST_START;
+}
+
+int main(int argc, char** argv)
+{
+	const char* Path = argc > 1 ? argv[1] : FUNCTIONAL_TEST_IMAGE;
+	const word Success = argc > 2 ? (word)strtoul(argv[2], NULL, 16) : FUNCTIONAL_TEST_SUCCESS;
+	const uint64_t Limit = argc > 3 ? strtoull(argv[3], NULL, 10) : FUNCTIONAL_TEST_LIMIT;
+
+	ResetCpu(&FunctionalTestcpu, &FunctionalTestmem);
+	if (!LoadImage(&FunctionalTestmem, Path))
+	{
+		printf("can't load %s\n", Path);
+		return 2;
+	}
+	FunctionalTestcpu.pc = FUNCTIONAL_TEST_START;
+
+	FILE* Checkpoints = argc > 4 ? fopen(argv[4], "wb") : NULL;
+	if (argc > 4 && (!Checkpoints || !StartCheckpoints(&FunctionalTestCheckpoints, &FunctionalTestmem, Checkpoints, FUNCTIONAL_TEST_CHECKPOINT)))
+	{
+		printf("can't write %s\n", argv[4]);
+		return 2;
+	}
+
+	bool Trapped = false;
+	const auto Start = std::chrono::steady_clock::now();
+	while (!Trapped && !FunctionalTestmem.StopReason && FunctionalTestmem.Clock < Limit)
+	{
+		Execute(&FunctionalTestcpu, &FunctionalTestmem, FUNCTIONAL_TEST_SLICE);
+		if (FunctionalTestmem.StopReason)
+		{
+			break;
+		}
+
+		const word Pc = FunctionalTestcpu.pc;
+		Execute(&FunctionalTestcpu, &FunctionalTestmem, 1);
+		Trapped = FunctionalTestcpu.pc == Pc;
+	}
+	const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	if (Checkpoints)
+	{
+		StopCheckpoints(&FunctionalTestmem);
+		fclose(Checkpoints);
+	}
+
+	const bool Passed = Trapped && FunctionalTestcpu.pc == Success;
+	if (FunctionalTestmem.StopReason == STOP_ILLEGAL)
+	{
+		printf("FAIL: unimplemented opcode $%02X at $%04X\n", FunctionalTestmem.Data[FunctionalTestmem.StopAddress], FunctionalTestmem.StopAddress);
+	}
+	else if (!Trapped)
+	{
+		printf("FAIL: no trap within %llu cycles, pc $%04X\n", (unsigned long long)Limit, FunctionalTestcpu.pc);
+	}
+	else
+	{
+		printf("%s: trapped at $%04X\n", Passed ? "PASS" : "FAIL", FunctionalTestcpu.pc);
+	}
+
+	printf("instructions %llu, cycles %llu, %.3f s, %.2f MHz\n",
+		(unsigned long long)FunctionalTestmem.Instructions,
+		(unsigned long long)FunctionalTestmem.Clock,
+		Seconds,
+		Seconds > 0 ? FunctionalTestmem.Clock / Seconds / 1e6 : 0.0);
+	return Passed ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#include "6502.h"
+
+#define FUSE_MAX_LENGTH 3
+
+struct fused_sequence
+{
+	int Length;
+	byte Opcodes[FUSE_MAX_LENGTH];
+};
+
+// Same order as FUSED_SEQUENCES, the handlers live in RunFused()
+static const struct fused_sequence FusedSequences[FUSE_COUNT] =
+{
+	{ 2, { LDA_IM, STA_ZP } },
+	{ 2, { LDA_IM, STA_ABS } },
+	{ 2, { LDA_ABSX, STA_ABSY } },
+	{ 2, { DEX_IM, BNE } },
+	{ 2, { DEY_IM, BNE } },
+	{ 2, { INX_IM, BNE } },
+	{ 2, { INY_IM, BNE } },
+	{ 3, { LDA_INDY, STA_INDY, INY_IM } }
+};
+
+
+// Starts out profiling with nothing fused, call ChooseFusions() once the workload has run
+// for a while or EnableFusions() with a set picked from an earlier profile
+void AttachFusion(struct fusion* Fusion, struct memory* mem)
+{
+	memset(Fusion, 0, sizeof(*Fusion));
+	Fusion->Profiling = true;
+	mem->Fusion = Fusion;
+}
+
+void DetachFusion(struct memory* mem)
+{
+	mem->Fusion = NULL;
+}
+
+void ProfileOpcode(struct fusion* Fusion, const byte Opcode)
+{
+	Fusion->Pairs[Fusion->Last][Opcode]++;
+	Fusion->Last = Opcode;
+}
+
+void EnableFusions(struct memory* mem, const uint32_t Enabled)
+{
+	struct fusion* Fusion = mem->Fusion;
+	Fusion->Enabled = Enabled;
+	memset(Fusion->Starts, 0, sizeof(Fusion->Starts));
+	for (int i = 0; i < FUSE_COUNT; i++)
+	{
+		if (Enabled & (1u << i))
+		{
+			Fusion->Starts[FusedSequences[i].Opcodes[0]] = 1;
+		}
+	}
+	Fusion->Profiling = false;	// fused dispatches would skew the counts
+}
+
+// A sequence scores the count of its rarest pair. Enables the MaxSequences best scoring at
+// least MinCount and returns how many that is.
+int ChooseFusions(struct memory* mem, const int MaxSequences, const uint32_t MinCount)
+{
+	const struct fusion* Fusion = mem->Fusion;
+	uint32_t Scores[FUSE_COUNT];
+	for (int i = 0; i < FUSE_COUNT; i++)
+	{
+		const struct fused_sequence* Sequence = &FusedSequences[i];
+		Scores[i] = UINT32_MAX;
+		for (int j = 1; j < Sequence->Length; j++)
+		{
+			const uint32_t Count = Fusion->Pairs[Sequence->Opcodes[j - 1]][Sequence->Opcodes[j]];
+			Scores[i] = Count < Scores[i] ? Count : Scores[i];
+		}
+	}
+
+	uint32_t Enabled = 0;
+	int Chosen = 0;
+	while (Chosen < MaxSequences)
+	{
+		int Best = -1;
+		for (int i = 0; i < FUSE_COUNT; i++)
+		{
+			if (!(Enabled & (1u << i)) && Scores[i] >= MinCount && Scores[i] > 0 && (Best < 0 || Scores[i] > Scores[Best]))
+			{
+				Best = i;
+			}
+		}
+		if (Best < 0)
+		{
+			break;
+		}
+		Enabled |= 1u << Best;
+		Chosen++;
+	}
+
+	EnableFusions(mem, Enabled);
+	return Chosen;
+}
@@ -0,0 +1,110 @@
+#include "6502.h"
+#include <stddef.h>
+
+#define MEMORY_STATE_OFFSET offsetof(struct memory, PageFlags)	// everything after Data
+
+
+// Map is COVERAGE_MAP_SIZE bytes, the caller owns it and clears it between runs
+void AttachCoverage(struct memory* mem, byte* Map)
+{
+	mem->Coverage = Map;
+	mem->CoveragePrev = 0;
+}
+
+void DetachCoverage(struct memory* mem)
+{
+	mem->Coverage = NULL;
+}
+
+static void MarkClean(struct memory* mem)
+{
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		mem->PageFlags[Page] |= PAGE_TRACK;
+	}
+}
+
+// Golden is a ready to run instance: program loaded, traps set and so on. Only the CPU, the
+// memory struct and the selected banks are rolled back between runs, so it is refused if
+// anything else keeping state in host structs is attached: devices, writable banks, a
+// timeline (it owns PAGE_TRACK too), a recorder or a checkpoint writer. Handlers of events
+// scheduled in it must not keep state of their own. Coverage goes into Map if not NULL.
+bool InitFuzzTarget(struct fuzz_target* Target, const struct CPU* GoldenCpu, const struct memory* Golden, byte* Map,
+	const word InputAddress, const word InputSize, const word LengthAddress, const size_t Cycles)
+{
+	if (Golden->Timeline || Golden->Recorder || Golden->Checkpoints || (Golden->Mapper && Golden->Mapper->Writable))
+	{
+		return false;
+	}
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		if (Golden->PageFlags[Page] & PAGE_IO)
+		{
+			return false;
+		}
+	}
+
+	Target->GoldenCpu = *GoldenCpu;
+	for (int i = 0; Golden->Mapper && i < Golden->Mapper->NumSlots; i++)
+	{
+		Target->GoldenBanks[i] = Golden->Mapper->Slots[i].Bank;
+	}
+	memcpy(&Target->Golden, Golden, sizeof(Target->Golden));
+	Target->Golden.Coverage = Map;
+	Target->Golden.CoveragePrev = 0;
+	Target->Golden.Shared = NULL;
+	MarkClean(&Target->Golden);
+
+	Target->InputAddress = InputAddress;
+	Target->InputSize = InputAddress + InputSize > MAX_MEM ? MAX_MEM - InputAddress : InputSize;
+	Target->LengthAddress = LengthAddress;
+	Target->Cycles = Cycles;
+
+	Target->cpu = Target->GoldenCpu;
+	memcpy(&Target->mem, &Target->Golden, sizeof(Target->mem));
+	return true;
+}
+
+static void RestoreGolden(struct fuzz_target* Target)
+{
+	struct memory* mem = &Target->mem;
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		if (!(mem->PageFlags[Page] & PAGE_TRACK))
+		{
+			memcpy(&mem->Data[Page << 8], &Target->Golden.Data[Page << 8], PAGE_SIZE);
+		}
+	}
+	memcpy((byte*)mem + MEMORY_STATE_OFFSET, (const byte*)&Target->Golden + MEMORY_STATE_OFFSET, sizeof(*mem) - MEMORY_STATE_OFFSET);
+	Target->cpu = Target->GoldenCpu;
+
+	for (int i = 0; mem->Mapper && i < mem->Mapper->NumSlots; i++)
+	{
+		if (mem->Mapper->Slots[i].Bank != Target->GoldenBanks[i])
+		{
+			SwitchBank(mem->Mapper, i, Target->GoldenBanks[i]);
+		}
+	}
+}
+
+// Same contract as LLVMFuzzerTestOneInput(): resets the instance, runs one input and
+// returns 0. The guest's view of the input doesn't depend on earlier runs.
+int FuzzOneInput(struct fuzz_target* Target, const byte* Data, const size_t Size)
+{
+	struct memory* mem = &Target->mem;
+	RestoreGolden(Target);
+
+	const word Length = Size < Target->InputSize ? (word)Size : Target->InputSize;
+	for (int i = 0; i < Target->InputSize; i++)
+	{
+		StoreByte(mem, Target->InputAddress + i, i < Length ? Data[i] : 0);	// clears PAGE_TRACK
+	}
+	if (Target->LengthAddress)
+	{
+		StoreByte(mem, Target->LengthAddress, Length & 0xFF);
+		StoreByte(mem, Target->LengthAddress + 1, Length >> 8);
+	}
+
+	Execute(&Target->cpu, mem, Target->Cycles);
+	return 0;
+}
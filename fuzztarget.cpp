@@ -0,0 +1,59 @@
+// libFuzzer / AFL++ entry points for fuzzing guest code. Build it together with the emulator
+// sources (not the gtest files) and -fsanitize=fuzzer, or with afl-clang-fast++ and AFL++'s
+// libAFLDriver. Configured through the environment:
+//
+//	H6502_GOLDEN	save state to start every run from (SaveStateFile())
+//	H6502_INPUT	input buffer address, hex
+//	H6502_SIZE	input buffer size, hex
+//	H6502_LENGTH	where the input length goes, hex, optional
+//	H6502_CYCLES	cycles per run, decimal, default 1000000
+#include "6502.h"
+
+// libFuzzer picks up counters in this section as extra coverage next to its own
+#if defined(__linux__)
+__attribute__((used, section("__libfuzzer_extra_counters")))
+#endif
+static byte GuestCoverage[COVERAGE_MAP_SIZE];
+
+extern "C" byte* __afl_area_ptr __attribute__((weak));	// AFL++'s shared map, when linked in
+
+static struct fuzz_target Target;
+static struct CPU GoldenCpu;
+static struct memory Golden;
+
+
+static unsigned long Setting(const char* Name, const int Base, const unsigned long Default)
+{
+	const char* Value = getenv(Name);
+	return Value ? strtoul(Value, NULL, Base) : Default;
+}
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+	(void)argc;
+	(void)argv;
+	const char* Path = getenv("H6502_GOLDEN");
+	ResetCpu(&GoldenCpu, &Golden);
+	if (!Path || !LoadStateFile(&GoldenCpu, &Golden, Path))
+	{
+		fprintf(stderr, "H6502_GOLDEN has to name a save state\n");
+		exit(1);
+	}
+
+	byte* Map = &__afl_area_ptr && __afl_area_ptr ? __afl_area_ptr : GuestCoverage;
+	if (!InitFuzzTarget(&Target, &GoldenCpu, &Golden, Map,
+		(word)Setting("H6502_INPUT", 16, 0x0200),
+		(word)Setting("H6502_SIZE", 16, 0x0100),
+		(word)Setting("H6502_LENGTH", 16, 0),
+		Setting("H6502_CYCLES", 10, 1000000)))
+	{
+		fprintf(stderr, "H6502_GOLDEN can't be fuzzed\n");
+		exit(1);
+	}
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* Data, size_t Size)
+{
+	return FuzzOneInput(&Target, Data, Size);
+}
@@ -0,0 +1,96 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestBulkLoopcpu;
+struct memory gtestBulkLoopmem;
+struct CPU gtestBulkLoopRefcpu;
+struct memory gtestBulkLoopRefmem;
+
+
+// Loop at 0x0200 followed by a jump-to-self, source data at 0x3000
+static void LoadBulkProgram(struct CPU* cpu, struct memory* mem, const byte* Loop, const int Length, const bool Interpret)
+{
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	cpu->acc = 0x5A;
+	cpu->y = 0x10;
+
+	memcpy(&mem->Data[0x0200], Loop, Length);
+	mem->Data[0x0200 + Length] = JMP_ABS;
+	mem->Data[0x0201 + Length] = Length;
+	mem->Data[0x0202 + Length] = 0x02;
+
+	mem->Data[0x0040] = 0x00;		// src pointer
+	mem->Data[0x0041] = 0x30;
+	mem->Data[0x0042] = 0x80;		// dst pointer
+	mem->Data[0x0043] = 0x40;
+	for (int i = 0; i < 0x200; i++)
+	{
+		mem->Data[0x3000 + i] = (byte)(i * 7 + 1);
+	}
+
+	if (Interpret)
+	{
+		SetBreakpoint(mem, 0x02F0, BREAK_EXEC);	// a breakpoint on the loop page keeps the recognizer out
+	}
+}
+
+static void ExpectSameBulkState(const size_t Budget)
+{
+	Execute(&gtestBulkLoopcpu, &gtestBulkLoopmem, Budget);
+	Execute(&gtestBulkLoopRefcpu, &gtestBulkLoopRefmem, Budget);
+
+	EXPECT_EQ(gtestBulkLoopmem.Clock, gtestBulkLoopRefmem.Clock);
+	EXPECT_EQ(gtestBulkLoopmem.Instructions, gtestBulkLoopRefmem.Instructions);
+	EXPECT_EQ(gtestBulkLoopcpu.pc, gtestBulkLoopRefcpu.pc);
+	EXPECT_EQ(gtestBulkLoopcpu.acc, gtestBulkLoopRefcpu.acc);
+	EXPECT_EQ(gtestBulkLoopcpu.y, gtestBulkLoopRefcpu.y);
+	EXPECT_EQ(memcmp(gtestBulkLoopcpu.Flags, gtestBulkLoopRefcpu.Flags, sizeof(gtestBulkLoopcpu.Flags)), 0);
+	EXPECT_EQ(memcmp(gtestBulkLoopmem.Data, gtestBulkLoopRefmem.Data, sizeof(gtestBulkLoopmem.Data)), 0);
+}
+
+
+TEST(testBulkLoop, COPY_INDY_TEST)
+{
+	const byte Loop[] = { LDA_INDY, 0x40, STA_INDY, 0x42, INY_IM, BNE, 0xF9 };
+	LoadBulkProgram(&gtestBulkLoopcpu, &gtestBulkLoopmem, Loop, sizeof(Loop), false);
+	LoadBulkProgram(&gtestBulkLoopRefcpu, &gtestBulkLoopRefmem, Loop, sizeof(Loop), true);
+
+	ExpectSameBulkState(4000);
+	EXPECT_EQ(gtestBulkLoopcpu.pc, 0x0207);
+	EXPECT_EQ(gtestBulkLoopcpu.y, 0);
+	EXPECT_EQ(memcmp(&gtestBulkLoopmem.Data[0x4090], &gtestBulkLoopmem.Data[0x3010], 0xF0), 0);
+}
+
+TEST(testBulkLoop, COPY_OVERLAP_TEST)
+{
+	const byte Loop[] = { LDA_ABSY, 0x00, 0x30, STA_ABSY, 0x03, 0x30, INY_IM, BNE, 0xF7 };
+	LoadBulkProgram(&gtestBulkLoopcpu, &gtestBulkLoopmem, Loop, sizeof(Loop), false);
+	LoadBulkProgram(&gtestBulkLoopRefcpu, &gtestBulkLoopRefmem, Loop, sizeof(Loop), true);
+
+	ExpectSameBulkState(4000);
+	EXPECT_EQ(gtestBulkLoopmem.Data[0x3013], gtestBulkLoopmem.Data[0x3010]);
+}
+
+TEST(testBulkLoop, FILL_TEST)
+{
+	const byte Loop[] = { STA_ABSY, 0x00, 0x50, INY_IM, BNE, 0xFA };
+	LoadBulkProgram(&gtestBulkLoopcpu, &gtestBulkLoopmem, Loop, sizeof(Loop), false);
+	LoadBulkProgram(&gtestBulkLoopRefcpu, &gtestBulkLoopRefmem, Loop, sizeof(Loop), true);
+
+	ExpectSameBulkState(4000);
+	EXPECT_EQ(gtestBulkLoopmem.Data[0x50FF], 0x5A);
+	EXPECT_EQ(gtestBulkLoopmem.Data[0x500F], 0x00);
+}
+
+TEST(testBulkLoop, PARTIAL_SLICE_TEST)
+{
+	const byte Loop[] = { LDA_INDY, 0x40, STA_INDY, 0x42, INY_IM, BNE, 0xF9 };
+	LoadBulkProgram(&gtestBulkLoopcpu, &gtestBulkLoopmem, Loop, sizeof(Loop), false);
+	LoadBulkProgram(&gtestBulkLoopRefcpu, &gtestBulkLoopRefmem, Loop, sizeof(Loop), true);
+
+	for (int i = 0; i < 20; i++)
+	{
+		ExpectSameBulkState(101);
+	}
+}
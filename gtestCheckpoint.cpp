@@ -0,0 +1,132 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestCheckpointcpu;
+struct memory gtestCheckpointmem;
+struct checkpoints gtestCheckpoints;
+struct fusion gtestCheckpointFusion;
+
+
+// Fills 0x1000-0x10FF with its own offsets over and over, an INX/BNE loop
+static void LoadCheckpointProgram(struct CPU* cpu, struct memory* mem)
+{
+	const byte Program[] = {
+		LDX_IM, 0x00,
+		TXA_IM,
+		STA_ABSX, 0x00, 0x10,
+		INX_IM,
+		BNE, 0xF9,
+		JMP_ABS, 0x00, 0x02 };
+
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	memcpy(&mem->Data[0x0200], Program, sizeof(Program));
+}
+
+// 20000 cycles in slices of Slice cycles, with a host write at cycle 5000 if Poke is set
+static FILE* CheckpointRun(const size_t Slice, const bool Poke, const bool Fused)
+{
+	FILE* Stream = tmpfile();
+	LoadCheckpointProgram(&gtestCheckpointcpu, &gtestCheckpointmem);
+	if (Fused)
+	{
+		AttachFusion(&gtestCheckpointFusion, &gtestCheckpointmem);
+		EnableFusions(&gtestCheckpointmem, (1u << FUSE_COUNT) - 1);
+	}
+	EXPECT_TRUE(StartCheckpoints(&gtestCheckpoints, &gtestCheckpointmem, Stream, 1000));
+
+	while (gtestCheckpointmem.Clock < 20000)
+	{
+		const bool Due = Poke && gtestCheckpointmem.Clock < 5000;
+		Execute(&gtestCheckpointcpu, &gtestCheckpointmem, Due && 5000 - gtestCheckpointmem.Clock < Slice ? 5000 - gtestCheckpointmem.Clock : Slice);
+		if (Due && gtestCheckpointmem.Clock >= 5000)
+		{
+			StoreByte(&gtestCheckpointmem, 0x2000, 0x01);
+		}
+	}
+	StopCheckpoints(&gtestCheckpointmem);
+	return Stream;
+}
+
+static int CountLines(FILE* Stream)
+{
+	int Lines = 0;
+	rewind(Stream);
+	for (int c = getc(Stream); c != EOF; c = getc(Stream))
+	{
+		Lines += c == '\n';
+	}
+	return Lines;
+}
+
+
+TEST(testCheckpoint, SLICING_AND_FUSION_TEST)
+{
+	struct checkpoint_window Window;
+	FILE* Plain = CheckpointRun(20000, false, false);
+	EXPECT_EQ(gtestCheckpoints.Count, 20u);
+	FILE* Sliced = CheckpointRun(37, false, false);
+	FILE* Fused = CheckpointRun(1000, false, true);
+	EXPECT_GT(gtestCheckpointFusion.Runs, 0u);
+
+	EXPECT_EQ(CompareCheckpoints(Plain, Sliced, &Window), 0);
+	EXPECT_EQ(CompareCheckpoints(Plain, Fused, &Window), 0);
+	fclose(Plain);
+	fclose(Sliced);
+	fclose(Fused);
+}
+
+TEST(testCheckpoint, DIVERGENT_WINDOW_TEST)
+{
+	struct checkpoint_window Window;
+	FILE* Expected = CheckpointRun(20000, false, false);
+	FILE* Actual = CheckpointRun(700, true, false);
+
+	ASSERT_EQ(CompareCheckpoints(Expected, Actual, &Window), 1);
+	EXPECT_EQ(Window.Index, 5u);		// the record due at cycle 5000 is taken before the write
+	EXPECT_GE(Window.Start.Clock, 5000u);
+	EXPECT_LT(Window.Start.Clock, 5010u);
+	EXPECT_GE(Window.End[0].Clock, 6000u);
+	EXPECT_EQ(Window.End[0].Clock, Window.End[1].Clock);
+	EXPECT_EQ(Window.End[0].Instructions, Window.End[1].Instructions);
+	EXPECT_NE(Window.End[0].Hash, Window.End[1].Hash);
+
+	// about 1000 cycles of 2 to 5 cycle instructions, starting right at the window
+	FILE* Trace = tmpfile();
+	LoadCheckpointProgram(&gtestCheckpointcpu, &gtestCheckpointmem);
+	EXPECT_TRUE(TraceWindow(&gtestCheckpointcpu, &gtestCheckpointmem, &Window, Trace));
+	EXPECT_GE(gtestCheckpointmem.Clock, Window.End[0].Clock);
+	EXPECT_GT(CountLines(Trace), 200);
+	EXPECT_LT(CountLines(Trace), 500);
+
+	unsigned long long Clock = 0;
+	rewind(Trace);
+	EXPECT_EQ(fscanf(Trace, "%llu", &Clock), 1);
+	EXPECT_EQ(Clock, Window.Start.Clock);
+	fclose(Trace);
+	fclose(Expected);
+	fclose(Actual);
+}
+
+TEST(testCheckpoint, MISMATCHED_FILES_TEST)
+{
+	struct checkpoint_window Window;
+	FILE* Empty = tmpfile();
+	FILE* Run = CheckpointRun(20000, false, false);
+	EXPECT_EQ(CompareCheckpoints(Empty, Run, &Window), -1);
+
+	FILE* Longer = tmpfile();
+	LoadCheckpointProgram(&gtestCheckpointcpu, &gtestCheckpointmem);
+	StartCheckpoints(&gtestCheckpoints, &gtestCheckpointmem, Longer, 1000);
+	Execute(&gtestCheckpointcpu, &gtestCheckpointmem, 30000);
+	StopCheckpoints(&gtestCheckpointmem);
+
+	ASSERT_EQ(CompareCheckpoints(Run, Longer, &Window), 1);
+	EXPECT_EQ(Window.Index, 20u);		// agrees for as long as the shorter run went
+	EXPECT_EQ(Window.End[0].Clock, 0u);
+	EXPECT_GE(Window.End[1].Clock, 21000u);
+	EXPECT_LT(Window.End[1].Clock, 21010u);
+	fclose(Empty);
+	fclose(Run);
+	fclose(Longer);
+}
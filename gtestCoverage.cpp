@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestCoveragecpu;
+struct memory gtestCoveragemem;
+struct fuzz_target gtestCoverageTarget;
+byte gtestCoverageMap[COVERAGE_MAP_SIZE];
+
+
+// Parses a two byte input at 0x1000: a non-zero first byte is stored to 0x2000, the
+// subroutine at 0x0300 branches on the second one
+static void LoadCoverageProgram(struct CPU* cpu, struct memory* mem)
+{
+	const byte Main[] = {
+		LDA_ABS, 0x00, 0x10,
+		BEQ, 0x03,
+		STA_ABS, 0x00, 0x20,
+		JSR, 0x00, 0x03,
+		JMP_ABS, 0x0B, 0x02 };
+	const byte Subroutine[] = {
+		LDA_ABS, 0x01, 0x10,
+		BNE, 0x01,
+		TAX_IM,
+		RTS };
+
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	memcpy(&mem->Data[0x0200], Main, sizeof(Main));
+	memcpy(&mem->Data[0x0300], Subroutine, sizeof(Subroutine));
+}
+
+static int CountEdges()
+{
+	int Edges = 0;
+	for (int i = 0; i < COVERAGE_MAP_SIZE; i++)
+	{
+		Edges += gtestCoverageMap[i] != 0;
+	}
+	return Edges;
+}
+
+static void FuzzCoverage(const byte* Input, const size_t Size, byte* Map)
+{
+	memset(gtestCoverageMap, 0, sizeof(gtestCoverageMap));
+	FuzzOneInput(&gtestCoverageTarget, Input, Size);
+	memcpy(Map, gtestCoverageMap, COVERAGE_MAP_SIZE);
+}
+
+
+TEST(testCoverage, EDGES_TEST)
+{
+	LoadCoverageProgram(&gtestCoveragecpu, &gtestCoveragemem);
+	memset(gtestCoverageMap, 0, sizeof(gtestCoverageMap));
+	AttachCoverage(&gtestCoveragemem, gtestCoverageMap);
+
+	Execute(&gtestCoveragecpu, &gtestCoveragemem, 40);
+
+	// BEQ taken, JSR, BNE not taken, RTS, then the jump-to-self looping on one edge
+	EXPECT_EQ(gtestCoveragecpu.pc, 0x020B);
+	EXPECT_EQ(CountEdges(), 5);
+
+	DetachCoverage(&gtestCoveragemem);
+	memset(gtestCoverageMap, 0, sizeof(gtestCoverageMap));
+	Execute(&gtestCoveragecpu, &gtestCoveragemem, 40);
+	EXPECT_EQ(CountEdges(), 0);
+}
+
+TEST(testCoverage, FUZZ_ONE_INPUT_TEST)
+{
+	static byte First[COVERAGE_MAP_SIZE];
+	static byte Other[COVERAGE_MAP_SIZE];
+	static byte Again[COVERAGE_MAP_SIZE];
+	const byte Input[] = { 0x00, 0x00 };
+	const byte Store[] = { 0x5A, 0x01, 0xFF };
+
+	LoadCoverageProgram(&gtestCoveragecpu, &gtestCoveragemem);
+	ASSERT_TRUE(InitFuzzTarget(&gtestCoverageTarget, &gtestCoveragecpu, &gtestCoveragemem, gtestCoverageMap, 0x1000, 2, 0x1010, 60));
+
+	FuzzCoverage(Input, sizeof(Input), First);
+	FuzzCoverage(Store, sizeof(Store), Other);
+	EXPECT_EQ(gtestCoverageTarget.mem.Data[0x2000], 0x5A);
+	EXPECT_EQ(gtestCoverageTarget.mem.Data[0x1010], 2);
+	EXPECT_NE(memcmp(First, Other, COVERAGE_MAP_SIZE), 0);
+
+	FuzzCoverage(Input, 1, Again);
+	EXPECT_EQ(memcmp(First, Again, COVERAGE_MAP_SIZE), 0);
+	EXPECT_EQ(gtestCoverageTarget.mem.Data[0x2000], 0x00);	// restored from the golden image
+	EXPECT_EQ(gtestCoverageTarget.mem.Data[0x1001], 0x00);	// short input zero padded
+	EXPECT_EQ(gtestCoverageTarget.mem.Data[0x1010], 1);
+	EXPECT_EQ(gtestCoverageTarget.cpu.x, 0);
+	EXPECT_EQ(gtestCoverageTarget.mem.Clock, 60u);
+}
+
+TEST(testCoverage, FUZZ_REFUSES_HOST_STATE_TEST)
+{
+	static struct timeline Timeline;
+
+	LoadCoverageProgram(&gtestCoveragecpu, &gtestCoveragemem);
+	AttachDevice(&gtestCoveragemem, 0x9000, PAGE_SIZE, NULL, NULL, NULL);
+	EXPECT_FALSE(InitFuzzTarget(&gtestCoverageTarget, &gtestCoveragecpu, &gtestCoveragemem, NULL, 0x1000, 2, 0, 60));
+	DetachDevice(&gtestCoveragemem, 0x9000, PAGE_SIZE);
+	EXPECT_TRUE(InitFuzzTarget(&gtestCoverageTarget, &gtestCoveragecpu, &gtestCoveragemem, NULL, 0x1000, 2, 0, 60));
+
+	ASSERT_TRUE(AttachTimeline(&Timeline, &gtestCoveragecpu, &gtestCoveragemem, 1000));
+	EXPECT_FALSE(InitFuzzTarget(&gtestCoverageTarget, &gtestCoveragecpu, &gtestCoveragemem, NULL, 0x1000, 2, 0, 60));
+	DetachTimeline(&gtestCoveragemem);
+}
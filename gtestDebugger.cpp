@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestDebugcpu;
+struct memory gtestDebugmem;
+
+
+static void LoadIncrementLoop(struct memory* mem)
+{
+	mem->Data[0xFF00] = INX_IM;
+	mem->Data[0xFF01] = STX_ZP;
+	mem->Data[0xFF02] = 0x42;
+	mem->Data[0xFF03] = LDA_ABS;
+	mem->Data[0xFF04] = 0x00;
+	mem->Data[0xFF05] = 0x80;
+	mem->Data[0xFF06] = JMP_ABS;
+	mem->Data[0xFF07] = 0x00;
+	mem->Data[0xFF08] = 0xFF;
+}
+
+
+TEST(testDebugger, BREAKPOINT_TEST)
+{
+	ResetCpu(&gtestDebugcpu, &gtestDebugmem);
+	gtestDebugcpu.pc = 0xFF00;
+	LoadIncrementLoop(&gtestDebugmem);
+
+	SetBreakpoint(&gtestDebugmem, 0xFF06, BREAK_EXEC);
+
+	uint32_t numCycles = Execute(&gtestDebugcpu, &gtestDebugmem, 1000);
+
+	EXPECT_EQ(numCycles, 2 + 3 + 4);
+	EXPECT_EQ(gtestDebugmem.StopReason, STOP_BREAKPOINT);
+	EXPECT_EQ(gtestDebugmem.StopAddress, 0xFF06);
+	EXPECT_EQ(gtestDebugcpu.pc, 0xFF06);
+
+	numCycles = Execute(&gtestDebugcpu, &gtestDebugmem, 1000);
+
+	EXPECT_EQ(numCycles, 3 + 2 + 3 + 4);
+	EXPECT_EQ(gtestDebugmem.StopReason, STOP_BREAKPOINT);
+	EXPECT_EQ(gtestDebugcpu.x, 2);
+}
+
+TEST(testDebugger, WATCHPOINT_TEST)
+{
+	ResetCpu(&gtestDebugcpu, &gtestDebugmem);
+	gtestDebugcpu.pc = 0xFF00;
+	LoadIncrementLoop(&gtestDebugmem);
+
+	SetBreakpoint(&gtestDebugmem, 0x0042, BREAK_WRITE);
+	SetBreakpoint(&gtestDebugmem, 0x8000, BREAK_READ);
+
+	uint32_t numCycles = Execute(&gtestDebugcpu, &gtestDebugmem, 1000);
+
+	EXPECT_EQ(numCycles, 2 + 3);
+	EXPECT_EQ(gtestDebugmem.StopReason, STOP_WATCH_WRITE);
+	EXPECT_EQ(gtestDebugmem.StopAddress, 0x0042);
+	EXPECT_EQ(gtestDebugmem.Data[0x0042], 1);
+	EXPECT_EQ(gtestDebugcpu.pc, 0xFF03);
+
+	numCycles = Execute(&gtestDebugcpu, &gtestDebugmem, 1000);
+
+	EXPECT_EQ(numCycles, 4);
+	EXPECT_EQ(gtestDebugmem.StopReason, STOP_WATCH_READ);
+	EXPECT_EQ(gtestDebugmem.StopAddress, 0x8000);
+}
+
+TEST(testDebugger, CLEAR_BREAKPOINT_TEST)
+{
+	ResetCpu(&gtestDebugcpu, &gtestDebugmem);
+	gtestDebugcpu.pc = 0xFF00;
+	LoadIncrementLoop(&gtestDebugmem);
+
+	SetBreakpoint(&gtestDebugmem, 0xFF06, BREAK_EXEC);
+	ClearBreakpoint(&gtestDebugmem, 0xFF06, BREAK_EXEC);
+
+	EXPECT_EQ(gtestDebugmem.PageFlags[0xFF], 0);
+
+	uint32_t numCycles = Execute(&gtestDebugcpu, &gtestDebugmem, 12 * 10);
+
+	EXPECT_EQ(numCycles, 120);
+	EXPECT_EQ(gtestDebugmem.StopReason, STOP_NONE);
+	EXPECT_EQ(gtestDebugcpu.x, 10);
+}
@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct diff_harness gtestDiffHarness;
+struct fusion gtestDiffFusion;
+
+static const struct diff_engine gtestDiffStepped = { "stepped", NULL, NULL, true };
+
+
+// A candidate with a bug: page 0x31 reads one more than what was written there
+static byte OffByOneRead(struct memory* mem, const word Address, const uint64_t Now, void* Context)
+{
+	return mem->Data[Address] + 1;
+}
+
+static void OffByOneWrite(struct memory* mem, const word Address, const byte Data, const uint64_t Now, void* Context)
+{
+	mem->Data[Address] = Data;
+}
+
+static void SetupBrokenEngine(struct CPU* cpu, struct memory* mem, void* Context)
+{
+	AttachDevice(mem, 0x3100, PAGE_SIZE, OffByOneRead, OffByOneWrite, NULL);
+}
+
+
+TEST(testDiff, ENGINES_AGREE_TEST)
+{
+	const struct diff_engine Fused = { "fused", SetupFusedEngine, &gtestDiffFusion, false };
+	InitDiffHarness(&gtestDiffHarness, &gtestDiffStepped, &Fused);
+
+	const bool Agreed = DiffFuzz(&gtestDiffHarness, 1, 3000);
+	if (!Agreed)
+	{
+		PrintDiffCase(&gtestDiffHarness.Failure, stdout);
+	}
+	EXPECT_TRUE(Agreed);
+	EXPECT_EQ(gtestDiffHarness.Cases, 3000u);
+	EXPECT_GT(gtestDiffFusion.Runs, 0u);
+}
+
+TEST(testDiff, DIVERGENCE_MINIMIZED_TEST)
+{
+	const struct diff_engine Broken = { "broken", SetupBrokenEngine, NULL, false };
+	InitDiffHarness(&gtestDiffHarness, &gtestDiffStepped, &Broken);
+
+	EXPECT_FALSE(DiffFuzz(&gtestDiffHarness, 1, 3000));
+
+	struct diff_case Failure = gtestDiffHarness.Failure;
+	EXPECT_LE(Failure.Count, 2);
+	EXPECT_FALSE(RunDiffCase(&gtestDiffHarness, &Failure));
+	EXPECT_EQ(gtestDiffHarness.DivergedAt, Failure.Cycles);
+}
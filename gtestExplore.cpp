@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestExplorecpu;
+struct memory gtestExploremem;
+struct explorer gtestExplorer;
+
+
+// A combination lock: the guest waits at 0x0200 for a byte at 0x10, compares it with the
+// secret at 0x0300 + stage and either moves on to the next stage (in 0x20) or starts over
+static void LoadLockProgram(struct CPU* cpu, struct memory* mem, const byte* Secret)
+{
+	const byte Program[] = {
+		LDX_ZP, 0x20,
+		LDA_ZP, 0x10,
+		LDY_IM, 0x00,
+		STY_ZP, 0x10,
+		EOR_ABSX, 0x00, 0x03,
+		BNE, 0x08,
+		INX_IM,
+		STX_ZP, 0x20,
+		LDA_IM, 0x00,
+		JMP_ABS, 0x00, 0x02,
+		LDX_IM, 0x00,
+		STX_ZP, 0x20,
+		LDA_IM, 0x00,
+		JMP_ABS, 0x00, 0x02 };
+
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	memcpy(&mem->Data[0x0200], Program, sizeof(Program));
+	memcpy(&mem->Data[0x0300], Secret, 3);
+}
+
+static bool Unlocked(const struct CPU* cpu, const struct memory* mem, void* Context)
+{
+	return mem->Data[0x20] == 3;
+}
+
+static int64_t Stage(const struct CPU* cpu, const struct memory* mem, void* Context)
+{
+	return mem->Data[0x20];
+}
+
+static void InitLockExplorer(const int Threads)
+{
+	byte Inputs[16];
+	for (int i = 0; i < 16; i++)
+	{
+		Inputs[i] = i;
+	}
+	InitExplorer(&gtestExplorer, 0x0200, 0x0010, Inputs, sizeof(Inputs), 200);
+	gtestExplorer.Goal = Unlocked;
+	gtestExplorer.Threads = Threads;
+}
+
+
+TEST(testExplore, BREADTH_FIRST_TEST)
+{
+	const byte Secret[] = { 0x05, 0x0C, 0x03 };
+	byte Solution[8] = { 0 };
+	LoadLockProgram(&gtestExplorecpu, &gtestExploremem, Secret);
+	InitLockExplorer(4);
+
+	EXPECT_EQ(Explore(&gtestExplorer, &gtestExplorecpu, &gtestExploremem), 3);
+	EXPECT_EQ(SolutionInputs(&gtestExplorer, Solution, sizeof(Solution)), 3);
+	EXPECT_EQ(memcmp(Solution, Secret, sizeof(Secret)), 0);
+
+	// every wrong guess ends in the same reset state, only a handful are kept
+	EXPECT_GT(gtestExplorer.Duplicates, 0u);
+	EXPECT_LE(gtestExplorer.NumNodes, 8);
+	EXPECT_GT(gtestExplorer.StatesPerSecond, 0.0);
+	EXPECT_EQ(gtestExploremem.Data[0x20], 0);	// the caller's instance isn't touched
+	EXPECT_EQ(gtestExploremem.PageFlags[0x02], 0);
+	FreeExplorer(&gtestExplorer);
+}
+
+TEST(testExplore, NUMA_TEST)
+{
+	const byte Secret[] = { 0x0A, 0x01, 0x0E };
+	byte Solution[8] = { 0 };
+	LoadLockProgram(&gtestExplorecpu, &gtestExploremem, Secret);
+	InitLockExplorer(6);
+	gtestExplorer.Numa = true;
+
+	EXPECT_EQ(Explore(&gtestExplorer, &gtestExplorecpu, &gtestExploremem), 3);
+	SolutionInputs(&gtestExplorer, Solution, sizeof(Solution));
+	EXPECT_EQ(memcmp(Solution, Secret, sizeof(Secret)), 0);
+
+	// the forks are back, what is left are the snapshots of nodes never expanded
+	uint64_t Live = 0;
+	int Pending = 0;
+	for (int i = 0; i < NUMA_MAX_NODES; i++)
+	{
+		Live += gtestExplorer.Pools[i].Live;
+	}
+	for (int i = 0; i < gtestExplorer.NumNodes; i++)
+	{
+		Pending += gtestExplorer.Nodes[i].Snapshot != NULL;
+	}
+	EXPECT_EQ(Live, (uint64_t)Pending);
+	FreeExplorer(&gtestExplorer);
+}
+
+TEST(testExplore, BEST_FIRST_TEST)
+{
+	const byte Secret[] = { 0x0F, 0x00, 0x07 };
+	byte Solution[8] = { 0 };
+	LoadLockProgram(&gtestExplorecpu, &gtestExploremem, Secret);
+	InitLockExplorer(2);
+	gtestExplorer.Score = Stage;
+	gtestExplorer.Batch = 1;
+
+	EXPECT_EQ(Explore(&gtestExplorer, &gtestExplorecpu, &gtestExploremem), 3);
+	SolutionInputs(&gtestExplorer, Solution, sizeof(Solution));
+	EXPECT_EQ(memcmp(Solution, Secret, sizeof(Secret)), 0);
+	EXPECT_EQ(gtestExplorer.Explored, 3u * 16);	// always follows the furthest stage
+	FreeExplorer(&gtestExplorer);
+}
+
+TEST(testExplore, UNREACHABLE_TEST)
+{
+	const byte Secret[] = { 0x01, 0x40, 0x02 };	// 0x40 is never offered
+	LoadLockProgram(&gtestExplorecpu, &gtestExploremem, Secret);
+	InitLockExplorer(3);
+
+	EXPECT_EQ(Explore(&gtestExplorer, &gtestExplorecpu, &gtestExploremem), -1);
+	EXPECT_EQ(SolutionInputs(&gtestExplorer, NULL, 0), 0);
+	EXPECT_LT(gtestExplorer.NumNodes, 8);		// the search runs dry instead of filling MaxNodes
+	FreeExplorer(&gtestExplorer);
+}
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestFusioncpu;
+struct memory gtestFusionmem;
+struct CPU gtestFusionRefcpu;
+struct memory gtestFusionRefmem;
+struct fusion gtestFusion;
+
+
+// A DEX/BNE loop at 0x0200 made of every fusable sequence but INX/BNE and DEY/BNE,
+// followed by a jump-to-self
+static void LoadFusionProgram(struct CPU* cpu, struct memory* mem)
+{
+	const byte Program[] = {
+		LDX_IM, 0x20,
+		LDA_IM, 0x11, STA_ZP, 0x20,
+		LDA_IM, 0x22, STA_ABS, 0x00, 0x30,
+		LDA_ABSX, 0xF0, 0x40, STA_ABSY, 0x00, 0x50,
+		LDA_INDY, 0x40, STA_INDY, 0x42, INY_IM,
+		INY_IM, BNE, 0x00,
+		DEX_IM, BNE, 0xE6,
+		JMP_ABS, 0x1C, 0x02 };
+
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	cpu->y = 0xF0;
+	memcpy(&mem->Data[0x0200], Program, sizeof(Program));
+
+	mem->Data[0x0040] = 0x00;		// src pointer
+	mem->Data[0x0041] = 0x60;
+	mem->Data[0x0042] = 0x80;		// dst pointer
+	mem->Data[0x0043] = 0x70;
+	for (int i = 0; i < 0x200; i++)
+	{
+		mem->Data[0x40F0 + i] = (byte)(i * 3 + 1);
+		mem->Data[0x6000 + i] = (byte)(i * 5 + 2);
+	}
+}
+
+static void ExpectSameFusionState()
+{
+	EXPECT_EQ(gtestFusionmem.Clock, gtestFusionRefmem.Clock);
+	EXPECT_EQ(gtestFusionmem.Instructions, gtestFusionRefmem.Instructions);
+	EXPECT_EQ(gtestFusioncpu.pc, gtestFusionRefcpu.pc);
+	EXPECT_EQ(gtestFusioncpu.acc, gtestFusionRefcpu.acc);
+	EXPECT_EQ(gtestFusioncpu.x, gtestFusionRefcpu.x);
+	EXPECT_EQ(gtestFusioncpu.y, gtestFusionRefcpu.y);
+	EXPECT_EQ(memcmp(gtestFusioncpu.Flags, gtestFusionRefcpu.Flags, sizeof(gtestFusioncpu.Flags)), 0);
+	EXPECT_EQ(memcmp(gtestFusionmem.Data, gtestFusionRefmem.Data, sizeof(gtestFusionmem.Data)), 0);
+}
+
+
+TEST(testFusion, CHOOSE_FROM_PROFILE_TEST)
+{
+	LoadFusionProgram(&gtestFusioncpu, &gtestFusionmem);
+	AttachFusion(&gtestFusion, &gtestFusionmem);
+
+	Execute(&gtestFusioncpu, &gtestFusionmem, 500);
+	EXPECT_GT(gtestFusion.Pairs[DEX_IM][BNE], 0u);
+	EXPECT_EQ(gtestFusion.Runs, 0u);
+
+	EXPECT_EQ(ChooseFusions(&gtestFusionmem, FUSE_COUNT, 1), 6);
+	EXPECT_TRUE(gtestFusion.Enabled & (1u << FUSE_DEX_BNE));
+	EXPECT_TRUE(gtestFusion.Enabled & (1u << FUSE_LDA_INDY_STA_INDY_INY));
+	EXPECT_FALSE(gtestFusion.Enabled & (1u << FUSE_INX_BNE));
+	EXPECT_FALSE(gtestFusion.Enabled & (1u << FUSE_DEY_BNE));
+	EXPECT_FALSE(gtestFusion.Profiling);
+	EXPECT_TRUE(gtestFusion.Starts[LDA_IM]);
+	EXPECT_FALSE(gtestFusion.Starts[INX_IM]);
+
+	EXPECT_EQ(ChooseFusions(&gtestFusionmem, 2, 1), 2);
+}
+
+TEST(testFusion, SAME_STATE_TEST)
+{
+	LoadFusionProgram(&gtestFusioncpu, &gtestFusionmem);
+	LoadFusionProgram(&gtestFusionRefcpu, &gtestFusionRefmem);
+	AttachFusion(&gtestFusion, &gtestFusionmem);
+	EnableFusions(&gtestFusionmem, (1u << FUSE_COUNT) - 1);
+
+	for (int i = 0; i < 60; i++)
+	{
+		Execute(&gtestFusioncpu, &gtestFusionmem, 37);		// ends slices in the middle of sequences
+		Execute(&gtestFusionRefcpu, &gtestFusionRefmem, 37);
+		ExpectSameFusionState();
+	}
+	EXPECT_GT(gtestFusion.Runs, 0u);
+	EXPECT_EQ(gtestFusioncpu.pc, 0x021C);
+}
+
+TEST(testFusion, BREAKPOINT_TEST)
+{
+	LoadFusionProgram(&gtestFusioncpu, &gtestFusionmem);
+	LoadFusionProgram(&gtestFusionRefcpu, &gtestFusionRefmem);
+	AttachFusion(&gtestFusion, &gtestFusionmem);
+	EnableFusions(&gtestFusionmem, (1u << FUSE_COUNT) - 1);
+	SetBreakpoint(&gtestFusionmem, 0x0204, BREAK_EXEC);	// the STA of the first pair
+	SetBreakpoint(&gtestFusionRefmem, 0x0204, BREAK_EXEC);
+
+	Execute(&gtestFusioncpu, &gtestFusionmem, 1000);
+	Execute(&gtestFusionRefcpu, &gtestFusionRefmem, 1000);
+
+	EXPECT_EQ(gtestFusionmem.StopReason, STOP_BREAKPOINT);
+	EXPECT_EQ(gtestFusioncpu.pc, 0x0204);
+	ExpectSameFusionState();
+}
@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestHashcpu;
+struct memory gtestHashmem;
+struct CPU gtestHash2cpu;
+struct memory gtestHash2mem;
+byte gtestHashState[SAVESTATE_MAX_SIZE];
+
+
+static uint64_t FullHash(const struct memory* mem)
+{
+	uint64_t Hash = 0;
+	for (int Address = 0; Address < MAX_MEM; Address++)
+	{
+		Hash ^= HashByte(Address, mem->Data[Address]);
+	}
+	return Hash;
+}
+
+// Stores, a push, a call and a (src),Y copy loop the bulk path takes over
+static void LoadHashProgram(struct CPU* cpu, struct memory* mem)
+{
+	const byte Program[] = {
+		LDA_IM, 0x77, STA_ZP, 0x20, STA_ABS, 0x00, 0x50, PHA,
+		JSR, 0x00, 0x03,
+		LDY_IM, 0x00,
+		LDA_INDY, 0x40, STA_INDY, 0x42, INY_IM, BNE, 0xF9,
+		JMP_ABS, 0x14, 0x02 };
+
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	memcpy(&mem->Data[0x0200], Program, sizeof(Program));
+	mem->Data[0x0300] = RTS;
+	mem->Data[0x0040] = 0x00;
+	mem->Data[0x0041] = 0x60;
+	mem->Data[0x0042] = 0x00;
+	mem->Data[0x0043] = 0x70;
+	for (int i = 0; i < 0x100; i++)
+	{
+		mem->Data[0x6000 + i] = (byte)(i * 13 + 5);
+		mem->Data[0x7000 + i] = (byte)i;
+	}
+}
+
+
+TEST(testHash, INCREMENTAL_TEST)
+{
+	LoadHashProgram(&gtestHashcpu, &gtestHashmem);
+	EnableMemoryHash(&gtestHashmem);
+	EXPECT_EQ(gtestHashmem.DataHash, FullHash(&gtestHashmem));
+
+	for (int i = 0; i < 100; i++)
+	{
+		Execute(&gtestHashcpu, &gtestHashmem, 50);
+		EXPECT_EQ(gtestHashmem.DataHash, FullHash(&gtestHashmem));
+	}
+	EXPECT_EQ(gtestHashcpu.pc, 0x0214);
+	EXPECT_EQ(gtestHashmem.Data[0x7080], gtestHashmem.Data[0x6080]);
+
+	StoreByte(&gtestHashmem, 0x1234, 0x56);
+	EXPECT_EQ(gtestHashmem.DataHash, FullHash(&gtestHashmem));
+}
+
+TEST(testHash, STATES_EQUAL_TEST)
+{
+	LoadHashProgram(&gtestHashcpu, &gtestHashmem);
+	LoadHashProgram(&gtestHash2cpu, &gtestHash2mem);
+	EnableMemoryHash(&gtestHashmem);
+	EnableMemoryHash(&gtestHash2mem);
+
+	Execute(&gtestHashcpu, &gtestHashmem, 2000);
+	for (int i = 0; i < 40; i++)
+	{
+		Execute(&gtestHash2cpu, &gtestHash2mem, 50);
+	}
+	EXPECT_EQ(StateHash(&gtestHashcpu, &gtestHashmem), StateHash(&gtestHash2cpu, &gtestHash2mem));
+	EXPECT_TRUE(StatesEqual(&gtestHashcpu, &gtestHashmem, &gtestHash2cpu, &gtestHash2mem));
+
+	const byte Old = gtestHash2mem.Data[0x9000];
+	StoreByte(&gtestHash2mem, 0x9000, Old + 1);
+	EXPECT_NE(gtestHashmem.DataHash, gtestHash2mem.DataHash);
+	EXPECT_FALSE(StatesEqual(&gtestHashcpu, &gtestHashmem, &gtestHash2cpu, &gtestHash2mem));
+	StoreByte(&gtestHash2mem, 0x9000, Old);
+	EXPECT_TRUE(StatesEqual(&gtestHashcpu, &gtestHashmem, &gtestHash2cpu, &gtestHash2mem));
+
+	gtestHash2cpu.x++;
+	EXPECT_NE(StateHash(&gtestHashcpu, &gtestHashmem), StateHash(&gtestHash2cpu, &gtestHash2mem));
+}
+
+TEST(testHash, LOAD_STATE_TEST)
+{
+	LoadHashProgram(&gtestHashcpu, &gtestHashmem);
+	Execute(&gtestHashcpu, &gtestHashmem, 2000);
+	const size_t Size = SaveState(&gtestHashcpu, &gtestHashmem, gtestHashState, sizeof(gtestHashState), true);
+
+	ResetCpu(&gtestHash2cpu, &gtestHash2mem);
+	EnableMemoryHash(&gtestHash2mem);
+	ASSERT_TRUE(LoadState(&gtestHash2cpu, &gtestHash2mem, gtestHashState, Size));
+	EXPECT_EQ(gtestHash2mem.DataHash, FullHash(&gtestHashmem));
+}
@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestIdleLoopcpu;
+struct memory gtestIdleLoopmem;
+
+static int IdleDeviceReads;
+
+
+static void IdleFlagHandler(struct memory* mem, uint64_t Now, void* Context)
+{
+	mem->Data[0x0010] = 1;
+}
+
+static byte IdleDeviceRead(struct memory* mem, const word Address, const uint64_t Now, void* Context)
+{
+	IdleDeviceReads++;
+	return 0;
+}
+
+
+TEST(testIdleLoop, JMP_SELF_TEST)
+{
+	ResetCpu(&gtestIdleLoopcpu, &gtestIdleLoopmem);
+	gtestIdleLoopcpu.pc = 0x0200;
+
+	gtestIdleLoopmem.Data[0x0200] = JMP_ABS;
+	gtestIdleLoopmem.Data[0x0201] = 0x00;
+	gtestIdleLoopmem.Data[0x0202] = 0x02;
+
+	Execute(&gtestIdleLoopcpu, &gtestIdleLoopmem, 1000000000);
+
+	EXPECT_EQ(gtestIdleLoopmem.Clock, 1000000002u);
+	EXPECT_EQ(gtestIdleLoopmem.Instructions, 333333334u);
+	EXPECT_EQ(gtestIdleLoopcpu.pc, 0x0200);
+}
+
+TEST(testIdleLoop, POLL_UNTIL_EVENT_TEST)
+{
+	ResetCpu(&gtestIdleLoopcpu, &gtestIdleLoopmem);
+	gtestIdleLoopcpu.pc = 0x0200;
+
+	gtestIdleLoopmem.Data[0x0200] = LDA_ZP;		// 3 cycles
+	gtestIdleLoopmem.Data[0x0201] = 0x10;
+	gtestIdleLoopmem.Data[0x0202] = BEQ;		// 3 cycles taken, 2 not taken
+	gtestIdleLoopmem.Data[0x0203] = 0xFC;
+	gtestIdleLoopmem.Data[0x0204] = INX_IM;
+	gtestIdleLoopmem.Data[0x0205] = JMP_ABS;
+	gtestIdleLoopmem.Data[0x0206] = 0x05;
+	gtestIdleLoopmem.Data[0x0207] = 0x02;
+
+	ScheduleEvent(&gtestIdleLoopmem, 1000, IdleFlagHandler, NULL);
+	Execute(&gtestIdleLoopcpu, &gtestIdleLoopmem, 1010);
+
+	// iterations start every 6 cycles, the one running at cycle 1000 ends at 1002 and the
+	// event fires there, the next LDA sees the flag
+	EXPECT_EQ(gtestIdleLoopcpu.acc, 1);
+	EXPECT_EQ(gtestIdleLoopcpu.x, 1);
+	EXPECT_EQ(gtestIdleLoopmem.Clock, 1012u);
+	EXPECT_EQ(gtestIdleLoopcpu.pc, 0x0205);
+	EXPECT_EQ(gtestIdleLoopmem.Instructions, 167u * 2 + 4);
+}
+
+TEST(testIdleLoop, DEVICE_POLL_NOT_SKIPPED_TEST)
+{
+	ResetCpu(&gtestIdleLoopcpu, &gtestIdleLoopmem);
+	gtestIdleLoopcpu.pc = 0x0200;
+	IdleDeviceReads = 0;
+
+	AttachDevice(&gtestIdleLoopmem, 0x9000, PAGE_SIZE, IdleDeviceRead, NULL, NULL);
+	gtestIdleLoopmem.Data[0x0200] = LDA_ABS;	// 4 cycles
+	gtestIdleLoopmem.Data[0x0201] = 0x00;
+	gtestIdleLoopmem.Data[0x0202] = 0x90;
+	gtestIdleLoopmem.Data[0x0203] = BEQ;		// 3 cycles
+	gtestIdleLoopmem.Data[0x0204] = 0xFB;
+
+	Execute(&gtestIdleLoopcpu, &gtestIdleLoopmem, 700);
+
+	EXPECT_EQ(IdleDeviceReads, 100);
+	EXPECT_EQ(gtestIdleLoopmem.Clock, 700u);
+}
+
+TEST(testIdleLoop, SEPARATE_CALLS_TEST)
+{
+	static struct memory Stepped;
+	struct CPU SteppedCpu;
+
+	ResetCpu(&gtestIdleLoopcpu, &gtestIdleLoopmem);
+	gtestIdleLoopcpu.pc = 0x0200;
+
+	// the DEX loop takes its back edge with X = 1 in both calls
+	const byte Program[] = { LDX_IM, 0x02, JSR, 0x00, 0x80, LDY_IM, 0x00, LDX_IM, 0x02, JSR, 0x00, 0x80, JMP_ABS, 0x0C, 0x02 };
+	memcpy(&gtestIdleLoopmem.Data[0x0200], Program, sizeof(Program));
+	gtestIdleLoopmem.Data[0x8000] = DEX_IM;
+	gtestIdleLoopmem.Data[0x8001] = BNE;
+	gtestIdleLoopmem.Data[0x8002] = 0xFD;
+	gtestIdleLoopmem.Data[0x8003] = RTS;
+
+	SteppedCpu = gtestIdleLoopcpu;
+	Stepped = gtestIdleLoopmem;
+
+	Execute(&gtestIdleLoopcpu, &gtestIdleLoopmem, 200);
+	while (Stepped.Clock < 200)
+	{
+		Execute(&SteppedCpu, &Stepped, 1);		// one instruction per slice, nothing is skipped
+	}
+
+	EXPECT_EQ(gtestIdleLoopmem.Clock, Stepped.Clock);
+	EXPECT_EQ(gtestIdleLoopmem.Instructions, Stepped.Instructions);
+	EXPECT_EQ(gtestIdleLoopcpu.pc, SteppedCpu.pc);
+	EXPECT_EQ(gtestIdleLoopcpu.x, SteppedCpu.x);
+}
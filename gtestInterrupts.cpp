@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestInterruptcpu;
+struct memory gtestInterruptmem;
+
+
+static void AssertIrqHandler(struct memory* mem, uint64_t Now, void* Context)
+{
+	AssertIrq(mem, 1);
+}
+
+
+TEST(testInterrupts, BRK_RTI_TEST)
+{
+	ResetCpu(&gtestInterruptcpu, &gtestInterruptmem);
+	gtestInterruptcpu.pc = 0xFF00;
+
+	gtestInterruptmem.Data[0xFF00] = BRK;
+	gtestInterruptmem.Data[IRQ_VECTOR] = 0x00;
+	gtestInterruptmem.Data[IRQ_VECTOR + 1] = 0x80;
+	gtestInterruptmem.Data[0x8000] = RTI;
+
+	uint32_t numCycles = Execute(&gtestInterruptcpu, &gtestInterruptmem, 7);
+
+	EXPECT_EQ(numCycles, 7);
+	EXPECT_EQ(gtestInterruptcpu.pc, 0x8000);
+	EXPECT_EQ(gtestInterruptcpu.sp, 0xFC);
+	EXPECT_TRUE(gtestInterruptcpu.Flags[interruptDisable]);
+	EXPECT_EQ(gtestInterruptmem.Data[0x01FF], 0xFF);
+	EXPECT_EQ(gtestInterruptmem.Data[0x01FE], 0x02);
+	EXPECT_EQ(gtestInterruptmem.Data[0x01FD] & 0x30, 0x30);
+
+	numCycles = Execute(&gtestInterruptcpu, &gtestInterruptmem, 6);
+
+	EXPECT_EQ(numCycles, 6);
+	EXPECT_EQ(gtestInterruptcpu.pc, 0xFF02);
+	EXPECT_EQ(gtestInterruptcpu.sp, 0xFF);
+	EXPECT_FALSE(gtestInterruptcpu.Flags[interruptDisable]);
+}
+
+TEST(testInterrupts, IRQ_TEST)
+{
+	ResetCpu(&gtestInterruptcpu, &gtestInterruptmem);
+	gtestInterruptcpu.pc = 0xFF00;
+
+	gtestInterruptmem.Data[0xFF00] = INX_IM;
+	gtestInterruptmem.Data[0xFF01] = INX_IM;
+	gtestInterruptmem.Data[IRQ_VECTOR] = 0x00;
+	gtestInterruptmem.Data[IRQ_VECTOR + 1] = 0x80;
+
+	AssertIrq(&gtestInterruptmem, 1);
+
+	uint32_t numCycles = Execute(&gtestInterruptcpu, &gtestInterruptmem, 7);
+
+	EXPECT_EQ(numCycles, 7);
+	EXPECT_EQ(gtestInterruptcpu.pc, 0x8000);
+	EXPECT_EQ(gtestInterruptcpu.x, 0x00);
+	EXPECT_EQ(gtestInterruptmem.Data[0x01FD] & 0x10, 0x00);
+}
+
+TEST(testInterrupts, IRQ_MASKED_TEST)
+{
+	ResetCpu(&gtestInterruptcpu, &gtestInterruptmem);
+	gtestInterruptcpu.pc = 0xFF00;
+	gtestInterruptcpu.Flags[interruptDisable] = 1;
+
+	gtestInterruptmem.Data[0xFF00] = INX_IM;
+	gtestInterruptmem.Data[0xFF01] = CLI;
+	gtestInterruptmem.Data[IRQ_VECTOR] = 0x00;
+	gtestInterruptmem.Data[IRQ_VECTOR + 1] = 0x80;
+
+	AssertIrq(&gtestInterruptmem, 1);
+
+	uint32_t numCycles = Execute(&gtestInterruptcpu, &gtestInterruptmem, 2 + 2 + 7);
+
+	EXPECT_EQ(numCycles, 11);
+	EXPECT_EQ(gtestInterruptcpu.x, 0x01);
+	EXPECT_EQ(gtestInterruptcpu.pc, 0x8000);
+}
+
+TEST(testInterrupts, NMI_TEST)
+{
+	ResetCpu(&gtestInterruptcpu, &gtestInterruptmem);
+	gtestInterruptcpu.pc = 0xFF00;
+	gtestInterruptcpu.Flags[interruptDisable] = 1;
+
+	gtestInterruptmem.Data[NMI_VECTOR] = 0x00;
+	gtestInterruptmem.Data[NMI_VECTOR + 1] = 0x90;
+
+	TriggerNmi(&gtestInterruptmem);
+
+	uint32_t numCycles = Execute(&gtestInterruptcpu, &gtestInterruptmem, 7);
+
+	EXPECT_EQ(numCycles, 7);
+	EXPECT_EQ(gtestInterruptcpu.pc, 0x9000);
+	EXPECT_FALSE(gtestInterruptmem.NmiPending);
+}
+
+TEST(testInterrupts, SCHEDULED_IRQ_TEST)
+{
+	ResetCpu(&gtestInterruptcpu, &gtestInterruptmem);
+	gtestInterruptcpu.pc = 0xFF00;
+
+	gtestInterruptmem.Data[0xFF00] = INX_IM;
+	gtestInterruptmem.Data[0xFF01] = INX_IM;
+	gtestInterruptmem.Data[0xFF02] = INX_IM;
+	gtestInterruptmem.Data[IRQ_VECTOR] = 0x00;
+	gtestInterruptmem.Data[IRQ_VECTOR + 1] = 0x80;
+
+	ScheduleEvent(&gtestInterruptmem, 4, AssertIrqHandler, NULL);
+
+	uint32_t numCycles = Execute(&gtestInterruptcpu, &gtestInterruptmem, 4 + 7);
+
+	EXPECT_EQ(numCycles, 11);
+	EXPECT_EQ(gtestInterruptcpu.x, 0x02);
+	EXPECT_EQ(gtestInterruptcpu.pc, 0x8000);
+	EXPECT_EQ(gtestInterruptmem.Clock, 11);
+}
+
+TEST(testInterrupts, PHP_MATCHES_BRK_TEST)
+{
+	ResetCpu(&gtestInterruptcpu, &gtestInterruptmem);
+	gtestInterruptcpu.pc = 0xFF00;
+	gtestInterruptcpu.Flags[carryFlag] = 1;
+
+	gtestInterruptmem.Data[0xFF00] = PHP;
+	gtestInterruptmem.Data[0xFF01] = BRK;
+	gtestInterruptmem.Data[IRQ_VECTOR] = 0x00;
+	gtestInterruptmem.Data[IRQ_VECTOR + 1] = 0x80;
+
+	uint32_t numCycles = Execute(&gtestInterruptcpu, &gtestInterruptmem, 3 + 7);
+
+	EXPECT_EQ(numCycles, 10);
+	EXPECT_EQ(gtestInterruptmem.Data[0x01FF], gtestInterruptmem.Data[0x01FC]);		// PHP and BRK push the same status byte
+}
+
+TEST(testInterrupts, PLP_UNMASK_TEST)
+{
+	ResetCpu(&gtestInterruptcpu, &gtestInterruptmem);
+	gtestInterruptcpu.pc = 0xFF00;
+	gtestInterruptcpu.Flags[interruptDisable] = 1;
+	gtestInterruptcpu.sp = 0xFE;
+
+	gtestInterruptmem.Data[0xFF00] = PLP;
+	gtestInterruptmem.Data[0xFF01] = INX_IM;
+	gtestInterruptmem.Data[0x01FF] = 0x00;
+	gtestInterruptmem.Data[IRQ_VECTOR] = 0x00;
+	gtestInterruptmem.Data[IRQ_VECTOR + 1] = 0x80;
+
+	AssertIrq(&gtestInterruptmem, 1);
+
+	uint32_t numCycles = Execute(&gtestInterruptcpu, &gtestInterruptmem, 4 + 7);
+
+	EXPECT_EQ(numCycles, 11);
+	EXPECT_EQ(gtestInterruptcpu.x, 0x00);
+	EXPECT_EQ(gtestInterruptcpu.pc, 0x8000);
+	EXPECT_EQ(gtestInterruptmem.Data[0x01FF], 0xFF);		// the IRQ pushed the address of the INX
+	EXPECT_EQ(gtestInterruptmem.Data[0x01FE], 0x01);
+}
@@ -132,13 +132,13 @@ static void gtestLogicalRegisterZPX(struct CPU* cpu, struct memory* mem, ELogica
 	mem->Data[0xFFFD] = 0x80;
 	mem->Data[0x0080 + cpu->x] = 0x60;
 
-	uint32_t numCycles = Execute(cpu, mem, 3);
+	uint32_t numCycles = Execute(cpu, mem, 4);
 	const struct CPU cpuCopy = *cpu;
 
 	const byte ExpectedResult = LogicalOP(0xCC, 0x60, opcode, mem);
 
 	EXPECT_EQ(cpu->acc, ExpectedResult);
-	EXPECT_EQ(numCycles, 3);
+	EXPECT_EQ(numCycles, 4);
 
 	EXPECT_FALSE(cpu->Flags[zeroFlag]);
 
@@ -266,11 +266,11 @@ static void gtestLogicalRegisterINDX(struct CPU* cpu, struct memory* mem, ELogic
 	mem->Data[0x33 + cpu->x] = 0x00;
 	mem->Data[0x0080] = 0x60;
 
-	uint32_t numCycles = Execute(cpu, mem, 7);
+	uint32_t numCycles = Execute(cpu, mem, 6);
 	const struct CPU cpuCopy = *cpu;
 
 	EXPECT_EQ(cpu->acc, LogicalOP(0xCC, 0x60, opcode, mem));
-	EXPECT_EQ(numCycles, 7);
+	EXPECT_EQ(numCycles, 6);
 	EXPECT_FALSE(cpu->Flags[zeroFlag]);
 }
 
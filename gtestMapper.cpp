@@ -0,0 +1,286 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestMappercpu;
+struct memory gtestMappermem;
+struct mapper gtestMapper;
+byte gtestMapperBanks[0x10000];
+
+
+static void LoadMapperProgram(const byte* Program, const size_t Size)
+{
+	ResetCpu(&gtestMappercpu, &gtestMappermem);
+	gtestMappercpu.pc = 0x0200;
+	memcpy(&gtestMappermem.Data[0x0200], Program, Size);
+}
+
+
+TEST(testMapper, UXROM_TEST)
+{
+	// four 16 KiB banks, each starting with its number and holding a routine at 0x100 that
+	// stores it to 0x10 + bank
+	memset(gtestMapperBanks, 0, sizeof(gtestMapperBanks));
+	for (int Bank = 0; Bank < 4; Bank++)
+	{
+		const byte Routine[] = { LDA_IM, (byte)(0x40 + Bank), STA_ZP, (byte)(0x10 + Bank), RTS };
+		gtestMapperBanks[Bank * 0x4000] = 0x20 + Bank;
+		memcpy(&gtestMapperBanks[Bank * 0x4000 + 0x100], Routine, sizeof(Routine));
+	}
+	const byte Program[] = {
+		LDA_IM, 0x02,
+		STA_ABS, 0x00, 0x80,
+		LDA_ABS, 0x00, 0x80,
+		STA_ZP, 0x20,
+		JSR, 0x00, 0x81,
+		LDA_IM, 0x01,
+		STA_ABS, 0xFF, 0xBF,
+		JSR, 0x00, 0x81,
+		JSR, 0x00, 0xC1,		// the last bank stays at 0xC000
+		LDA_ABS, 0x00, 0xC0,
+		STA_ZP, 0x21,
+		JMP_ABS, 0x1D, 0x02 };
+
+	LoadMapperProgram(Program, sizeof(Program));
+	ASSERT_FALSE(InitMapper(&gtestMapper, MAPPER_UXROM, gtestMapperBanks, 0x3FFF));
+	ASSERT_TRUE(InitMapper(&gtestMapper, MAPPER_UXROM, gtestMapperBanks, sizeof(gtestMapperBanks)));
+	EXPECT_EQ(gtestMapper.NumBanks, 4);
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	Execute(&gtestMappercpu, &gtestMappermem, 200);
+
+	EXPECT_EQ(gtestMappermem.Data[0x20], 0x22);
+	EXPECT_EQ(gtestMappermem.Data[0x12], 0x42);
+	EXPECT_EQ(gtestMappermem.Data[0x11], 0x41);
+	EXPECT_EQ(gtestMappermem.Data[0x13], 0x43);
+	EXPECT_EQ(gtestMappermem.Data[0x21], 0x23);
+	EXPECT_EQ(gtestMappermem.Data[0x10], 0x00);
+	EXPECT_EQ(gtestMapper.Slots[0].Bank, 1);
+	EXPECT_EQ(gtestMapper.Switches, 2u);
+	EXPECT_EQ(gtestMappermem.Data[0x8000], 0x00);		// ROM writes only select banks
+	EXPECT_EQ(gtestMapperBanks[0x4000], 0x21);
+}
+
+TEST(testMapper, LATCH_RAM_TEST)
+{
+	memset(gtestMapperBanks, 0, sizeof(gtestMapperBanks));
+	const byte Program[] = {
+		LDA_IM, 0x01,
+		STA_ABS, 0x00, 0x50,
+		LDA_IM, 0xAA,
+		STA_ABS, 0x34, 0x62,
+		LDA_IM, 0x02,
+		STA_ABS, 0x00, 0x50,
+		LDA_IM, 0xBB,
+		STA_ABS, 0x34, 0x62,
+		STA_ABS, 0x01, 0x50,		// the rest of the register's page is plain RAM
+		LDA_IM, 0x05,			// wraps around to bank 1
+		STA_ABS, 0x00, 0x50,
+		LDA_ABS, 0x34, 0x62,
+		STA_ZP, 0x10,
+		JMP_ABS, 0x21, 0x02 };
+
+	LoadMapperProgram(Program, sizeof(Program));
+	ASSERT_FALSE(InitLatchMapper(&gtestMapper, gtestMapperBanks, 0x4000, 0x6080, 0x1000, 0x5000, true));
+	ASSERT_TRUE(InitLatchMapper(&gtestMapper, gtestMapperBanks, 0x4000, 0x6000, 0x1000, 0x5000, true));
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	Execute(&gtestMappercpu, &gtestMappermem, 100);
+
+	EXPECT_EQ(gtestMappermem.Data[0x10], 0xAA);
+	EXPECT_EQ(gtestMapperBanks[0x1234], 0xAA);
+	EXPECT_EQ(gtestMapperBanks[0x2234], 0xBB);
+	EXPECT_EQ(gtestMappermem.Data[0x6234], 0x00);
+	EXPECT_EQ(gtestMappermem.Data[0x5000], 0x00);
+	EXPECT_EQ(gtestMappermem.Data[0x5001], 0xBB);
+	EXPECT_EQ(gtestMapper.Slots[0].Bank, 1);
+
+	// read only banks ignore stores
+	LoadMapperProgram(Program, sizeof(Program));
+	InitLatchMapper(&gtestMapper, gtestMapperBanks, 0x4000, 0x6000, 0x1000, 0x5000, false);
+	AttachMapper(&gtestMapper, &gtestMappermem);
+	Execute(&gtestMappercpu, &gtestMappermem, 100);
+	EXPECT_EQ(gtestMappermem.Data[0x10], 0xAA);
+	EXPECT_EQ(gtestMapperBanks[0x2234], 0xBB);
+	EXPECT_EQ(gtestMappermem.Data[0x6234], 0x00);
+}
+
+TEST(testMapper, HOST_SWITCH_TEST)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		gtestMapperBanks[i * 0x2000] = i;
+	}
+	ResetCpu(&gtestMappercpu, &gtestMappermem);
+	gtestMappermem.Data[0x6000] = 0x77;
+	AttachDevice(&gtestMappermem, 0x7F00, PAGE_SIZE, NULL, NULL, NULL);
+	InitLatchMapper(&gtestMapper, gtestMapperBanks, sizeof(gtestMapperBanks), 0x6000, 0x2000, 0x5000, false);
+	EXPECT_FALSE(AttachMapper(&gtestMapper, &gtestMappermem));	// overlaps the device
+	EXPECT_EQ(gtestMappermem.Mapper, nullptr);
+
+	DetachDevice(&gtestMappermem, 0x7F00, PAGE_SIZE);
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	for (int Bank = 0; Bank < 8; Bank++)
+	{
+		SwitchBank(&gtestMapper, 0, Bank);
+		EXPECT_EQ(MapperRead(&gtestMappermem, 0x6000), Bank);
+	}
+	EXPECT_EQ(MapperRead(&gtestMappermem, 0x4000), 0x00);
+
+	struct explorer Explorer;
+	memset(&Explorer, 0, sizeof(Explorer));
+	EXPECT_EQ(Explore(&Explorer, &gtestMappercpu, &gtestMappermem), -1);
+
+	DetachMapper(&gtestMappermem);
+	EXPECT_EQ(gtestMappermem.PageFlags[0x60], 0);
+	EXPECT_EQ(gtestMappermem.PageFlags[0x50], 0);
+	EXPECT_EQ(gtestMappermem.Data[0x6000], 0x77);
+}
+
+// Stores the first byte of the bank mapped in at 0x0300 + X, then selects bank X + 1
+static void LoadBankCycleProgram()
+{
+	memset(gtestMapperBanks, 0, sizeof(gtestMapperBanks));
+	for (int Bank = 0; Bank < 4; Bank++)
+	{
+		gtestMapperBanks[Bank * 0x4000] = 0x20 + Bank;
+	}
+	const byte Program[] = {
+		LDX_IM, 0x00,
+		LDA_ABS, 0x00, 0x80,
+		STA_ABSX, 0x00, 0x03,
+		INX_IM,
+		STX_ABS, 0x00, 0x80,
+		JMP_ABS, 0x02, 0x02 };
+
+	LoadMapperProgram(Program, sizeof(Program));
+	InitMapper(&gtestMapper, MAPPER_UXROM, gtestMapperBanks, sizeof(gtestMapperBanks));
+}
+
+TEST(testMapper, BANK_STATE_TEST)
+{
+	static byte State[SAVESTATE_MAX_SIZE];
+	static struct memory_diff Diff;
+	static struct timeline Timeline;
+
+	LoadBankCycleProgram();
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	EnableMemoryHash(&gtestMappermem);
+
+	SwitchBank(&gtestMapper, 0, 2);
+	const uint64_t Hash = StateHash(&gtestMappercpu, &gtestMappermem);
+	const size_t Size = SaveState(&gtestMappercpu, &gtestMappermem, State, sizeof(State), true);
+	ASSERT_NE(Size, 0u);
+
+	SwitchBank(&gtestMapper, 0, 1);
+	EXPECT_NE(StateHash(&gtestMappercpu, &gtestMappermem), Hash);
+
+	ASSERT_TRUE(LoadState(&gtestMappercpu, &gtestMappermem, State, Size));
+	EXPECT_EQ(gtestMapper.Slots[0].Bank, 2);
+	EXPECT_EQ(StateHash(&gtestMappercpu, &gtestMappermem), Hash);
+
+	EXPECT_FALSE(DiffMemory(&gtestMappermem, &gtestMappermem, &Diff));
+	EXPECT_EQ(Diff.NumRanges, 0);
+
+	// the contents of RAM banks are hashed, but neither saved nor rewound
+	InitLatchMapper(&gtestMapper, gtestMapperBanks, 0x4000, 0x6000, 0x1000, 0x5000, true);
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	const uint64_t Before = StateHash(&gtestMappercpu, &gtestMappermem);
+	StoreByte(&gtestMappermem, 0x6010, 0x99);
+	EXPECT_NE(StateHash(&gtestMappercpu, &gtestMappermem), Before);
+	StoreByte(&gtestMappermem, 0x6010, 0x00);
+	EXPECT_EQ(StateHash(&gtestMappercpu, &gtestMappermem), Before);
+	EXPECT_EQ(SaveState(&gtestMappercpu, &gtestMappermem, State, sizeof(State), true), 0u);
+	EXPECT_FALSE(AttachTimeline(&Timeline, &gtestMappercpu, &gtestMappermem, 100));
+	DetachMapper(&gtestMappermem);
+	DisableMemoryHash(&gtestMappermem);
+}
+
+TEST(testMapper, TIMELINE_BANK_TEST)
+{
+	static struct timeline Timeline;
+	static struct memory Saved;
+
+	LoadBankCycleProgram();
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	ASSERT_TRUE(AttachTimeline(&Timeline, &gtestMappercpu, &gtestMappermem, 100));
+	EXPECT_FALSE(AttachMapper(&gtestMapper, &gtestMappermem));
+
+	Execute(&gtestMappercpu, &gtestMappermem, 1003);
+	const struct CPU SavedCpu = gtestMappercpu;
+	const int SavedBank = gtestMapper.Slots[0].Bank;
+	Saved = gtestMappermem;
+
+	Execute(&gtestMappercpu, &gtestMappermem, 1000);
+	ASSERT_TRUE(SeekToCycle(&gtestMappercpu, &gtestMappermem, Saved.Clock));
+
+	EXPECT_EQ(gtestMappermem.Clock, Saved.Clock);
+	EXPECT_EQ(gtestMappercpu.pc, SavedCpu.pc);
+	EXPECT_EQ(gtestMappercpu.x, SavedCpu.x);
+	EXPECT_EQ(gtestMappercpu.acc, SavedCpu.acc);
+	EXPECT_EQ(gtestMapper.Slots[0].Bank, SavedBank);
+	EXPECT_EQ(memcmp(gtestMappermem.Data, Saved.Data, sizeof(Saved.Data)), 0);
+
+	DetachTimeline(&gtestMappermem);
+	DetachMapper(&gtestMappermem);
+}
+
+TEST(testMapper, BANKED_STATS_AND_SCAN_TEST)
+{
+	static struct stats Stats;
+	static struct scan Scan;
+	word Address;
+
+	// the bank at 0x8000 reads 0x4567 and ends in a jump-to-self, Data underneath stays zero
+	memset(gtestMapperBanks, 0, sizeof(gtestMapperBanks));
+	const byte Routine[] = { LDA_ABS, 0x67, 0x45, JMP_ABS, 0x03, 0x80 };
+	memcpy(&gtestMapperBanks[0x4000], Routine, sizeof(Routine));
+	ResetCpu(&gtestMappercpu, &gtestMappermem);
+	gtestMappercpu.pc = 0x8000;
+	InitMapper(&gtestMapper, MAPPER_UXROM, gtestMapperBanks, sizeof(gtestMapperBanks));
+	SwitchBank(&gtestMapper, 0, 1);
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	AttachStats(&Stats, &gtestMappermem);
+
+	Execute(&gtestMappercpu, &gtestMappermem, 4);
+	EXPECT_EQ(Stats.Pages[STAT_ABSOLUTE][0x45], 1u);
+	EXPECT_EQ(Stats.Pages[STAT_ABSOLUTE][0x00], 0u);
+	DetachStats(&gtestMappermem);
+
+	StartScan(&Scan, &gtestMappermem);
+	EXPECT_EQ(FilterScan(&Scan, &gtestMappermem, SCAN_EQUAL, 0x67), 1u);
+	ASSERT_EQ(ScanResults(&Scan, &Address, 1), 1);
+	EXPECT_EQ(Address, 0x8001);
+	DetachMapper(&gtestMappermem);
+}
+
+TEST(testMapper, FUZZ_BANK_TEST)
+{
+	static struct fuzz_target Target;
+	memset(gtestMapperBanks, 0, sizeof(gtestMapperBanks));
+	for (int Bank = 0; Bank < 4; Bank++)
+	{
+		gtestMapperBanks[Bank * 0x4000] = 0x20 + Bank;
+	}
+	const byte Program[] = {
+		LDA_ABS, 0x00, 0x80,		// the bank the run starts with
+		STA_ZP, 0x10,
+		LDA_ABS, 0x00, 0x10,
+		STA_ABS, 0x00, 0x80,		// the input selects the next one
+		JMP_ABS, 0x0B, 0x02 };
+	const byte Second[] = { 0x02 };
+	const byte First[] = { 0x01 };
+
+	LoadMapperProgram(Program, sizeof(Program));
+	ASSERT_TRUE(InitMapper(&gtestMapper, MAPPER_UXROM, gtestMapperBanks, sizeof(gtestMapperBanks)));
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	ASSERT_TRUE(InitFuzzTarget(&Target, &gtestMappercpu, &gtestMappermem, NULL, 0x1000, 1, 0, 40));
+
+	FuzzOneInput(&Target, Second, sizeof(Second));
+	EXPECT_EQ(Target.mem.Data[0x10], 0x20);
+	EXPECT_EQ(gtestMapper.Slots[0].Bank, 2);
+	FuzzOneInput(&Target, First, sizeof(First));
+	EXPECT_EQ(Target.mem.Data[0x10], 0x20);			// not the bank the last run left
+	EXPECT_EQ(gtestMapper.Slots[0].Bank, 1);
+
+	ASSERT_TRUE(InitLatchMapper(&gtestMapper, gtestMapperBanks, sizeof(gtestMapperBanks), 0x6000, 0x1000, 0x5000, true));
+	ASSERT_TRUE(AttachMapper(&gtestMapper, &gtestMappermem));
+	EXPECT_FALSE(InitFuzzTarget(&Target, &gtestMappercpu, &gtestMappermem, NULL, 0x1000, 1, 0, 40));
+}
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestMemocpu;
+struct memory gtestMemomem;
+struct CPU gtestMemoRefcpu;
+struct memory gtestMemoRefmem;
+struct memo gtestMemo;
+
+
+// The routine at 0x8000 reads $10 and $9000,X, burns a DEX loop and stores to $20.
+// Main calls it twice, Between holds the code run between the two calls.
+static void LoadMemoProgram(struct CPU* cpu, struct memory* mem, const byte* Between, const int Length)
+{
+	const byte Routine[] = { LDA_ZP, 0x10, AND_ABSX, 0x00, 0x90, TAY_IM, LDX_IM, 0x04, DEX_IM, BNE, 0xFD, STA_ZP, 0x20, RTS };
+	const byte Call[] = { LDA_IM, 0x00, LDX_IM, 0x01, LDY_IM, 0x00, JSR, 0x00, 0x80 };
+
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	mem->Data[0x0010] = 0x0F;
+	mem->Data[0x9001] = 0x3C;
+	memcpy(&mem->Data[0x8000], Routine, sizeof(Routine));
+
+	word pc = 0x0200;
+	memcpy(&mem->Data[pc], Call, sizeof(Call));
+	pc += sizeof(Call);
+	mem->Data[pc++] = STA_ZP;
+	mem->Data[pc++] = 0x30;
+	if (Length)
+	{
+		memcpy(&mem->Data[pc], Between, Length);
+	}
+	pc += Length;
+	memcpy(&mem->Data[pc], Call, sizeof(Call));
+	pc += sizeof(Call);
+	mem->Data[pc++] = STA_ZP;
+	mem->Data[pc++] = 0x31;
+	mem->Data[pc] = JMP_ABS;
+	mem->Data[pc + 1] = pc & 0xFF;
+	mem->Data[pc + 2] = pc >> 8;
+}
+
+static void RunMemoProgram(const byte* Between, const int Length)
+{
+	LoadMemoProgram(&gtestMemocpu, &gtestMemomem, Between, Length);
+	LoadMemoProgram(&gtestMemoRefcpu, &gtestMemoRefmem, Between, Length);
+	AttachMemo(&gtestMemo, &gtestMemomem);
+	EXPECT_GE(MemoizeRoutine(&gtestMemomem, 0x8000), 0);
+
+	Execute(&gtestMemocpu, &gtestMemomem, 300);
+	Execute(&gtestMemoRefcpu, &gtestMemoRefmem, 300);
+
+	EXPECT_EQ(gtestMemomem.Clock, gtestMemoRefmem.Clock);
+	EXPECT_EQ(gtestMemomem.Instructions, gtestMemoRefmem.Instructions);
+	EXPECT_EQ(gtestMemocpu.pc, gtestMemoRefcpu.pc);
+	EXPECT_EQ(gtestMemocpu.sp, gtestMemoRefcpu.sp);
+	EXPECT_EQ(gtestMemocpu.acc, gtestMemoRefcpu.acc);
+	EXPECT_EQ(gtestMemocpu.x, gtestMemoRefcpu.x);
+	EXPECT_EQ(gtestMemocpu.y, gtestMemoRefcpu.y);
+	EXPECT_EQ(memcmp(gtestMemocpu.Flags, gtestMemoRefcpu.Flags, sizeof(gtestMemocpu.Flags)), 0);
+	EXPECT_EQ(memcmp(gtestMemomem.Data, gtestMemoRefmem.Data, sizeof(gtestMemomem.Data)), 0);
+	EXPECT_EQ(gtestMemomem.Data[0x0030], 0x0C);
+}
+
+
+TEST(testMemo, HIT_TEST)
+{
+	RunMemoProgram(NULL, 0);
+
+	EXPECT_EQ(gtestMemo.Misses, 1u);
+	EXPECT_EQ(gtestMemo.Hits, 1u);
+	EXPECT_EQ(gtestMemomem.Data[0x0031], 0x0C);
+}
+
+TEST(testMemo, INPUT_CHANGED_TEST)
+{
+	const byte Between[] = { LDA_IM, 0xF0, STA_ZP, 0x10 };
+	RunMemoProgram(Between, sizeof(Between));
+
+	EXPECT_EQ(gtestMemo.Misses, 2u);
+	EXPECT_EQ(gtestMemo.Hits, 0u);
+	EXPECT_EQ(gtestMemomem.Data[0x0031], 0x30);
+}
+
+TEST(testMemo, CODE_CHANGED_TEST)
+{
+	const byte Between[] = { LDA_IM, 0x02, STA_ABS, 0x07, 0x80 };	// LDX #4 becomes LDX #2
+	RunMemoProgram(Between, sizeof(Between));
+
+	EXPECT_EQ(gtestMemo.Misses, 2u);
+	EXPECT_EQ(gtestMemo.Hits, 0u);
+}
+
+TEST(testMemo, DEVICE_READ_TEST)
+{
+	const byte Between[] = { LDA_IM, 0x00 };
+	LoadMemoProgram(&gtestMemocpu, &gtestMemomem, Between, sizeof(Between));
+	AttachMemo(&gtestMemo, &gtestMemomem);
+	MemoizeRoutine(&gtestMemomem, 0x8000);
+	AttachDevice(&gtestMemomem, 0x9000, PAGE_SIZE, NULL, NULL, NULL);
+
+	Execute(&gtestMemocpu, &gtestMemomem, 300);
+
+	EXPECT_TRUE(gtestMemo.Routines[0].Disabled);
+	EXPECT_EQ(gtestMemo.Hits, 0u);
+	EXPECT_FALSE(gtestMemomem.PageFlags[0x00] & PAGE_LEARN);
+}
@@ -0,0 +1,130 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestMemoryDiffcpu;
+struct memory gtestMemoryDiffFrom;
+struct memory gtestMemoryDiffTo;
+struct memory_diff gtestMemoryDiff;
+byte gtestMemoryDiffPatch[MEMORY_PATCH_MAX_SIZE];
+
+
+static void LoadDiffImages()
+{
+	ResetCpu(&gtestMemoryDiffcpu, &gtestMemoryDiffFrom);
+	ResetCpu(&gtestMemoryDiffcpu, &gtestMemoryDiffTo);
+	for (int i = 0; i < MAX_MEM; i++)
+	{
+		gtestMemoryDiffFrom.Data[i] = gtestMemoryDiffTo.Data[i] = (byte)(i * 7 + (i >> 8));
+	}
+}
+
+
+TEST(testMemoryDiff, RANGES_TEST)
+{
+	LoadDiffImages();
+	gtestMemoryDiffTo.Data[0x0010] ^= 0x01;
+	gtestMemoryDiffTo.Data[0x0011] ^= 0x80;
+	gtestMemoryDiffTo.Data[0x00FF] ^= 0x10;
+	gtestMemoryDiffTo.Data[0x0100] ^= 0x10;		// next page, a range of its own
+	gtestMemoryDiffTo.Data[0x203F] ^= 0xFF;		// crosses a 64 byte block
+	gtestMemoryDiffTo.Data[0x2040] ^= 0xFF;
+	gtestMemoryDiffTo.Data[0xFFFF] ^= 0x42;
+
+	for (int Level = SIMD_SCALAR; Level <= SIMD_AVX2; Level++)
+	{
+		if (SetSimdLevel(Level) != Level)
+		{
+			continue;
+		}
+		DiffMemory(&gtestMemoryDiffFrom, &gtestMemoryDiffTo, &gtestMemoryDiff);
+		EXPECT_EQ(gtestMemoryDiff.Bytes, 7u);
+		ASSERT_EQ(gtestMemoryDiff.NumRanges, 5);
+		EXPECT_EQ(gtestMemoryDiff.Ranges[0].Address, 0x0010);
+		EXPECT_EQ(gtestMemoryDiff.Ranges[0].Length, 2);
+		EXPECT_EQ(gtestMemoryDiff.Ranges[1].Address, 0x00FF);
+		EXPECT_EQ(gtestMemoryDiff.Ranges[2].Address, 0x0100);
+		EXPECT_EQ(gtestMemoryDiff.Ranges[3].Address, 0x203F);
+		EXPECT_EQ(gtestMemoryDiff.Ranges[3].Length, 2);
+		EXPECT_EQ(gtestMemoryDiff.Ranges[4].Address, 0xFFFF);
+		EXPECT_EQ(gtestMemoryDiff.PageStart[0x00], 0);
+		EXPECT_EQ(gtestMemoryDiff.PageStart[0x01], 2);
+		EXPECT_EQ(gtestMemoryDiff.PageStart[0x20], 3);
+		EXPECT_EQ(gtestMemoryDiff.PageStart[0x21], 4);
+		EXPECT_EQ(gtestMemoryDiff.PageStart[0xFF], 4);
+		EXPECT_EQ(gtestMemoryDiff.PageStart[NUM_PAGES], 5);
+	}
+	SetSimdLevel(SIMD_AVX2);
+
+	DiffMemory(&gtestMemoryDiffFrom, &gtestMemoryDiffFrom, &gtestMemoryDiff);
+	EXPECT_EQ(gtestMemoryDiff.NumRanges, 0);
+	EXPECT_EQ(gtestMemoryDiff.Bytes, 0u);
+}
+
+TEST(testMemoryDiff, SIMD_MATCHES_SCALAR_TEST)
+{
+	static struct memory_diff Scalar;
+	LoadDiffImages();
+	uint32_t Seed = 12345;
+	for (int i = 0; i < 3000; i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		gtestMemoryDiffTo.Data[(Seed >> 8) & 0xFFFF] ^= 1 << (Seed & 7);
+	}
+
+	SetSimdLevel(SIMD_SCALAR);
+	DiffMemory(&gtestMemoryDiffFrom, &gtestMemoryDiffTo, &Scalar);
+	int Expected = 0;
+	for (int i = 0; i < MAX_MEM; i++)
+	{
+		Expected += gtestMemoryDiffFrom.Data[i] != gtestMemoryDiffTo.Data[i];
+	}
+	EXPECT_EQ(Scalar.Bytes, (uint32_t)Expected);
+
+	for (int Level = SIMD_SSE2; Level <= SIMD_AVX2; Level++)
+	{
+		if (SetSimdLevel(Level) == Level)
+		{
+			DiffMemory(&gtestMemoryDiffFrom, &gtestMemoryDiffTo, &gtestMemoryDiff);
+			EXPECT_EQ(gtestMemoryDiff.NumRanges, Scalar.NumRanges);
+			EXPECT_EQ(memcmp(gtestMemoryDiff.Ranges, Scalar.Ranges, Scalar.NumRanges * sizeof(Scalar.Ranges[0])), 0);
+			EXPECT_EQ(memcmp(gtestMemoryDiff.PageStart, Scalar.PageStart, sizeof(Scalar.PageStart)), 0);
+		}
+	}
+	SetSimdLevel(SIMD_AVX2);
+}
+
+TEST(testMemoryDiff, PATCH_TEST)
+{
+	struct CPU ToCpu;
+	LoadDiffImages();
+	EnableMemoryHash(&gtestMemoryDiffFrom);
+	gtestMemoryDiffTo.Data[0x3000] ^= 0x01;
+	gtestMemoryDiffTo.Data[0x3002] ^= 0x01;		// one record, the gap is cheaper than a header
+	gtestMemoryDiffTo.Data[0x3100] ^= 0x01;
+	gtestMemoryDiffTo.Clock = 123456;
+	gtestMemoryDiffTo.IrqLines = 0x02;
+	ToCpu = gtestMemoryDiffcpu;
+	ToCpu.pc = 0x1234;
+	ToCpu.acc = 0x56;
+	ToCpu.Flags[carryFlag] = 1;
+
+	DiffMemory(&gtestMemoryDiffFrom, &gtestMemoryDiffTo, &gtestMemoryDiff);
+	EXPECT_EQ(MakePatch(&gtestMemoryDiff, &ToCpu, &gtestMemoryDiffTo, gtestMemoryDiffPatch, 32), 0u);	// registers only
+	const size_t Size = MakePatch(&gtestMemoryDiff, &ToCpu, &gtestMemoryDiffTo, gtestMemoryDiffPatch, sizeof(gtestMemoryDiffPatch));
+	EXPECT_EQ(Size, 5 + 7 + sizeof(ToCpu.Flags) + 10 + (3 + 3) + (3 + 1));
+
+	EXPECT_FALSE(ApplyPatch(&gtestMemoryDiffcpu, &gtestMemoryDiffFrom, gtestMemoryDiffPatch, Size - 1));
+	EXPECT_NE(gtestMemoryDiffFrom.Data[0x3000], gtestMemoryDiffTo.Data[0x3000]);	// a truncated patch changes nothing
+
+	ASSERT_TRUE(ApplyPatch(&gtestMemoryDiffcpu, &gtestMemoryDiffFrom, gtestMemoryDiffPatch, Size));
+	EXPECT_EQ(memcmp(gtestMemoryDiffFrom.Data, gtestMemoryDiffTo.Data, MAX_MEM), 0);
+	EXPECT_EQ(gtestMemoryDiffcpu.pc, 0x1234);
+	EXPECT_EQ(gtestMemoryDiffcpu.acc, 0x56);
+	EXPECT_EQ(gtestMemoryDiffcpu.Flags[carryFlag], 1);
+	EXPECT_EQ(gtestMemoryDiffFrom.Clock, 123456u);
+	EXPECT_EQ(gtestMemoryDiffFrom.IrqLines, 0x02);
+
+	const uint64_t Incremental = gtestMemoryDiffFrom.DataHash;
+	RehashMemory(&gtestMemoryDiffFrom);
+	EXPECT_EQ(gtestMemoryDiffFrom.DataHash, Incremental);
+}
@@ -0,0 +1,69 @@
+#include <thread>			// before 6502.h, its byte macro breaks the standard headers
+#include "gtest/gtest.h"
+#include "6502.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+struct numa_topology gtestNumaTopology;
+
+
+TEST(testNuma, TOPOLOGY_TEST)
+{
+	ReadNumaTopology(&gtestNumaTopology);
+	ASSERT_GE(gtestNumaTopology.NumNodes, 1);
+	ASSERT_LE(gtestNumaTopology.NumNodes, NUMA_MAX_NODES);
+	for (int i = 0; i < gtestNumaTopology.NumNodes; i++)
+	{
+		EXPECT_GT(gtestNumaTopology.NumCpus[i], 0);
+		EXPECT_GE(gtestNumaTopology.NodeId[i], 0);
+		for (int j = 1; j < gtestNumaTopology.NumCpus[i]; j++)
+		{
+			EXPECT_GT(gtestNumaTopology.Cpus[i][j], gtestNumaTopology.Cpus[i][j - 1]);
+		}
+	}
+
+	// workers are dealt round robin
+	for (int Worker = 0; Worker < 16; Worker++)
+	{
+		EXPECT_EQ(WorkerNode(&gtestNumaTopology, Worker), Worker % gtestNumaTopology.NumNodes);
+	}
+}
+
+TEST(testNuma, PIN_WORKER_TEST)
+{
+	ReadNumaTopology(&gtestNumaTopology);
+	bool Pinned = false;
+	std::thread Worker([&Pinned]() { Pinned = PinWorker(&gtestNumaTopology, 1); });	// the test thread stays unpinned
+	Worker.join();
+	EXPECT_EQ(Pinned, gtestNumaTopology.NumNodes > 1);
+}
+
+TEST(testNuma, BIND_TO_NODE_TEST)
+{
+	ReadNumaTopology(&gtestNumaTopology);
+	EXPECT_FALSE(BindToNode(NULL, 0, -1));
+
+#ifdef __linux__
+	const size_t Size = POOL_HUGE_PAGE;
+	void* Mapping = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(Mapping, MAP_FAILED);
+	BindToNode(Mapping, Size, gtestNumaTopology.NodeId[0]);	// may be refused in a container, the pages work either way
+	memset(Mapping, 0x5A, Size);
+	EXPECT_EQ(((byte*)Mapping)[Size - 1], 0x5A);
+	munmap(Mapping, Size);
+#endif
+
+	// a pool bound to a node hands out the same usable slots and keeps the node when destroyed
+	struct instance_pool Pool;
+	InitInstancePool(&Pool, 1);
+	EXPECT_EQ(Pool.Node, -1);
+	Pool.Node = gtestNumaTopology.NodeId[0];
+	struct instance* Instance = AllocInstance(&Pool);
+	ASSERT_NE(Instance, (struct instance*)NULL);
+	ResetCpu(&Instance->cpu, &Instance->mem);
+	EXPECT_EQ(Instance->mem.Data[0x1234], 0);
+	DestroyInstancePool(&Pool);
+	EXPECT_EQ(Pool.Node, gtestNumaTopology.NodeId[0]);
+	EXPECT_EQ(Pool.NumArenas, 0);
+}
@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct instance_pool gtestPool;
+struct instance* gtestPoolInstances[100];
+
+
+TEST(testPool, ALLOC_FREE_TEST)
+{
+	InitInstancePool(&gtestPool, 1);		// rounds up to one huge page, 28 instances
+	EXPECT_EQ(gtestPool.ArenaSize, (size_t)POOL_HUGE_PAGE);
+	EXPECT_EQ(gtestPool.SlotSize % CACHE_LINE, 0u);
+	EXPECT_EQ(gtestPool.NumArenas, 0);
+
+	for (int i = 0; i < 100; i++)
+	{
+		gtestPoolInstances[i] = AllocInstance(&gtestPool);
+		ASSERT_NE(gtestPoolInstances[i], (struct instance*)NULL);
+		EXPECT_EQ((uintptr_t)&gtestPoolInstances[i]->cpu % CACHE_LINE, 0u);
+		EXPECT_EQ((uintptr_t)&gtestPoolInstances[i]->mem % CACHE_LINE, 0u);
+		EXPECT_EQ(gtestPoolInstances[i]->mem.Data[0x1234], 0);	// fresh slots are zero
+	}
+	EXPECT_EQ(gtestPool.Live, 100u);
+	EXPECT_EQ(gtestPool.NumArenas, (100 + 27) / 28);
+	EXPECT_EQ((uintptr_t)gtestPool.Arenas[0] % POOL_HUGE_PAGE, 0u);
+
+	struct instance* Used = gtestPoolInstances[42];
+	ResetCpu(&Used->cpu, &Used->mem);
+	Used->mem.Data[0x0200] = LDA_IM;
+	Used->mem.Data[0x0201] = 0x37;
+	Used->cpu.pc = 0x0200;
+	Execute(&Used->cpu, &Used->mem, 2);
+	EXPECT_EQ(Used->cpu.acc, 0x37);
+	EXPECT_EQ(gtestPoolInstances[43]->mem.Data[0x0200], 0);	// neighbours untouched
+
+	FreeInstance(&gtestPool, gtestPoolInstances[7]);
+	FreeInstance(&gtestPool, Used);
+	EXPECT_EQ(gtestPool.Live, 98u);
+	EXPECT_EQ(AllocInstance(&gtestPool), Used);			// most recently freed first
+	EXPECT_EQ(AllocInstance(&gtestPool), gtestPoolInstances[7]);
+	EXPECT_EQ(gtestPool.NumArenas, 4);
+
+	DestroyInstancePool(&gtestPool);
+	EXPECT_EQ(gtestPool.NumArenas, 0);
+	EXPECT_EQ(gtestPool.Live, 0u);
+}
+
+TEST(testPool, SHORT_LIVED_TEST)
+{
+	InitInstancePool(&gtestPool, 0);
+	for (int i = 0; i < 1000000; i++)
+	{
+		struct instance* a = AllocInstance(&gtestPool);
+		struct instance* b = AllocInstance(&gtestPool);
+		a->cpu.pc = (word)i;
+		FreeInstance(&gtestPool, b);
+		FreeInstance(&gtestPool, a);
+	}
+	EXPECT_EQ(gtestPool.NumArenas, 1);
+	EXPECT_EQ(gtestPool.Live, 0u);
+	DestroyInstancePool(&gtestPool);
+}
@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestRecordercpu;
+struct memory gtestRecordermem;
+struct recorder gtestRecorder;
+
+static byte RecorderDeviceCounter;
+
+
+static byte RecorderDeviceRead(struct memory* mem, const word Address, const uint64_t Now, void* Context)
+{
+	return RecorderDeviceCounter += 7;
+}
+
+static void RecorderIrqHandler(struct memory* mem, uint64_t Now, void* Context)
+{
+	AssertIrq(mem, 1);
+}
+
+static void LoadRecorderProgram(struct CPU* cpu, struct memory* mem)
+{
+	ResetCpu(cpu, mem);
+	cpu->pc = 0xFF00;
+
+	AttachDevice(mem, 0x9000, PAGE_SIZE, RecorderDeviceRead, NULL, NULL);
+
+	mem->Data[0xFF00] = INX_IM;
+	mem->Data[0xFF01] = LDA_ABS;
+	mem->Data[0xFF02] = 0x00;
+	mem->Data[0xFF03] = 0x90;
+	mem->Data[0xFF04] = STA_ABSX;
+	mem->Data[0xFF05] = 0x00;
+	mem->Data[0xFF06] = 0x03;
+	mem->Data[0xFF07] = JMP_ABS;
+	mem->Data[0xFF08] = 0x00;
+	mem->Data[0xFF09] = 0xFF;
+
+	mem->Data[IRQ_VECTOR] = 0x00;
+	mem->Data[IRQ_VECTOR + 1] = 0x80;
+	mem->Data[0x8000] = INY_IM;
+	mem->Data[0x8001] = LDA_ABS;
+	mem->Data[0x8002] = 0x42;
+	mem->Data[0x8003] = 0x00;
+	mem->Data[0x8004] = JMP_ABS;
+	mem->Data[0x8005] = 0x00;
+	mem->Data[0x8006] = 0x80;
+}
+
+
+TEST(testRecorder, RECORD_REPLAY_TEST)
+{
+	static struct memory Recorded;
+	FILE* Stream = tmpfile();
+	ASSERT_TRUE(Stream != NULL);
+
+	LoadRecorderProgram(&gtestRecordercpu, &gtestRecordermem);
+	RecorderDeviceCounter = 0;
+	ScheduleEvent(&gtestRecordermem, 400, RecorderIrqHandler, NULL);
+
+	EXPECT_TRUE(StartRecording(&gtestRecorder, &gtestRecordermem, Stream));
+	Execute(&gtestRecordercpu, &gtestRecordermem, 250);
+	InjectWrite(&gtestRecordermem, 0x0042, 0x99);
+	Execute(&gtestRecordercpu, &gtestRecordermem, 250);
+	StopRecorder(&gtestRecordermem);
+
+	const struct CPU RecordedCpu = gtestRecordercpu;
+	Recorded = gtestRecordermem;
+	EXPECT_EQ(RecordedCpu.pc & 0xFF00, 0x8000);
+	EXPECT_EQ(RecordedCpu.acc, 0x99);
+
+	rewind(Stream);
+	LoadRecorderProgram(&gtestRecordercpu, &gtestRecordermem);
+	RecorderDeviceCounter = 100;
+
+	EXPECT_TRUE(StartReplay(&gtestRecorder, &gtestRecordermem, Stream));
+	Execute(&gtestRecordercpu, &gtestRecordermem, Recorded.Clock - gtestRecordermem.Clock);
+	StopRecorder(&gtestRecordermem);
+
+	EXPECT_EQ(gtestRecordermem.Clock, Recorded.Clock);
+	EXPECT_EQ(gtestRecordercpu.pc, RecordedCpu.pc);
+	EXPECT_EQ(gtestRecordercpu.acc, RecordedCpu.acc);
+	EXPECT_EQ(gtestRecordercpu.x, RecordedCpu.x);
+	EXPECT_EQ(gtestRecordercpu.y, RecordedCpu.y);
+	EXPECT_EQ(memcmp(gtestRecordermem.Data, Recorded.Data, sizeof(Recorded.Data)), 0);
+
+	fclose(Stream);
+}
+
+TEST(testRecorder, BAD_HEADER_TEST)
+{
+	FILE* Stream = tmpfile();
+	ASSERT_TRUE(Stream != NULL);
+	fputs("nope", Stream);
+	rewind(Stream);
+
+	ResetCpu(&gtestRecordercpu, &gtestRecordermem);
+	EXPECT_FALSE(StartReplay(&gtestRecorder, &gtestRecordermem, Stream));
+	EXPECT_TRUE(gtestRecordermem.Recorder == NULL);
+
+	fclose(Stream);
+}
@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestSaveStatecpu;
+struct memory gtestSaveStatemem;
+struct CPU gtestLoadStatecpu;
+struct memory gtestLoadStatemem;
+
+static byte gtestSaveStateBuffer[SAVESTATE_MAX_SIZE];
+
+
+static void FillSaveState(struct CPU* cpu, struct memory* mem)
+{
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x1234;
+	cpu->sp = 0xF0;
+	cpu->acc = 0x11;
+	cpu->x = 0x22;
+	cpu->y = 0x33;
+	cpu->Flags[carryFlag] = 1;
+	cpu->Flags[interruptDisable] = 1;
+	mem->Clock = 0x123456789ULL;
+	mem->IrqLines = 0x5;
+
+	for (int i = 0; i < 0x200; i++)
+	{
+		mem->Data[0x0200 + i] = (byte)(i % 7);			// repeating, compresses
+	}
+	srand(42);
+	for (int i = 0; i < 0x100; i++)
+	{
+		mem->Data[0x8000 + i] = (byte)rand();			// noise, stored raw
+	}
+	mem->Data[0xFFFC] = LDA_IM;
+}
+
+static void ExpectSameSaveState(const struct CPU& cpu1, const struct memory& mem1, const struct CPU& cpu2, const struct memory& mem2)
+{
+	EXPECT_EQ(cpu1.pc, cpu2.pc);
+	EXPECT_EQ(cpu1.sp, cpu2.sp);
+	EXPECT_EQ(cpu1.acc, cpu2.acc);
+	EXPECT_EQ(cpu1.x, cpu2.x);
+	EXPECT_EQ(cpu1.y, cpu2.y);
+	EXPECT_EQ(memcmp(cpu1.Flags, cpu2.Flags, sizeof(cpu1.Flags)), 0);
+	EXPECT_EQ(mem1.Clock, mem2.Clock);
+	EXPECT_EQ(mem1.IrqLines, mem2.IrqLines);
+	EXPECT_EQ(memcmp(mem1.Data, mem2.Data, sizeof(mem1.Data)), 0);
+}
+
+
+TEST(testSaveState, COMPRESSED_TEST)
+{
+	FillSaveState(&gtestSaveStatecpu, &gtestSaveStatemem);
+	ResetCpu(&gtestLoadStatecpu, &gtestLoadStatemem);
+	memset(gtestLoadStatemem.Data, 0xAA, sizeof(gtestLoadStatemem.Data));
+
+	const size_t Size = SaveState(&gtestSaveStatecpu, &gtestSaveStatemem, gtestSaveStateBuffer, sizeof(gtestSaveStateBuffer), true);
+
+	EXPECT_GT(Size, 0u);
+	EXPECT_LT(Size, 1024u);
+	EXPECT_TRUE(LoadState(&gtestLoadStatecpu, &gtestLoadStatemem, gtestSaveStateBuffer, Size));
+	ExpectSameSaveState(gtestLoadStatecpu, gtestLoadStatemem, gtestSaveStatecpu, gtestSaveStatemem);
+}
+
+TEST(testSaveState, UNCOMPRESSED_TEST)
+{
+	FillSaveState(&gtestSaveStatecpu, &gtestSaveStatemem);
+	ResetCpu(&gtestLoadStatecpu, &gtestLoadStatemem);
+
+	const size_t Size = SaveState(&gtestSaveStatecpu, &gtestSaveStatemem, gtestSaveStateBuffer, sizeof(gtestSaveStateBuffer), false);
+
+	EXPECT_GT(Size, (size_t)MAX_MEM);
+	EXPECT_TRUE(LoadState(&gtestLoadStatecpu, &gtestLoadStatemem, gtestSaveStateBuffer, Size));
+	ExpectSameSaveState(gtestLoadStatecpu, gtestLoadStatemem, gtestSaveStatecpu, gtestSaveStatemem);
+}
+
+TEST(testSaveState, CORRUPT_TEST)
+{
+	FillSaveState(&gtestSaveStatecpu, &gtestSaveStatemem);
+
+	const size_t Size = SaveState(&gtestSaveStatecpu, &gtestSaveStatemem, gtestSaveStateBuffer, sizeof(gtestSaveStateBuffer), true);
+
+	ResetCpu(&gtestLoadStatecpu, &gtestLoadStatemem);
+	memset(gtestLoadStatemem.Data, 0xAA, sizeof(gtestLoadStatemem.Data));
+	EXPECT_FALSE(LoadState(&gtestLoadStatecpu, &gtestLoadStatemem, gtestSaveStateBuffer, Size / 2));
+	EXPECT_FALSE(LoadState(&gtestLoadStatecpu, &gtestLoadStatemem, gtestSaveStateBuffer, Size - 1));	// only the last page is cut
+	EXPECT_EQ(gtestLoadStatecpu.pc, RESET_VECTOR);			// nothing is loaded from a broken state
+	EXPECT_EQ(gtestLoadStatemem.Clock, 0u);
+	EXPECT_EQ(gtestLoadStatemem.Data[0x0201], 0xAA);
+	gtestSaveStateBuffer[4] = SAVESTATE_VERSION + 1;
+	EXPECT_FALSE(LoadState(&gtestLoadStatecpu, &gtestLoadStatemem, gtestSaveStateBuffer, Size));
+	EXPECT_EQ(SaveState(&gtestSaveStatecpu, &gtestSaveStatemem, gtestSaveStateBuffer, 100, true), 0u);
+}
+
+TEST(testSaveState, FILE_TEST)
+{
+	const char* Path = "gtestSaveState.bin";
+	FillSaveState(&gtestSaveStatecpu, &gtestSaveStatemem);
+
+	for (int Compress = 0; Compress < 2; Compress++)
+	{
+		ResetCpu(&gtestLoadStatecpu, &gtestLoadStatemem);
+		EXPECT_TRUE(SaveStateFile(&gtestSaveStatecpu, &gtestSaveStatemem, Path, Compress));
+		EXPECT_TRUE(LoadStateFile(&gtestLoadStatecpu, &gtestLoadStatemem, Path));
+		ExpectSameSaveState(gtestLoadStatecpu, gtestLoadStatemem, gtestSaveStatecpu, gtestSaveStatemem);
+	}
+	remove(Path);
+}
@@ -0,0 +1,132 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestScancpu;
+struct memory gtestScanmem;
+struct memory gtestScanOthermem;
+struct scan gtestScan;
+struct scan gtestScanScalar;
+struct scan_match gtestScanMatches[4096];
+
+
+static void FillNoise(struct memory* mem, uint32_t Seed)
+{
+	for (int i = 0; i < MAX_MEM; i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		mem->Data[i] = (byte)(Seed >> 16);
+	}
+}
+
+static int CountByHand(const struct memory* mem, const struct scan_pattern* Pattern)
+{
+	int Found = 0;
+	for (int Address = 0; Address + Pattern->Length <= MAX_MEM; Address++)
+	{
+		bool Match = true;
+		for (int i = 0; i < Pattern->Length && Match; i++)
+		{
+			Match = !((mem->Data[Address + i] ^ Pattern->Bytes[i]) & Pattern->Mask[i]);
+		}
+		Found += Match;
+	}
+	return Found;
+}
+
+
+TEST(testScan, PARSE_PATTERN_TEST)
+{
+	struct scan_pattern Pattern;
+	ASSERT_TRUE(ParsePattern(&Pattern, "A9 ?? 8d0002"));
+	EXPECT_EQ(Pattern.Length, 5);
+	EXPECT_EQ(Pattern.Bytes[0], 0xA9);
+	EXPECT_EQ(Pattern.Mask[1], 0x00);
+	EXPECT_EQ(Pattern.Bytes[2], 0x8D);
+	EXPECT_EQ(Pattern.Mask[4], 0xFF);
+
+	EXPECT_FALSE(ParsePattern(&Pattern, ""));
+	EXPECT_FALSE(ParsePattern(&Pattern, "A9 8"));
+	EXPECT_FALSE(ParsePattern(&Pattern, "A9 G0"));
+	EXPECT_FALSE(ParsePattern(&Pattern, "A9 ?0"));
+}
+
+TEST(testScan, FIND_PATTERN_TEST)
+{
+	const byte Code[] = { LDA_IM, 0x42, STA_ABS, 0x00, 0x02 };
+	const struct memory* Instances[] = { &gtestScanmem, &gtestScanOthermem };
+	struct scan_pattern Pattern;
+	ParsePattern(&Pattern, "A9 ?? 8D 00 02");
+
+	FillNoise(&gtestScanmem, 1);
+	FillNoise(&gtestScanOthermem, 2);
+	memcpy(&gtestScanmem.Data[0x0000], Code, sizeof(Code));
+	memcpy(&gtestScanmem.Data[0x1234], Code, sizeof(Code));
+	memcpy(&gtestScanmem.Data[MAX_MEM - sizeof(Code)], Code, sizeof(Code));	// scalar tail
+	memcpy(&gtestScanOthermem.Data[0x8000], Code, sizeof(Code));
+	gtestScanOthermem.Data[0x8001] = 0x99;
+	const int Expected = CountByHand(&gtestScanmem, &Pattern) + CountByHand(&gtestScanOthermem, &Pattern);
+	EXPECT_GE(Expected, 4);
+
+	for (int Level = SIMD_SCALAR; Level <= SIMD_AVX2; Level++)
+	{
+		if (SetSimdLevel(Level) != Level)
+		{
+			continue;
+		}
+		ASSERT_EQ(FindPattern(Instances, 2, &Pattern, gtestScanMatches, 4096), Expected);
+		EXPECT_EQ(gtestScanMatches[0].Instance, 0);
+		EXPECT_EQ(gtestScanMatches[0].Address, 0x0000);
+		EXPECT_EQ(gtestScanMatches[Expected - 1].Instance, 1);
+		EXPECT_EQ(gtestScanMatches[Expected - 1].Address, 0x8000);
+		EXPECT_EQ(FindPattern(Instances, 2, &Pattern, gtestScanMatches, 1), Expected);	// counts past Max
+	}
+	SetSimdLevel(SIMD_AVX2);
+
+	ParsePattern(&Pattern, "????");
+	EXPECT_EQ(FindPattern(Instances, 1, &Pattern, gtestScanMatches, 0), MAX_MEM - 1);
+}
+
+TEST(testScan, CHEAT_FINDER_TEST)
+{
+	word Addresses[4];
+	ResetCpu(&gtestScancpu, &gtestScanmem);
+	FillNoise(&gtestScanmem, 3);
+	gtestScanmem.Data[0x0345] = 5;			// the lives counter we're after
+	StartScan(&gtestScan, &gtestScanmem);
+	EXPECT_EQ(gtestScan.Count, (uint32_t)MAX_MEM);
+
+	StoreByte(&gtestScanmem, 0x0345, 4);		// lost a life
+	StoreByte(&gtestScanmem, 0x2000, gtestScanmem.Data[0x2000] - 1);
+	StoreByte(&gtestScanmem, 0x3000, gtestScanmem.Data[0x3000] + 1);
+	EXPECT_EQ(FilterScan(&gtestScan, &gtestScanmem, SCAN_DECREASED, 0), 2u);
+
+	StoreByte(&gtestScanmem, 0x2000, 0x80);
+	EXPECT_EQ(FilterScan(&gtestScan, &gtestScanmem, SCAN_UNCHANGED, 0), 1u);
+	EXPECT_EQ(FilterScan(&gtestScan, &gtestScanmem, SCAN_EQUAL, 4), 1u);
+	EXPECT_EQ(ScanResults(&gtestScan, Addresses, 4), 1);
+	EXPECT_EQ(Addresses[0], 0x0345);
+}
+
+TEST(testScan, SIMD_FILTERS_MATCH_SCALAR_TEST)
+{
+	for (int Filter = SCAN_EQUAL; Filter <= SCAN_DECREASED; Filter++)
+	{
+		for (int Level = SIMD_SSE2; Level <= SIMD_AVX2; Level++)
+		{
+			FillNoise(&gtestScanmem, 4);
+			FillNoise(&gtestScanOthermem, 5);
+			SetSimdLevel(SIMD_SCALAR);
+			StartScan(&gtestScanScalar, &gtestScanmem);
+			FilterScan(&gtestScanScalar, &gtestScanOthermem, Filter, 0x80);
+			if (SetSimdLevel(Level) != Level)
+			{
+				continue;
+			}
+			StartScan(&gtestScan, &gtestScanmem);
+			FilterScan(&gtestScan, &gtestScanOthermem, Filter, 0x80);
+			EXPECT_EQ(gtestScan.Count, gtestScanScalar.Count);
+			EXPECT_EQ(memcmp(gtestScan.Candidates, gtestScanScalar.Candidates, sizeof(gtestScan.Candidates)), 0);
+		}
+	}
+	SetSimdLevel(SIMD_AVX2);
+}
@@ -0,0 +1,162 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestSharedcpu;
+struct shared_memory gtestShared;
+struct shared_view gtestSharedView;
+bool gtestSharedDuring;
+
+
+// Runs inside Execute(): the frame published before the run can still be copied
+static void SharedTrap(struct CPU* cpu, struct memory* mem, void* Context)
+{
+	static byte Data[MAX_MEM];
+	gtestSharedDuring = SharedSnapshot(&gtestSharedView, Data, NULL, NULL);
+}
+
+static void LoadSharedProgram(struct CPU* cpu, struct memory* mem)
+{
+	const byte Program[] = {
+		LDA_IM, 0x5A,
+		STA_ABS, 0x00, 0x03,
+		JSR, 0x00, 0x80,
+		LDX_IM, 0x07,
+		JMP_ABS, 0x0A, 0x02 };
+
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	memcpy(&mem->Data[0x0200], Program, sizeof(Program));
+	RegisterTrap(mem, 0x8000, SharedTrap, 10, NULL);
+}
+
+
+TEST(testShared, MEMFD_VIEW_TEST)
+{
+	ASSERT_TRUE(CreateSharedMemory(&gtestShared, NULL));
+	LoadSharedProgram(&gtestSharedcpu, gtestShared.mem);
+	AttachSharedMemory(&gtestShared, &gtestSharedcpu, 1000);
+
+	// the way another process gets at an anonymous segment
+	char Path[64];
+	snprintf(Path, sizeof(Path), "/proc/self/fd/%d", gtestShared.Fd);
+	const int Fd = open(Path, O_RDONLY);
+	ASSERT_GE(Fd, 0);
+	ASSERT_TRUE(OpenSharedView(&gtestSharedView, NULL, Fd));
+	close(Fd);
+	EXPECT_EQ(gtestSharedView.Header->DataSize, (uint32_t)MAX_MEM);
+	EXPECT_EQ(gtestSharedView.Data[0x0200], LDA_IM);
+
+	Execute(&gtestSharedcpu, gtestShared.mem, 40);
+	EXPECT_TRUE(gtestSharedDuring);
+	EXPECT_EQ(gtestSharedView.Header->Published, 1u);		// the interval isn't up yet
+	EXPECT_EQ(gtestSharedView.Data[0x0300], 0x5A);		// no copy, the guest's own bytes
+
+	static byte Data[MAX_MEM];
+	struct CPU cpu;
+	uint64_t Clock = 1;
+	ASSERT_TRUE(SharedSnapshot(&gtestSharedView, Data, &cpu, &Clock));
+	EXPECT_EQ(Data[0x0300], 0x00);
+	EXPECT_EQ(Clock, 0u);
+	EXPECT_EQ(cpu.pc, 0x0200);
+
+	Execute(&gtestSharedcpu, gtestShared.mem, 1000);
+	EXPECT_EQ(gtestSharedView.Header->Published, 2u);
+	ASSERT_TRUE(SharedSnapshot(&gtestSharedView, Data, &cpu, &Clock));
+	EXPECT_EQ(Data[0x0300], 0x5A);
+	EXPECT_EQ(Clock, 1000u);
+	EXPECT_EQ(cpu.x, 0x07);
+
+	// host stores are published on request
+	StoreByte(gtestShared.mem, 0x0400, 0x11);
+	ASSERT_TRUE(SharedSnapshot(&gtestSharedView, Data, NULL, NULL));
+	EXPECT_EQ(Data[0x0400], 0x00);
+	PublishShared(&gtestSharedcpu, gtestShared.mem);
+	ASSERT_TRUE(SharedSnapshot(&gtestSharedView, Data, &cpu, &Clock));
+	EXPECT_EQ(memcmp(Data, gtestShared.mem->Data, MAX_MEM), 0);
+	EXPECT_EQ(Clock, gtestShared.mem->Clock);
+	EXPECT_EQ(cpu.pc, gtestSharedcpu.pc);
+
+	// the viewer's mapping outlives the emulator's
+	DestroySharedMemory(&gtestShared);
+	EXPECT_EQ(gtestSharedView.Data[0x0300], 0x5A);
+	CloseSharedView(&gtestSharedView);
+}
+
+TEST(testShared, NAMED_SEGMENT_TEST)
+{
+	char Name[64];
+	struct shared_memory Other;
+	snprintf(Name, sizeof(Name), "/h6502-gtest-%d", (int)getpid());
+	ASSERT_TRUE(CreateSharedMemory(&gtestShared, Name));
+	EXPECT_FALSE(CreateSharedMemory(&Other, Name));
+
+	LoadSharedProgram(&gtestSharedcpu, gtestShared.mem);
+	AttachSharedMemory(&gtestShared, &gtestSharedcpu, 0);
+	ASSERT_TRUE(OpenSharedView(&gtestSharedView, Name, -1));
+	Execute(&gtestSharedcpu, gtestShared.mem, 40);
+	EXPECT_EQ(gtestSharedView.Data[0x0300], 0x5A);
+	CloseSharedView(&gtestSharedView);
+
+	DestroySharedMemory(&gtestShared);
+	EXPECT_FALSE(OpenSharedView(&gtestSharedView, Name, -1));
+
+	FILE* Plain = tmpfile();
+	EXPECT_FALSE(OpenSharedView(&gtestSharedView, NULL, fileno(Plain)));
+	fclose(Plain);
+}
+
+TEST(testShared, CONCURRENT_WRITER_TEST)
+{
+	// stores X twice, a torn copy would show the two bytes more than one apart
+	const byte Program[] = {
+		INX_IM,
+		STX_ABS, 0x00, 0x03,
+		STX_ABS, 0x01, 0x03,
+		JMP_ABS, 0x00, 0x02 };
+
+	ASSERT_TRUE(CreateSharedMemory(&gtestShared, NULL));
+	ResetCpu(&gtestSharedcpu, gtestShared.mem);
+	gtestSharedcpu.pc = 0x0200;
+	memcpy(&gtestShared.mem->Data[0x0200], Program, sizeof(Program));
+	AttachSharedMemory(&gtestShared, &gtestSharedcpu, 1000);
+
+	ASSERT_TRUE(OpenSharedView(&gtestSharedView, NULL, gtestShared.Fd));
+
+	std::atomic<bool> Stop(false);
+	std::thread Host([&Stop]()
+		{
+			while (!Stop.load(std::memory_order_relaxed))
+			{
+				Execute(&gtestSharedcpu, gtestShared.mem, 10000);
+			}
+		});
+
+	static byte Data[MAX_MEM];
+	uint64_t Snapshots = 0;
+	uint64_t LastClock = 0;
+	const auto End = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+	while (std::chrono::steady_clock::now() < End)
+	{
+		struct CPU cpu;
+		uint64_t Clock;
+		if (SharedSnapshot(&gtestSharedView, Data, &cpu, &Clock))
+		{
+			Snapshots++;
+			EXPECT_LE((byte)(Data[0x0300] - Data[0x0301]), 1);
+			EXPECT_GE(Clock, LastClock);
+			LastClock = Clock;
+		}
+	}
+	Stop = true;
+	Host.join();
+
+	EXPECT_GT(Snapshots, 0u);
+	EXPECT_GT(LastClock, 0u);
+	CloseSharedView(&gtestSharedView);
+	DestroySharedMemory(&gtestShared);
+}
@@ -128,7 +128,9 @@ TEST(testJumpInstructions, PHP_TEST)				// PHP
 	ResetCpu(&gtestStackInstrcpu, &gtestStackInstrmem);
 	gtestStackInstrcpu.pc = 0xFF00;
 
-	*gtestStackInstrcpu.Flags = 0xCC;
+	gtestStackInstrcpu.Flags[carryFlag] = 1;
+	gtestStackInstrcpu.Flags[interruptDisable] = 1;
+	gtestStackInstrcpu.Flags[decimalMode] = 1;
 
 	gtestStackInstrmem.Data[0xFF00] = PHP;
 
@@ -138,7 +140,7 @@ TEST(testJumpInstructions, PHP_TEST)				// PHP
 	uint32_t numCycles = Execute(&gtestStackInstrcpu, &gtestStackInstrmem, ExpectedCycles);
 
 	EXPECT_EQ(numCycles, ExpectedCycles);
-	EXPECT_EQ(0xCC, gtestStackInstrmem.Data[SPtoWord(&gtestStackInstrcpu) + 1]);
+	EXPECT_EQ(0x3D, gtestStackInstrmem.Data[SPtoWord(&gtestStackInstrcpu) + 1]);		// C, I, D plus the B and unused bits
 	CheckStatusFlag(gtestStackInstrcpu, cpuCopy);
 }
 
@@ -168,17 +170,19 @@ TEST(testJumpInstructions, PLP_TEST)				// PLP
 	ResetCpu(&gtestStackInstrcpu, &gtestStackInstrmem);
 	gtestStackInstrcpu.pc = 0xFF00;
 
-	*gtestStackInstrcpu.Flags = 0x00;
-	gtestStackInstrmem.Data[SPtoWord(&gtestStackInstrcpu) + 1] = 0x42;
+	gtestStackInstrcpu.sp = 0xFE;
+	gtestStackInstrmem.Data[SPtoWord(&gtestStackInstrcpu) + 1] = 0x0F;
 
 	gtestStackInstrmem.Data[0xFF00] = PLP;
 
 	const uint32_t ExpectedCycles = 4;
-	const struct CPU cpuCopy = gtestStackInstrcpu;
 
 	uint32_t numCycles = Execute(&gtestStackInstrcpu, &gtestStackInstrmem, ExpectedCycles);
 
 	EXPECT_EQ(numCycles, ExpectedCycles);
-	EXPECT_EQ(*gtestStackInstrcpu.Flags, gtestStackInstrmem.Data[SPtoWord(&gtestStackInstrcpu) + 1]);
-	CheckStatusFlag(gtestStackInstrcpu, cpuCopy);
+	EXPECT_TRUE(gtestStackInstrcpu.Flags[carryFlag]);
+	EXPECT_TRUE(gtestStackInstrcpu.Flags[zeroFlag]);
+	EXPECT_TRUE(gtestStackInstrcpu.Flags[interruptDisable]);
+	EXPECT_TRUE(gtestStackInstrcpu.Flags[decimalMode]);
+	EXPECT_FALSE(gtestStackInstrcpu.Flags[negativeFlag - 1]);
 }
\ No newline at end of file
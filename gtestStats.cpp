@@ -0,0 +1,78 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestStatscpu;
+struct memory gtestStatsmem;
+struct stats gtestStats;
+
+
+// 16 iterations of zp, abs,Y (always crossing a page) and (zp),Y loads, then a jump-to-self
+static void LoadStatsProgram(struct CPU* cpu, struct memory* mem)
+{
+	const byte Program[] = {
+		LDY_IM, 0xF0,
+		LDA_ZP, 0x10,
+		LDA_ABSY, 0x80, 0x30,
+		LDA_INDY, 0x40,
+		INY_IM,
+		BNE, 0xF6,
+		JMP_ABS, 0x0C, 0x02 };
+
+	ResetCpu(cpu, mem);
+	cpu->pc = 0x0200;
+	memcpy(&mem->Data[0x0200], Program, sizeof(Program));
+	mem->Data[0x0040] = 0x00;
+	mem->Data[0x0041] = 0x50;
+}
+
+
+TEST(testStats, COUNTERS_TEST)
+{
+	LoadStatsProgram(&gtestStatscpu, &gtestStatsmem);
+	AttachStats(&gtestStats, &gtestStatsmem);
+
+	Execute(&gtestStatscpu, &gtestStatsmem, 300);
+
+	EXPECT_EQ(gtestStatscpu.pc, 0x020C);
+	EXPECT_EQ(gtestStats.Pairs[LDY_IM][LDA_ZP], 1u);
+	EXPECT_EQ(gtestStats.Pairs[LDA_ZP][LDA_ABSY], 16u);
+	EXPECT_EQ(gtestStats.Pairs[BNE][LDA_ZP], 15u);
+	EXPECT_EQ(TripleCount(&gtestStats, LDA_ZP, LDA_ABSY, LDA_INDY), 16u);
+	EXPECT_EQ(TripleCount(&gtestStats, INY_IM, BNE, JMP_ABS), 1u);
+	EXPECT_EQ(TripleCount(&gtestStats, INY_IM, INY_IM, INY_IM), 0u);
+	EXPECT_EQ(gtestStats.TriplesDropped, 0u);
+
+	EXPECT_EQ(gtestStats.ZeroPage[0x10], 16u);
+	EXPECT_EQ(gtestStats.Pages[STAT_ZERO_PAGE][0x00], 16u);
+	EXPECT_EQ(gtestStats.Pages[STAT_ABSOLUTE][0x31], 16u);
+	EXPECT_EQ(gtestStats.Pages[STAT_INDIRECT][0x50], 16u);
+	EXPECT_EQ(gtestStats.Indexed[STAT_ABSOLUTE], 16u);
+	EXPECT_EQ(gtestStats.PageCrosses[STAT_ABSOLUTE], 16u);
+	EXPECT_EQ(gtestStats.Indexed[STAT_INDIRECT], 16u);
+	EXPECT_EQ(gtestStats.PageCrosses[STAT_INDIRECT], 0u);
+	EXPECT_EQ(gtestStats.Branches, 16u);
+	EXPECT_EQ(gtestStats.BranchesTaken, 15u);
+	EXPECT_EQ(gtestStats.BranchCrosses, 0u);
+}
+
+TEST(testStats, EXPORT_TEST)
+{
+	LoadStatsProgram(&gtestStatscpu, &gtestStatsmem);
+	AttachStats(&gtestStats, &gtestStatsmem);
+	Execute(&gtestStatscpu, &gtestStatsmem, 300);
+
+	FILE* Stream = tmpfile();
+	ASSERT_TRUE(Stream != NULL);
+	EXPECT_TRUE(WriteStats(&gtestStats, Stream));
+
+	char Text[16384] = { 0 };
+	rewind(Stream);
+	fread(Text, 1, sizeof(Text) - 1, Stream);
+	fclose(Stream);
+
+	EXPECT_TRUE(strstr(Text, "pair,A5,B9,16\n") != NULL);
+	EXPECT_TRUE(strstr(Text, "triple,A5,B9,B1,16\n") != NULL);
+	EXPECT_TRUE(strstr(Text, "zeropage,10,16\n") != NULL);
+	EXPECT_TRUE(strstr(Text, "cross,abs,16,16\n") != NULL);
+	EXPECT_TRUE(strstr(Text, "branch,16,15,0\n") != NULL);
+}
@@ -162,7 +162,7 @@ TEST(testStoreRegister, STX_ZP_TEST)						// STX zero page
 
 TEST(testStoreRegister, STX_ZPY_TEST)					// STX zero page + y register
 {
-	gtestStoreRegisterZP(&gtestStorecpu, &gtestStoremem, STX_ZPY, &gtestStorecpu.x);
+	gtestStoreRegisterZPY(&gtestStorecpu, &gtestStoremem, STX_ZPY, &gtestStorecpu.x);
 }
 
 TEST(testStoreRegister, STX_ABS_TEST)					// STX absolute
@@ -0,0 +1,135 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestTimelinecpu;
+struct memory gtestTimelinemem;
+struct timeline gtestTimeline;
+
+static byte DeviceCounter;
+
+
+static byte CountingDeviceRead(struct memory* mem, const word Address, const uint64_t Now, void* Context)
+{
+	return DeviceCounter += 3;	// not rewound, the timeline has to replay it
+}
+
+static void LoadTimelineProgram(struct CPU* cpu, struct memory* mem, struct timeline* Timeline)
+{
+	ResetCpu(cpu, mem);
+	cpu->pc = 0xFF00;
+	DeviceCounter = 0;
+
+	AttachDevice(mem, 0x9000, PAGE_SIZE, CountingDeviceRead, NULL, NULL);
+
+	mem->Data[0xFF00] = INX_IM;
+	mem->Data[0xFF01] = STX_ZP;
+	mem->Data[0xFF02] = 0x42;
+	mem->Data[0xFF03] = LDA_ABS;
+	mem->Data[0xFF04] = 0x00;
+	mem->Data[0xFF05] = 0x90;
+	mem->Data[0xFF06] = STA_ABSX;
+	mem->Data[0xFF07] = 0x00;
+	mem->Data[0xFF08] = 0x03;
+	mem->Data[0xFF09] = JMP_ABS;
+	mem->Data[0xFF0A] = 0x00;
+	mem->Data[0xFF0B] = 0xFF;
+
+	AttachTimeline(Timeline, cpu, mem, 100);
+}
+
+static void ExpectSameState(const struct CPU& cpu1, const struct memory& mem1, const struct CPU& cpu2, const struct memory& mem2)
+{
+	EXPECT_EQ(mem1.Clock, mem2.Clock);
+	EXPECT_EQ(cpu1.pc, cpu2.pc);
+	EXPECT_EQ(cpu1.sp, cpu2.sp);
+	EXPECT_EQ(cpu1.acc, cpu2.acc);
+	EXPECT_EQ(cpu1.x, cpu2.x);
+	EXPECT_EQ(cpu1.y, cpu2.y);
+	EXPECT_EQ(memcmp(mem1.Data, mem2.Data, sizeof(mem1.Data)), 0);
+}
+
+
+TEST(testTimeline, SEEK_TEST)
+{
+	static struct memory Middle;
+	static struct memory Last;
+
+	LoadTimelineProgram(&gtestTimelinecpu, &gtestTimelinemem, &gtestTimeline);
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 500);
+	const struct CPU MiddleCpu = gtestTimelinecpu;
+	Middle = gtestTimelinemem;
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 1000);
+	const struct CPU LastCpu = gtestTimelinecpu;
+	Last = gtestTimelinemem;
+
+	EXPECT_TRUE(SeekToCycle(&gtestTimelinecpu, &gtestTimelinemem, Middle.Clock));
+	ExpectSameState(gtestTimelinecpu, gtestTimelinemem, MiddleCpu, Middle);
+	EXPECT_TRUE(gtestTimeline.Replaying);
+
+	EXPECT_TRUE(SeekToCycle(&gtestTimelinecpu, &gtestTimelinemem, Last.Clock));
+	ExpectSameState(gtestTimelinecpu, gtestTimelinemem, LastCpu, Last);
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 100);
+	EXPECT_FALSE(gtestTimeline.Replaying);
+}
+
+TEST(testTimeline, SEEK_BACK_FORWARD_BACK_TEST)
+{
+	static struct memory Saved;
+
+	LoadTimelineProgram(&gtestTimelinecpu, &gtestTimelinemem, &gtestTimeline);
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 1000);
+	const struct CPU SavedCpu = gtestTimelinecpu;
+	Saved = gtestTimelinemem;
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 1000);
+
+	// the snapshots re-taken while replaying towards 2000 have to point into the log as well
+	EXPECT_TRUE(SeekToCycle(&gtestTimelinecpu, &gtestTimelinemem, 200));
+	EXPECT_TRUE(SeekToCycle(&gtestTimelinecpu, &gtestTimelinemem, 2000));
+	EXPECT_TRUE(SeekToCycle(&gtestTimelinecpu, &gtestTimelinemem, Saved.Clock));
+	ExpectSameState(gtestTimelinecpu, gtestTimelinemem, SavedCpu, Saved);
+}
+
+TEST(testTimeline, REVERSE_STEP_TEST)
+{
+	static struct memory Before;
+
+	LoadTimelineProgram(&gtestTimelinecpu, &gtestTimelinemem, &gtestTimeline);
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 700);
+	const struct CPU BeforeCpu = gtestTimelinecpu;
+	Before = gtestTimelinemem;
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 1);
+	const uint64_t After = gtestTimelinemem.Clock;
+
+	EXPECT_TRUE(ReverseStep(&gtestTimelinecpu, &gtestTimelinemem));
+	ExpectSameState(gtestTimelinecpu, gtestTimelinemem, BeforeCpu, Before);
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 1);
+	EXPECT_EQ(gtestTimelinemem.Clock, After);
+}
+
+TEST(testTimeline, REVERSE_CONTINUE_TEST)
+{
+	LoadTimelineProgram(&gtestTimelinecpu, &gtestTimelinemem, &gtestTimeline);
+
+	Execute(&gtestTimelinecpu, &gtestTimelinemem, 1000);
+	const byte LastX = gtestTimelinecpu.x;
+
+	SetBreakpoint(&gtestTimelinemem, 0xFF06, BREAK_EXEC);
+	EXPECT_TRUE(ReverseContinue(&gtestTimelinecpu, &gtestTimelinemem));
+
+	EXPECT_EQ(gtestTimelinemem.StopReason, STOP_BREAKPOINT);
+	EXPECT_EQ(gtestTimelinecpu.pc, 0xFF06);
+	EXPECT_EQ(gtestTimelinecpu.x, gtestTimelinemem.Data[0x42]);
+	EXPECT_TRUE(gtestTimelinecpu.x == LastX || gtestTimelinecpu.x == LastX - 1);
+
+	const byte HitX = gtestTimelinecpu.x;
+	EXPECT_TRUE(ReverseContinue(&gtestTimelinecpu, &gtestTimelinemem));
+	EXPECT_EQ(gtestTimelinecpu.x, HitX - 1);
+}
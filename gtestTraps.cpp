@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestTrapscpu;
+struct memory gtestTrapsmem;
+
+
+static void MultiplyTrap(struct CPU* cpu, struct memory* mem, void* Context)
+{
+	const word Product = cpu->x * cpu->y;
+	cpu->acc = Product & 0xFF;
+	mem->Data[*(word*)Context] = Product >> 8;
+}
+
+static void LoadTrapProgram(struct CPU* cpu, struct memory* mem)
+{
+	ResetCpu(cpu, mem);
+	cpu->pc = 0xFF00;
+	cpu->x = 30;
+	cpu->y = 20;
+
+	mem->Data[0xFF00] = JSR;
+	mem->Data[0xFF01] = 0x00;
+	mem->Data[0xFF02] = 0x80;
+
+	mem->Data[0x8000] = LDA_IM;		// guest fallback
+	mem->Data[0x8001] = 0x42;
+	mem->Data[0x8002] = RTS;
+}
+
+
+TEST(testTraps, JSR_TRAP_TEST)
+{
+	word High = 0x0010;
+	LoadTrapProgram(&gtestTrapscpu, &gtestTrapsmem);
+	EXPECT_GE(RegisterTrap(&gtestTrapsmem, 0x8000, MultiplyTrap, 100, &High), 0);
+
+	const byte sp = gtestTrapscpu.sp;
+	uint32_t numCycles = Execute(&gtestTrapscpu, &gtestTrapsmem, 6 + 100 + 6);
+
+	EXPECT_EQ(numCycles, 6 + 100 + 6);
+	EXPECT_EQ(gtestTrapscpu.pc, 0xFF03);
+	EXPECT_EQ(gtestTrapscpu.sp, sp);
+	EXPECT_EQ(gtestTrapscpu.acc, 600 & 0xFF);
+	EXPECT_EQ(gtestTrapsmem.Data[0x0010], 600 >> 8);
+	EXPECT_EQ(gtestTrapsmem.Instructions, 1u);
+}
+
+TEST(testTraps, CLEAR_TRAP_TEST)
+{
+	word High = 0x0010;
+	LoadTrapProgram(&gtestTrapscpu, &gtestTrapsmem);
+	RegisterTrap(&gtestTrapsmem, 0x8000, MultiplyTrap, 100, &High);
+	RegisterTrap(&gtestTrapsmem, 0x8010, MultiplyTrap, 100, &High);
+	ClearTrap(&gtestTrapsmem, 0x8000);
+
+	EXPECT_TRUE(gtestTrapsmem.PageFlags[0x80] & PAGE_TRAP);
+	uint32_t numCycles = Execute(&gtestTrapscpu, &gtestTrapsmem, 6 + 2 + 6);
+
+	EXPECT_EQ(numCycles, 6 + 2 + 6);
+	EXPECT_EQ(gtestTrapscpu.pc, 0xFF03);
+	EXPECT_EQ(gtestTrapscpu.acc, 0x42);
+
+	ClearTrap(&gtestTrapsmem, 0x8010);
+	EXPECT_FALSE(gtestTrapsmem.PageFlags[0x80] & PAGE_TRAP);
+}
+
+// Execute() runs on a copy of the registers, a trap still gets the caller's CPU with whatever
+// the instructions before it in the same slice left there, and its changes carry on
+TEST(testTraps, REGISTERS_IN_SLICE_TEST)
+{
+	word High = 0x0010;
+	LoadTrapProgram(&gtestTrapscpu, &gtestTrapsmem);
+	const byte Program[] = { LDX_IM, 0x07, LDY_IM, 0x09, JSR, 0x00, 0x80, TAX_IM };
+	memcpy(&gtestTrapsmem.Data[0xFF00], Program, sizeof(Program));
+	RegisterTrap(&gtestTrapsmem, 0x8000, MultiplyTrap, 100, &High);
+
+	Execute(&gtestTrapscpu, &gtestTrapsmem, 2 + 2 + 6 + 100 + 6 + 2);
+	EXPECT_EQ(gtestTrapscpu.pc, 0xFF08);
+	EXPECT_EQ(gtestTrapscpu.acc, 63);
+	EXPECT_EQ(gtestTrapscpu.x, 63);
+	EXPECT_EQ(gtestTrapscpu.y, 9);
+	EXPECT_EQ(gtestTrapscpu.Registers >> 48, 0u);
+}
@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include "6502.h"
+
+struct CPU gtestViacpu;
+struct memory gtestViamem;
+struct via gtestVia;
+
+
+static word LoadTimer1(struct memory* mem, word pc, const word Value)
+{
+	mem->Data[pc++] = LDA_IM;
+	mem->Data[pc++] = Value & 0xFF;
+	mem->Data[pc++] = STA_ABS;
+	mem->Data[pc++] = VIA_T1CL;
+	mem->Data[pc++] = 0x90;
+	mem->Data[pc++] = LDA_IM;
+	mem->Data[pc++] = Value >> 8;
+	mem->Data[pc++] = STA_ABS;
+	mem->Data[pc++] = VIA_T1CH;
+	mem->Data[pc++] = 0x90;
+	return pc;
+}
+
+
+TEST(testVia, TIMER1_READ_TEST)
+{
+	ResetCpu(&gtestViacpu, &gtestViamem);
+	AttachVia(&gtestVia, &gtestViamem, 0x9000, 1);
+	gtestViacpu.pc = 0xFF00;
+
+	word pc = LoadTimer1(&gtestViamem, 0xFF00, 0x0010);
+	gtestViamem.Data[pc++] = LDA_ABS;
+	gtestViamem.Data[pc++] = VIA_T1CL;
+	gtestViamem.Data[pc++] = 0x90;
+
+	uint32_t numCycles = Execute(&gtestViacpu, &gtestViamem, 2 + 5 + 2 + 5 + 4);
+
+	EXPECT_EQ(numCycles, 18);
+	EXPECT_EQ(gtestVia.Start1, 13);
+	EXPECT_EQ(gtestViacpu.acc, 0x10 - 5);
+}
+
+TEST(testVia, TIMER1_IRQ_TEST)
+{
+	ResetCpu(&gtestViacpu, &gtestViamem);
+	AttachVia(&gtestVia, &gtestViamem, 0x9000, 1);
+	gtestViacpu.pc = 0xFF00;
+
+	word pc = 0xFF00;
+	gtestViamem.Data[pc++] = LDA_IM;
+	gtestViamem.Data[pc++] = 0xC0;
+	gtestViamem.Data[pc++] = STA_ABS;
+	gtestViamem.Data[pc++] = VIA_IER;
+	gtestViamem.Data[pc++] = 0x90;
+	pc = LoadTimer1(&gtestViamem, pc, 0x0020);
+	gtestViamem.Data[pc] = JMP_ABS;
+	gtestViamem.Data[pc + 1] = pc & 0xFF;
+	gtestViamem.Data[pc + 2] = pc >> 8;
+
+	gtestViamem.Data[IRQ_VECTOR] = 0x00;
+	gtestViamem.Data[IRQ_VECTOR + 1] = 0x80;
+	gtestViamem.Data[0x8000] = JMP_ABS;
+	gtestViamem.Data[0x8001] = 0x00;
+	gtestViamem.Data[0x8002] = 0x80;
+
+	Execute(&gtestViacpu, &gtestViamem, 40);
+	EXPECT_EQ(gtestViacpu.pc, pc);
+	EXPECT_EQ(gtestViamem.IrqLines, 0);
+
+	Execute(&gtestViacpu, &gtestViamem, 40);
+	EXPECT_EQ(gtestViacpu.pc, 0x8000);
+	EXPECT_EQ(gtestVia.Ifr & 0xC0, 0xC0);
+	EXPECT_EQ(gtestViamem.IrqLines, 1);
+}
+
+TEST(testVia, TIMER1_FREE_RUN_TEST)
+{
+	ResetCpu(&gtestViacpu, &gtestViamem);
+	AttachVia(&gtestVia, &gtestViamem, 0x9000, 1);
+	gtestViacpu.pc = 0xFF00;
+
+	word pc = 0xFF00;
+	gtestViamem.Data[pc++] = LDA_IM;
+	gtestViamem.Data[pc++] = 0x40;
+	gtestViamem.Data[pc++] = STA_ABS;
+	gtestViamem.Data[pc++] = VIA_ACR;
+	gtestViamem.Data[pc++] = 0x90;
+	pc = LoadTimer1(&gtestViamem, pc, 0x0100);
+	gtestViamem.Data[pc] = JMP_ABS;
+	gtestViamem.Data[pc + 1] = pc & 0xFF;
+	gtestViamem.Data[pc + 2] = pc >> 8;
+
+	Execute(&gtestViacpu, &gtestViamem, 100000);
+
+	const uint64_t Elapsed = gtestViamem.Clock - gtestVia.Start1;
+	EXPECT_LT(Elapsed, 0x100 + 2);
+	EXPECT_EQ(gtestVia.Ifr & 0x40, 0x40);
+	EXPECT_EQ(gtestViamem.IrqLines, 0);
+}
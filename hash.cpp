@@ -0,0 +1,131 @@
+#include "6502.h"
+
+
+static uint64_t Mix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;		// splitmix64 finalizer
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+// The Zobrist key of Value at Address. Zero bytes contribute nothing, so a cleared memory
+// hashes to zero and a full rehash only has to visit the non-zero bytes.
+uint64_t HashByte(const word Address, const byte Value)
+{
+	return Value ? Mix((uint64_t)Address << 8 | Value) : 0;
+}
+
+// The key of Value at Offset into the banks of a writable mapper, apart from every HashByte() key
+uint64_t HashBankByte(const size_t Offset, const byte Value)
+{
+	return Value ? Mix((uint64_t)(Offset + MAX_MEM) << 8 | Value) : 0;
+}
+
+// XORs the keys of Count bytes at Address into the hash, a no-op while hashing is off.
+// Called once before and once after host code rewrites a block, the old keys cancel out.
+void HashRange(struct memory* mem, const word Address, const int Count)
+{
+	for (int i = 0; i < Count; i++)
+	{
+		const word a = Address + i;
+		if (mem->PageFlags[a >> 8] & PAGE_HASH)
+		{
+			mem->DataHash ^= HashByte(a, mem->Data[a]);
+		}
+	}
+}
+
+void RehashMemory(struct memory* mem)
+{
+	if (!(mem->PageFlags[0] & PAGE_HASH))
+	{
+		return;
+	}
+	mem->DataHash = 0;
+	for (int Address = 0; Address < MAX_MEM; Address++)
+	{
+		mem->DataHash ^= HashByte(Address, mem->Data[Address]);
+	}
+}
+
+// Every write goes through BusWrite() from now on, which keeps DataHash current
+void EnableMemoryHash(struct memory* mem)
+{
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		mem->PageFlags[Page] |= PAGE_HASH;
+	}
+	RehashMemory(mem);
+}
+
+void DisableMemoryHash(struct memory* mem)
+{
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		mem->PageFlags[Page] &= ~PAGE_HASH;
+	}
+}
+
+// The selected banks and the contents of RAM banks, zero without a mapper
+static uint64_t BankState(const struct memory* mem)
+{
+	const struct mapper* Mapper = mem->Mapper;
+	if (!Mapper)
+	{
+		return 0;
+	}
+	uint64_t Banks = Mapper->BankHash;
+	for (int i = 0; i < Mapper->NumSlots; i++)
+	{
+		Banks ^= Mix((uint64_t)i << 32 | (uint32_t)Mapper->Slots[i].Bank);
+	}
+	return Banks;
+}
+
+static bool SameBanks(const struct memory* mem1, const struct memory* mem2)
+{
+	const struct mapper* Mapper1 = mem1->Mapper;
+	const struct mapper* Mapper2 = mem2->Mapper;
+	if (!Mapper1 || !Mapper2)
+	{
+		return Mapper1 == Mapper2;
+	}
+	const size_t Size = Mapper1->NumBanks * Mapper1->BankSize;
+	if (Mapper1->NumSlots != Mapper2->NumSlots || Mapper1->Writable != Mapper2->Writable || Size != Mapper2->NumBanks * Mapper2->BankSize)
+	{
+		return false;
+	}
+	for (int i = 0; i < Mapper1->NumSlots; i++)
+	{
+		if (Mapper1->Slots[i].Bank != Mapper2->Slots[i].Bank)
+		{
+			return false;
+		}
+	}
+	return !Mapper1->Writable || !memcmp(Mapper1->Banks, Mapper2->Banks, Size);
+}
+
+// DataHash with the registers, flags and banks folded in, memory hashing has to be enabled
+uint64_t StateHash(const struct CPU* cpu, const struct memory* mem)
+{
+	uint64_t Flags = 0;
+	memcpy(&Flags, cpu->Flags, sizeof(cpu->Flags));
+	const uint64_t Registers = cpu->pc | (uint64_t)cpu->sp << 16 | (uint64_t)cpu->acc << 24 | (uint64_t)cpu->x << 32 | (uint64_t)cpu->y << 40;
+	const uint64_t Hash = Mix(Mix(mem->DataHash ^ Registers) ^ Flags);
+	return mem->Mapper ? Mix(Hash ^ BankState(mem)) : Hash;
+}
+
+// One compare for states that differ, the full comparison only confirms a hash match
+bool StatesEqual(const struct CPU* cpu1, const struct memory* mem1, const struct CPU* cpu2, const struct memory* mem2)
+{
+	return StateHash(cpu1, mem1) == StateHash(cpu2, mem2)
+		&& cpu1->pc == cpu2->pc
+		&& cpu1->sp == cpu2->sp
+		&& cpu1->acc == cpu2->acc
+		&& cpu1->x == cpu2->x
+		&& cpu1->y == cpu2->y
+		&& !memcmp(cpu1->Flags, cpu2->Flags, sizeof(cpu1->Flags))
+		&& SameBanks(mem1, mem2)
+		&& !memcmp(mem1->Data, mem2->Data, sizeof(mem1->Data));
+}
@@ -0,0 +1,102 @@
+#include "6502.h"
+
+#define IDLE_MAX_BODY 32	// longest loop body, in bytes, considered for skipping
+
+
+// Length of an instruction allowed in a skippable loop body, 0 for anything that writes
+// memory, touches the stack, changes the I flag or jumps
+static int IdleInstructionLength(const byte Opcode)
+{
+	switch (Opcode)
+	{
+	case TAX_IM: case TAY_IM: case TXA_IM: case TYA_IM:
+	case INX_IM: case DEX_IM: case INY_IM: case DEY_IM:
+	case TSX:
+	{
+		return 1;
+	}
+	case LDA_IM: case LDA_ZP: case LDA_ZPX: case LDA_INDX: case LDA_INDY:
+	case LDX_IM: case LDX_ZP: case LDX_ZPY:
+	case LDY_IM: case LDY_ZP: case LDY_ZPX:
+	case AND_IM: case AND_ZP: case AND_ZPX: case AND_INDX: case AND_INDY:
+	case OR_IM: case OR_ZP: case OR_ZPX: case OR_INDX: case OR_INDY:
+	case EOR_IM: case EOR_ZP: case EOR_ZPX: case EOR_INDX: case EOR_INDY:
+	{
+		return 2;
+	}
+	case LDA_ABS: case LDA_ABSX: case LDA_ABSY:
+	case LDX_ABS: case LDX_ABSY:
+	case LDY_ABS: case LDY_ABSX:
+	case AND_ABS: case AND_ABSX: case AND_ABSY:
+	case OR_ABS: case OR_ABSX: case OR_ABSY:
+	case EOR_ABS: case EOR_ABSX: case EOR_ABSY:
+	{
+		return 3;
+	}
+	}
+	return 0;
+}
+
+// The body from the loop head up to and including the back edge only reads memory and
+// registers, and no execution breakpoint can fire inside it
+static bool IsIdleBody(const struct memory* mem, const word Head, const word Branch)
+{
+	word Address = Head;
+	while (Address != Branch)
+	{
+		if ((word)(Branch - Address) > IDLE_MAX_BODY || (mem->PageFlags[Address >> 8] & (PAGE_BREAK | PAGE_BANK)))
+		{
+			return false;
+		}
+
+		int Length = IdleInstructionLength(mem->Data[Address]);
+		if ((mem->Data[Address] == BEQ || mem->Data[Address] == BNE) && (word)(Address + 2 + (int8_t)mem->Data[Address + 1] - Head) <= (word)(Branch - Head))
+		{
+			Length = 2;	// forward branch that stays inside the body
+		}
+		if (!Length)
+		{
+			return false;
+		}
+		Address += Length;
+	}
+	return !(mem->PageFlags[Branch >> 8] & (PAGE_BREAK | PAGE_BANK));
+}
+
+// Called on every taken backward BEQ/BNE/JMP, after the jump. Taking the same back edge twice
+// in one slice with identical registers and no device access in between means the body
+// is a fixed point: memory only changes at slice boundaries, so every further iteration
+// up to the deadline is a copy of the last one and is skipped in whole iterations.
+// Calls, returns and indirect jumps reset the comparison, so the two back edges are always
+// one pass through the body and not two separate visits to the same loop.
+void SkipIdleLoop(struct CPU* cpu, struct memory* mem, const word Branch, size_t* Cycles)
+{
+	const uint64_t Now = mem->Clock - *Cycles;
+
+	if (mem->IdleSince == NO_EVENT
+		|| mem->IdleBranch != Branch
+		|| mem->IdleBusAccesses != mem->BusAccesses
+		|| mem->IdleCpu.Registers != cpu->Registers
+		|| memcmp(mem->IdleCpu.Flags, cpu->Flags, sizeof(cpu->Flags)))
+	{
+		mem->IdleBranch = Branch;
+		mem->IdleSince = Now;
+		mem->IdleInstructions = mem->Instructions;
+		mem->IdleBusAccesses = mem->BusAccesses;
+		mem->IdleCpu = *cpu;
+		return;
+	}
+
+	if (mem->Deadline <= Now || !IsIdleBody(mem, cpu->pc, Branch))
+	{
+		mem->IdleSince = NO_EVENT;
+		return;
+	}
+
+	const uint64_t Cost = Now - mem->IdleSince;
+	const uint64_t Iterations = (mem->Deadline - Now) / Cost;
+
+	*Cycles -= Iterations * Cost;
+	mem->Instructions += Iterations * (mem->Instructions - mem->IdleInstructions);
+	mem->IdleSince = NO_EVENT;
+}
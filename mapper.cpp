@@ -0,0 +1,198 @@
+#include "6502.h"
+
+
+static bool SetBanks(struct mapper* Mapper, byte* Banks, const size_t Size, const size_t BankSize)
+{
+	Mapper->Banks = Banks;
+	Mapper->BankSize = BankSize;
+	Mapper->NumBanks = BankSize ? (int)(Size / BankSize) : 0;
+	return Banks && Mapper->NumBanks > 0;
+}
+
+static void AddSlot(struct mapper* Mapper, const word Base, const size_t Size, const int Bank)
+{
+	struct mapper_slot* Slot = &Mapper->Slots[Mapper->NumSlots++];
+	Slot->Base = Base;
+	Slot->Size = Size;
+	SwitchBank(Mapper, Mapper->NumSlots - 1, Bank);
+}
+
+// The standard boards, MAPPER_LATCH takes InitLatchMapper(). Banks is split into banks of the
+// board's size, a partial one at the end is left out. False if there isn't a single bank.
+bool InitMapper(struct mapper* Mapper, const int Type, byte* Banks, const size_t Size)
+{
+	memset(Mapper, 0, sizeof(*Mapper));
+	Mapper->Type = Type;
+	switch (Type)
+	{
+	case MAPPER_UXROM:
+	{
+		if (!SetBanks(Mapper, Banks, Size, 0x4000))
+		{
+			return false;
+		}
+		AddSlot(Mapper, 0x8000, 0x4000, 0);
+		AddSlot(Mapper, 0xC000, 0x4000, Mapper->NumBanks - 1);
+	} break;
+	case MAPPER_AXROM:
+	{
+		if (!SetBanks(Mapper, Banks, Size, 0x8000))
+		{
+			return false;
+		}
+		AddSlot(Mapper, 0x8000, 0x8000, 0);
+	} break;
+	default:
+	{
+		return false;
+	}
+	}
+	Mapper->Switches = 0;
+	return true;
+}
+
+// One window of BankSize bytes at Base, both whole pages. A write to Register selects the bank
+// (modulo the number of banks) instead of storing anything.
+bool InitLatchMapper(struct mapper* Mapper, byte* Banks, const size_t Size, const word Base, const size_t BankSize, const word Register,
+	const bool Writable)
+{
+	memset(Mapper, 0, sizeof(*Mapper));
+	Mapper->Type = MAPPER_LATCH;
+	Mapper->Register = Register;
+	Mapper->Writable = Writable;
+	if ((Base % PAGE_SIZE) || (BankSize % PAGE_SIZE) || Base + BankSize > MAX_MEM || !SetBanks(Mapper, Banks, Size, BankSize))
+	{
+		return false;
+	}
+	AddSlot(Mapper, Base, BankSize, 0);
+	Mapper->Switches = 0;
+	return true;
+}
+
+// The slot pages and the bank register's page get PAGE_BANK. False, and nothing attached, if
+// one of them has a device: both would want the page's reads and writes. Also false while a
+// timeline is attached, the snapshots it already took don't know which banks were selected.
+bool AttachMapper(struct mapper* Mapper, struct memory* mem)
+{
+	if (mem->Timeline)
+	{
+		return false;
+	}
+	memset(Mapper->PageSlot, 0, sizeof(Mapper->PageSlot));
+	for (int i = 0; i < Mapper->NumSlots; i++)
+	{
+		for (int Page = Mapper->Slots[i].Base >> 8; Page < (int)((Mapper->Slots[i].Base + Mapper->Slots[i].Size) >> 8); Page++)
+		{
+			Mapper->PageSlot[Page] = i + 1;
+		}
+	}
+
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		const bool Register = Mapper->Type == MAPPER_LATCH && Page == Mapper->Register >> 8;
+		if ((Mapper->PageSlot[Page] || Register) && (mem->PageFlags[Page] & PAGE_IO))
+		{
+			return false;
+		}
+	}
+
+	Mapper->BankHash = 0;
+	for (size_t Offset = 0; Mapper->Writable && Offset < Mapper->NumBanks * Mapper->BankSize; Offset++)
+	{
+		Mapper->BankHash ^= HashBankByte(Offset, Mapper->Banks[Offset]);
+	}
+
+	DetachMapper(mem);
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		if (Mapper->PageSlot[Page] || (Mapper->Type == MAPPER_LATCH && Page == Mapper->Register >> 8))
+		{
+			mem->PageFlags[Page] |= PAGE_BANK;
+		}
+	}
+	mem->Mapper = Mapper;
+	return true;
+}
+
+// The pages fall back to whatever Data holds
+void DetachMapper(struct memory* mem)
+{
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		mem->PageFlags[Page] &= ~PAGE_BANK;
+	}
+	mem->Mapper = NULL;
+}
+
+// O(1) whatever the bank size: the slot's pointer moves, nothing is copied. Bank numbers wrap
+// around like the unused high bits of a bank register do.
+void SwitchBank(struct mapper* Mapper, const int Slot, const int Bank)
+{
+	struct mapper_slot* s = &Mapper->Slots[Slot];
+	s->Bank = ((Bank % Mapper->NumBanks) + Mapper->NumBanks) % Mapper->NumBanks;
+	s->Data = Mapper->Banks + s->Bank * Mapper->BankSize;
+	Mapper->Switches++;
+}
+
+// Slow path of ReadByte and of opcode fetches for PAGE_BANK pages. Reads have no side
+// effects, so the host can use it to look at banked memory too.
+byte MapperRead(const struct memory* mem, const word Address)
+{
+	const struct mapper* Mapper = mem->Mapper;
+	const int Slot = Mapper->PageSlot[Address >> 8];
+	if (!Slot)
+	{
+		return mem->Data[Address];
+	}
+	const struct mapper_slot* s = &Mapper->Slots[Slot - 1];
+	return s->Data[Address - s->Base];
+}
+
+// Slow path of WriteByte for PAGE_BANK pages. Returns false if the write is left to Data, the
+// rest of the bank register's page when that lies outside the window.
+bool MapperWrite(struct memory* mem, const word Address, const byte Data)
+{
+	struct mapper* Mapper = mem->Mapper;
+	const int Slot = Mapper->PageSlot[Address >> 8];
+	switch (Mapper->Type)
+	{
+	case MAPPER_UXROM:
+	{
+		SwitchBank(Mapper, 0, Data);
+		return true;
+	}
+	case MAPPER_AXROM:
+	{
+		SwitchBank(Mapper, 0, Data & 7);
+		return true;
+	}
+	default:
+	{
+	} break;
+	}
+
+	if (Address == Mapper->Register)
+	{
+		SwitchBank(Mapper, 0, Data);
+		return true;
+	}
+	if (Slot && Mapper->Writable)
+	{
+		struct mapper_slot* s = &Mapper->Slots[Slot - 1];
+		const size_t Offset = s->Data - Mapper->Banks + (Address - s->Base);
+		Mapper->BankHash ^= HashBankByte(Offset, Mapper->Banks[Offset]) ^ HashBankByte(Offset, Data);
+		Mapper->Banks[Offset] = Data;
+	}
+	return Slot != 0;			// ROM ignores stores
+}
+
+// What the CPU sees at every address: Data with the selected banks over their slots
+void MapperView(const struct memory* mem, byte* View)
+{
+	memcpy(View, mem->Data, MAX_MEM);
+	for (int i = 0; mem->Mapper && i < mem->Mapper->NumSlots; i++)
+	{
+		const struct mapper_slot* s = &mem->Mapper->Slots[i];
+		memcpy(View + s->Base, s->Data, s->Size);
+	}
+}
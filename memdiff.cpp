@@ -0,0 +1,243 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>			// before 6502.h, like the standard headers
+#define SIMD_X86
+#endif
+#include "6502.h"
+
+#define PATCH_MAGIC "H6DP"
+#define PATCH_VERSION 1
+#define PATCH_RECORD_HEADER 3		// address, length - 1
+
+// Sets bit i of Mask[i / 64] if byte i of the two pages differs
+typedef void (*PageMaskFunction)(const byte*, const byte*, uint64_t*);
+
+
+static void PageMaskScalar(const byte* a, const byte* b, uint64_t* Mask)
+{
+	memset(Mask, 0, 4 * sizeof(uint64_t));
+	for (int i = 0; i < PAGE_SIZE; i += 8)
+	{
+		uint64_t x;
+		uint64_t y;
+		memcpy(&x, a + i, 8);
+		memcpy(&y, b + i, 8);
+		if (x == y)
+		{
+			continue;
+		}
+		for (int j = i; j < i + 8; j++)
+		{
+			if (a[j] != b[j])
+			{
+				Mask[j >> 6] |= 1ull << (j & 63);
+			}
+		}
+	}
+}
+
+#ifdef SIMD_X86
+__attribute__((target("sse2"))) static void PageMaskSse2(const byte* a, const byte* b, uint64_t* Mask)
+{
+	for (int Word = 0; Word < 4; Word++)
+	{
+		uint64_t Equal = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			const __m128i x = _mm_loadu_si128((const __m128i*)(a + Word * 64 + i * 16));
+			const __m128i y = _mm_loadu_si128((const __m128i*)(b + Word * 64 + i * 16));
+			Equal |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) << (i * 16);
+		}
+		Mask[Word] = ~Equal;
+	}
+}
+
+__attribute__((target("avx2"))) static void PageMaskAvx2(const byte* a, const byte* b, uint64_t* Mask)
+{
+	for (int Word = 0; Word < 4; Word++)
+	{
+		const __m256i x0 = _mm256_loadu_si256((const __m256i*)(a + Word * 64));
+		const __m256i y0 = _mm256_loadu_si256((const __m256i*)(b + Word * 64));
+		const __m256i x1 = _mm256_loadu_si256((const __m256i*)(a + Word * 64 + 32));
+		const __m256i y1 = _mm256_loadu_si256((const __m256i*)(b + Word * 64 + 32));
+		const uint64_t Low = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x0, y0));
+		const uint64_t High = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x1, y1));
+		Mask[Word] = ~(Low | High << 32);
+	}
+}
+#endif
+
+static PageMaskFunction PageMask()
+{
+#ifdef SIMD_X86
+	const int Level = SimdLevel();
+	if (Level == SIMD_AVX2)
+	{
+		return PageMaskAvx2;
+	}
+	if (Level == SIMD_SSE2)
+	{
+		return PageMaskSse2;
+	}
+#endif
+	return PageMaskScalar;
+}
+
+// First bit at or after Bit that is set in Mask (or clear, if Set is false), 256 if none
+static int NextBit(const uint64_t* Mask, int Bit, const bool Set)
+{
+	while (Bit < PAGE_SIZE)
+	{
+		const uint64_t Word = (Set ? Mask[Bit >> 6] : ~Mask[Bit >> 6]) >> (Bit & 63);
+		if (Word & 1)
+		{
+			return Bit;
+		}
+		Bit = Word ? Bit + 1 : (Bit | 63) + 1;
+	}
+	return PAGE_SIZE;
+}
+
+// Diff->Ranges lists the bytes where To differs from From, in address order. False, with an
+// empty diff, if either has a mapper.
+bool DiffMemory(const struct memory* From, const struct memory* To, struct memory_diff* Diff)
+{
+	const PageMaskFunction Compare = PageMask();
+	Diff->Bytes = 0;
+	Diff->NumRanges = 0;
+	if (From->Mapper || To->Mapper)
+	{
+		memset(Diff->PageStart, 0, sizeof(Diff->PageStart));
+		return false;
+	}
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		uint64_t Mask[4];
+		Diff->PageStart[Page] = Diff->NumRanges;
+		Compare(&From->Data[Page << 8], &To->Data[Page << 8], Mask);
+		if (!(Mask[0] | Mask[1] | Mask[2] | Mask[3]))
+		{
+			continue;
+		}
+
+		for (int Start = NextBit(Mask, 0, true); Start < PAGE_SIZE; )
+		{
+			const int End = NextBit(Mask, Start, false);
+			struct memory_range* Range = &Diff->Ranges[Diff->NumRanges++];
+			Range->Address = Page << 8 | Start;
+			Range->Length = End - Start;
+			Diff->Bytes += End - Start;
+			Start = NextBit(Mask, End, true);
+		}
+	}
+	Diff->PageStart[NUM_PAGES] = Diff->NumRanges;
+	return true;
+}
+
+// "H6DP", version, the register block of To (laid out like in a save state), then one record
+// per run of changed bytes: address, length - 1 and the new bytes. Ranges of a page no more than
+// a record header apart share a record. Returns the size, 0 if Capacity is too small or To has
+// a mapper.
+size_t MakePatch(const struct memory_diff* Diff, const struct CPU* cpu, const struct memory* To, byte* Buffer, const size_t Capacity)
+{
+	size_t o = 0;
+	if (Capacity < 32 || To->Mapper)
+	{
+		return 0;
+	}
+
+	memcpy(Buffer, PATCH_MAGIC, 4);
+	Buffer[4] = PATCH_VERSION;
+	o = 5;
+	Buffer[o++] = cpu->pc & 0xFF;
+	Buffer[o++] = cpu->pc >> 8;
+	Buffer[o++] = cpu->sp;
+	Buffer[o++] = cpu->acc;
+	Buffer[o++] = cpu->x;
+	Buffer[o++] = cpu->y;
+	Buffer[o++] = sizeof(cpu->Flags);
+	memcpy(Buffer + o, cpu->Flags, sizeof(cpu->Flags));
+	o += sizeof(cpu->Flags);
+	for (int i = 0; i < 8; i++)
+	{
+		Buffer[o++] = (To->Clock >> (i * 8)) & 0xFF;
+	}
+	Buffer[o++] = To->IrqLines;
+	Buffer[o++] = To->NmiPending;
+
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		for (int i = Diff->PageStart[Page]; i < Diff->PageStart[Page + 1]; )
+		{
+			const word Start = Diff->Ranges[i].Address;
+			int End = Start + Diff->Ranges[i].Length;
+			for (i++; i < Diff->PageStart[Page + 1] && Diff->Ranges[i].Address - End <= PATCH_RECORD_HEADER; i++)
+			{
+				End = Diff->Ranges[i].Address + Diff->Ranges[i].Length;
+			}
+
+			const int Length = End - Start;
+			if (o + PATCH_RECORD_HEADER + Length > Capacity)
+			{
+				return 0;
+			}
+			Buffer[o++] = Start & 0xFF;
+			Buffer[o++] = Start >> 8;
+			Buffer[o++] = (byte)(Length - 1);
+			memcpy(Buffer + o, &To->Data[Start], Length);
+			o += Length;
+		}
+	}
+	return o;
+}
+
+// Turns the instance the patch was made from into the one it was made against. The patch is
+// checked as a whole first, a broken one changes nothing. Bytes are stored with StoreByte(),
+// so undo pages and the memory hash stay valid. Refused if mem has a mapper.
+bool ApplyPatch(struct CPU* cpu, struct memory* mem, const byte* Patch, const size_t Size)
+{
+	const size_t Registers = 5 + 7 + sizeof(cpu->Flags) + 10;
+	if (mem->Mapper || Size < Registers || memcmp(Patch, PATCH_MAGIC, 4) || Patch[4] != PATCH_VERSION || Patch[11] != sizeof(cpu->Flags))
+	{
+		return false;
+	}
+	size_t o = Registers;
+	while (o < Size)
+	{
+		if (o + PATCH_RECORD_HEADER > Size || o + PATCH_RECORD_HEADER + Patch[o + 2] + 1 > Size)
+		{
+			return false;
+		}
+		o += PATCH_RECORD_HEADER + Patch[o + 2] + 1;
+	}
+
+	o = 5;
+	cpu->pc = Patch[o] | (Patch[o + 1] << 8);
+	o += 2;
+	cpu->sp = Patch[o++];
+	cpu->acc = Patch[o++];
+	cpu->x = Patch[o++];
+	cpu->y = Patch[o++];
+	o++;
+	memcpy(cpu->Flags, Patch + o, sizeof(cpu->Flags));
+	o += sizeof(cpu->Flags);
+	mem->Clock = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		mem->Clock |= (uint64_t)Patch[o++] << (i * 8);
+	}
+	mem->IrqLines = Patch[o++];
+	mem->NmiPending = Patch[o++];
+
+	while (o < Size)
+	{
+		const word Address = Patch[o] | (Patch[o + 1] << 8);
+		const int Length = Patch[o + 2] + 1;
+		o += PATCH_RECORD_HEADER;
+		for (int i = 0; i < Length; i++)
+		{
+			StoreByte(mem, Address + i, Patch[o + i]);
+		}
+		o += Length;
+	}
+	return true;
+}
@@ -0,0 +1,306 @@
+#include "6502.h"
+
+
+static void SetLearnFlags(struct memory* mem, const bool Learning)
+{
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		if (Learning)
+		{
+			mem->PageFlags[Page] |= PAGE_LEARN;
+		}
+		else
+		{
+			mem->PageFlags[Page] &= ~PAGE_LEARN;
+		}
+	}
+}
+
+static struct memo_routine* FindRoutine(struct memo* Memo, const word Address)
+{
+	for (int i = 0; i < MEMO_ROUTINES; i++)
+	{
+		if (Memo->Routines[i].Used && Memo->Routines[i].Address == Address)
+		{
+			return &Memo->Routines[i];
+		}
+	}
+	return NULL;
+}
+
+static bool SameInputs(const struct CPU* cpu1, const struct CPU* cpu2)
+{
+	return cpu1->acc == cpu2->acc
+		&& cpu1->x == cpu2->x
+		&& cpu1->y == cpu2->y
+		&& cpu1->sp == cpu2->sp
+		&& !memcmp(cpu1->Flags, cpu2->Flags, sizeof(cpu1->Flags));
+}
+
+static bool PlainPage(const struct memory* mem, const word Address)
+{
+	return !(mem->PageFlags[Address >> 8] & (PAGE_IO | PAGE_WATCH | PAGE_BANK));
+}
+
+static void DisableLearning(struct memory* mem)
+{
+	mem->Memo->Routines[mem->Memo->Learning].Disabled = true;
+	StopLearning(mem);
+}
+
+static void RecordInput(struct memory* mem, const word Address)
+{
+	struct memo_entry* Entry = &mem->Memo->Scratch;
+	for (int i = 0; i < Entry->NumWrites; i++)
+	{
+		if (Entry->Writes[i].Address == Address)
+		{
+			return;		// produced by the call itself
+		}
+	}
+	for (int i = 0; i < Entry->NumReads; i++)
+	{
+		if (Entry->Reads[i].Address == Address)
+		{
+			return;
+		}
+	}
+	if (Entry->NumReads == MEMO_READS)
+	{
+		DisableLearning(mem);
+		return;
+	}
+	Entry->Reads[Entry->NumReads].Address = Address;
+	Entry->Reads[Entry->NumReads].Value = mem->Data[Address];
+	Entry->NumReads++;
+}
+
+void AttachMemo(struct memo* Memo, struct memory* mem)
+{
+	memset(Memo, 0, sizeof(*Memo));
+	Memo->Learning = -1;
+	mem->Memo = Memo;
+}
+
+void DetachMemo(struct memory* mem)
+{
+	if (!mem->Memo)
+	{
+		return;
+	}
+	StopLearning(mem);
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		mem->PageFlags[Page] &= ~PAGE_MEMO;
+	}
+	mem->Memo = NULL;
+}
+
+// Opts the subroutine at Address in. It has to be a function of A/X/Y, the flags, the stack
+// pointer and memory: calls that touch a device are never cached. Returns the slot, -1 if
+// no memo is attached or the table is full.
+int MemoizeRoutine(struct memory* mem, const word Address)
+{
+	if (!mem->Memo)
+	{
+		return -1;
+	}
+
+	int Slot = -1;
+	for (int i = 0; i < MEMO_ROUTINES; i++)
+	{
+		if (mem->Memo->Routines[i].Used && mem->Memo->Routines[i].Address == Address)
+		{
+			return i;
+		}
+		if (!mem->Memo->Routines[i].Used && Slot < 0)
+		{
+			Slot = i;
+		}
+	}
+	if (Slot < 0)
+	{
+		return -1;
+	}
+
+	memset(&mem->Memo->Routines[Slot], 0, sizeof(mem->Memo->Routines[Slot]));
+	mem->Memo->Routines[Slot].Address = Address;
+	mem->Memo->Routines[Slot].Used = true;
+	mem->PageFlags[Address >> 8] |= PAGE_MEMO;
+	return Slot;
+}
+
+static bool ReplayEntry(struct CPU* cpu, struct memory* mem, const struct memo_entry* Entry, size_t* Cycles)
+{
+	const word Stack = SPtoWord(cpu);
+	if (!PlainPage(mem, Stack - 1) || !PlainPage(mem, Stack))
+	{
+		return false;
+	}
+	for (int i = 0; i < Entry->NumWrites; i++)
+	{
+		if (!PlainPage(mem, Entry->Writes[i].Address))
+		{
+			return false;
+		}
+	}
+
+	StoreByte(mem, Stack - 1, (cpu->pc - 1) & 0xFF);	// what the JSR pushes
+	StoreByte(mem, Stack, (cpu->pc - 1) >> 8);
+	for (int i = 0; i < Entry->NumWrites; i++)
+	{
+		StoreByte(mem, Entry->Writes[i].Address, Entry->Writes[i].Value);
+	}
+
+	cpu->acc = Entry->Out.acc;
+	cpu->x = Entry->Out.x;
+	cpu->y = Entry->Out.y;
+	cpu->sp = Entry->Out.sp;
+	memcpy(cpu->Flags, Entry->Out.Flags, sizeof(cpu->Flags));
+
+	const word Return = SPtoWord(cpu) + 1;		// and the final RTS pulls
+	cpu->pc = (mem->Data[Return] | (mem->Data[(word)(Return + 1)] << 8)) + 1;
+	cpu->sp += 2;
+
+	*Cycles -= Entry->Cycles - 3;			// the JSR opcode and target are already paid
+	mem->Instructions += Entry->Instructions - 1;
+	return true;
+}
+
+// Called by JSR once the target is fetched, only for pages with PAGE_MEMO set. On a hit
+// the whole call is replayed; on a miss the call is started here and recorded until the
+// RTS that returns from it. Returns false if JSR has to run normally.
+bool RunMemo(struct CPU* cpu, struct memory* mem, const word Address, size_t* Cycles)
+{
+	struct memo* Memo = mem->Memo;
+	if (!Memo || Memo->Learning >= 0 || (mem->PageFlags[Address >> 8] & PAGE_BANK))
+	{
+		return false;
+	}
+	struct memo_routine* Routine = FindRoutine(Memo, Address);
+	if (!Routine || Routine->Disabled)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < MEMO_ENTRIES; i++)
+	{
+		const struct memo_entry* Entry = &Routine->Entries[i];
+		if (!Entry->Valid || !SameInputs(&Entry->In, cpu))
+		{
+			continue;
+		}
+
+		int Read = 0;
+		while (Read < Entry->NumReads
+			&& PlainPage(mem, Entry->Reads[Read].Address)
+			&& mem->Data[Entry->Reads[Read].Address] == Entry->Reads[Read].Value)
+		{
+			Read++;
+		}
+		if (Read == Entry->NumReads && ReplayEntry(cpu, mem, Entry, Cycles))
+		{
+			Memo->Hits++;
+			return true;
+		}
+	}
+
+	Memo->Misses++;
+	Memo->Scratch.NumReads = 0;
+	Memo->Scratch.NumWrites = 0;
+	Memo->Scratch.In = *cpu;
+	Memo->LearnStart = mem->Clock - *Cycles - 3;
+	Memo->LearnInstructions = mem->Instructions - 1;
+
+	pushPCToStack(cpu, mem, Cycles);
+	cpu->pc = Address;
+	(*Cycles)--;
+
+	Memo->Learning = Routine - Memo->Routines;
+	SetLearnFlags(mem, true);
+	return true;
+}
+
+// Called by RTS before it pulls the return address while a call is being recorded
+void FinishMemo(struct CPU* cpu, struct memory* mem, const size_t Cycles)
+{
+	struct memo* Memo = mem->Memo;
+	if (cpu->sp != (byte)(Memo->Scratch.In.sp - 2))
+	{
+		return;		// a nested subroutine returns
+	}
+
+	struct memo_routine* Routine = &Memo->Routines[Memo->Learning];
+	struct memo_entry* Entry = &Routine->Entries[Routine->Next];
+
+	Memo->Scratch.Valid = true;
+	Memo->Scratch.Out = *cpu;
+	Memo->Scratch.Cycles = mem->Clock - Cycles + 5 - Memo->LearnStart;
+	Memo->Scratch.Instructions = mem->Instructions - Memo->LearnInstructions;
+	*Entry = Memo->Scratch;
+	Routine->Next = (Routine->Next + 1) % MEMO_ENTRIES;
+	StopLearning(mem);
+}
+
+// Drops the call being recorded, Execute() calls this at every slice boundary since events
+// and interrupts change memory behind the call's back
+void StopLearning(struct memory* mem)
+{
+	if (mem->Memo && mem->Memo->Learning >= 0)
+	{
+		mem->Memo->Learning = -1;
+		SetLearnFlags(mem, false);
+	}
+}
+
+// Slow path hooks while a call is recorded, reads made before the call writes a byte are
+// its inputs
+void MemoRecordRead(struct memory* mem, const word Address)
+{
+	if (mem->PageFlags[Address >> 8] & (PAGE_IO | PAGE_BANK))
+	{
+		DisableLearning(mem);
+		return;
+	}
+	RecordInput(mem, Address);
+}
+
+void MemoRecordFetch(struct memory* mem, const word Address)
+{
+	if (mem->PageFlags[Address >> 8] & PAGE_BANK)
+	{
+		DisableLearning(mem);		// the code isn't in Data, it can't be compared later
+		return;
+	}
+	for (int i = 0; i < 3 && mem->Memo->Learning >= 0; i++)	// operands of the longest instruction
+	{
+		RecordInput(mem, Address + i);
+	}
+}
+
+void MemoRecordWrite(struct memory* mem, const word Address, const byte Data)
+{
+	struct memo_entry* Entry = &mem->Memo->Scratch;
+	if (mem->PageFlags[Address >> 8] & (PAGE_IO | PAGE_BANK))
+	{
+		DisableLearning(mem);
+		return;
+	}
+
+	for (int i = 0; i < Entry->NumWrites; i++)
+	{
+		if (Entry->Writes[i].Address == Address)
+		{
+			Entry->Writes[i].Value = Data;
+			return;
+		}
+	}
+	if (Entry->NumWrites == MEMO_WRITES)
+	{
+		DisableLearning(mem);
+		return;
+	}
+	Entry->Writes[Entry->NumWrites].Address = Address;
+	Entry->Writes[Entry->NumWrites].Value = Data;
+	Entry->NumWrites++;
+}
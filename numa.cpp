@@ -0,0 +1,121 @@
+#include "6502.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#define NUMA_MPOL_PREFERRED 1		// from <numaif.h>, which would drag in libnuma
+
+
+// "0-3,8,10-11" as found in /sys/devices/system/node/node*/cpulist
+static int ParseCpuList(FILE* File, int* Cpus)
+{
+	int Count = 0;
+	int First;
+	while (fscanf(File, "%d", &First) == 1)
+	{
+		int Last = First;
+		int c = getc(File);
+		if (c == '-')
+		{
+			if (fscanf(File, "%d", &Last) != 1)
+			{
+				break;
+			}
+			c = getc(File);
+		}
+		for (int Cpu = First; Cpu <= Last && Count < NUMA_MAX_CPUS; Cpu++)
+		{
+			Cpus[Count++] = Cpu;
+		}
+		if (c != ',')
+		{
+			break;
+		}
+	}
+	return Count;
+}
+
+// Nodes without CPUs (memory only) are left out. Falls back to one node holding every online
+// CPU where sysfs isn't there.
+void ReadNumaTopology(struct numa_topology* Topology)
+{
+	memset(Topology, 0, sizeof(*Topology));
+#ifdef __linux__
+	for (int Node = 0; Node < 64 && Topology->NumNodes < NUMA_MAX_NODES; Node++)
+	{
+		char Path[64];
+		snprintf(Path, sizeof(Path), "/sys/devices/system/node/node%d/cpulist", Node);
+		FILE* File = fopen(Path, "r");
+		if (!File)
+		{
+			continue;
+		}
+		const int i = Topology->NumNodes;
+		Topology->NumCpus[i] = ParseCpuList(File, Topology->Cpus[i]);
+		fclose(File);
+		if (Topology->NumCpus[i])
+		{
+			Topology->NodeId[i] = Node;
+			Topology->NumNodes++;
+		}
+	}
+	if (Topology->NumNodes)
+	{
+		return;
+	}
+	const long Online = sysconf(_SC_NPROCESSORS_ONLN);
+	Topology->NumCpus[0] = Online < 1 ? 1 : Online > NUMA_MAX_CPUS ? NUMA_MAX_CPUS : (int)Online;
+#else
+	Topology->NumCpus[0] = 1;
+#endif
+	Topology->NumNodes = 1;
+	for (int i = 0; i < Topology->NumCpus[0]; i++)
+	{
+		Topology->Cpus[0][i] = i;
+	}
+}
+
+// Index into the topology of the node a worker belongs to, workers are dealt round robin
+int WorkerNode(const struct numa_topology* Topology, const int Worker)
+{
+	return Worker % Topology->NumNodes;
+}
+
+// Pins the calling thread to a core of its worker's node, one core per worker until a node
+// runs out. False, and nothing changed, on a single node.
+bool PinWorker(const struct numa_topology* Topology, const int Worker)
+{
+#ifdef __linux__
+	if (Topology->NumNodes < 2)
+	{
+		return false;
+	}
+	const int Node = WorkerNode(Topology, Worker);
+	cpu_set_t Set;
+	CPU_ZERO(&Set);
+	CPU_SET(Topology->Cpus[Node][(Worker / Topology->NumNodes) % Topology->NumCpus[Node]], &Set);
+	return !sched_setaffinity(0, sizeof(Set), &Set);
+#else
+	return false;
+#endif
+}
+
+// Asks the kernel to place the pages of a fresh mapping on Node (a kernel node number),
+// before they're touched. Preferred rather than strict, a full node spills over instead of
+// failing. False if nothing was done.
+bool BindToNode(void* Address, const size_t Size, const int Node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	if (Node < 0 || Node >= 64)
+	{
+		return false;
+	}
+	const unsigned long Mask = 1ul << Node;
+	return !syscall(SYS_mbind, Address, Size, NUMA_MPOL_PREFERRED, &Mask, sizeof(Mask) * 8 + 1, 0);	// the kernel drops the last bit
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,131 @@
+#include "6502.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+// Explicit huge pages first (MAP_HUGETLB needs pages reserved by the admin), otherwise
+// normal pages at 2 MiB alignment so transparent huge pages can back them
+static byte* MapArena(const size_t Size, bool* Huge)
+{
+	*Huge = false;
+#ifdef _WIN32
+	byte* Arena = (byte*)_aligned_malloc(Size, POOL_HUGE_PAGE);
+	if (Arena)
+	{
+		memset(Arena, 0, Size);			// fresh slots are zero like they are from mmap()
+	}
+	return Arena;
+#else
+#ifdef MAP_HUGETLB
+	void* Mapping = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (Mapping != MAP_FAILED)
+	{
+		*Huge = true;
+		return (byte*)Mapping;
+	}
+#endif
+	byte* Raw = (byte*)mmap(NULL, Size + POOL_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (Raw == (byte*)MAP_FAILED)
+	{
+		return NULL;
+	}
+	byte* Arena = (byte*)(((uintptr_t)Raw + POOL_HUGE_PAGE - 1) & ~(uintptr_t)(POOL_HUGE_PAGE - 1));
+	if (Arena > Raw)
+	{
+		munmap(Raw, Arena - Raw);
+	}
+	if (Raw + POOL_HUGE_PAGE > Arena)
+	{
+		munmap(Arena + Size, Raw + POOL_HUGE_PAGE - Arena);
+	}
+#ifdef MADV_HUGEPAGE
+	madvise(Arena, Size, MADV_HUGEPAGE);
+#endif
+	return Arena;
+#endif
+}
+
+static void UnmapArena(byte* Arena, const size_t Size)
+{
+#ifdef _WIN32
+	_aligned_free(Arena);
+#else
+	munmap(Arena, Size);
+#endif
+}
+
+// ArenaSize is rounded up to whole huge pages, 0 takes POOL_ARENA_SIZE. Nothing is mapped
+// until the first AllocInstance(). Set Node afterwards to bind the arenas to a NUMA node.
+void InitInstancePool(struct instance_pool* Pool, const size_t ArenaSize)
+{
+	memset(Pool, 0, sizeof(*Pool));
+	Pool->Node = -1;
+	Pool->SlotSize = (sizeof(struct instance) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+	Pool->ArenaSize = ArenaSize ? ArenaSize : POOL_ARENA_SIZE;
+	Pool->ArenaSize = (Pool->ArenaSize + POOL_HUGE_PAGE - 1) & ~(size_t)(POOL_HUGE_PAGE - 1);
+	if (Pool->ArenaSize < Pool->SlotSize)
+	{
+		Pool->ArenaSize = (Pool->SlotSize + POOL_HUGE_PAGE - 1) & ~(size_t)(POOL_HUGE_PAGE - 1);
+	}
+}
+
+// O(1): the most recently freed slot, else the next fresh one, else a new arena. The contents
+// are whatever the slot's last user left (all zero for a fresh one), so callers ResetCpu() or
+// copy a state in. NULL once POOL_MAX_ARENAS are in use or the host is out of memory.
+struct instance* AllocInstance(struct instance_pool* Pool)
+{
+	struct instance* Instance = Pool->FreeList;
+	if (Instance)
+	{
+		memcpy(&Pool->FreeList, &Instance->cpu, sizeof(Pool->FreeList));
+		Pool->Live++;
+		return Instance;
+	}
+
+	if (Pool->Bump + Pool->SlotSize > Pool->BumpEnd || !Pool->Bump)
+	{
+		bool Huge;
+		byte* Arena = Pool->NumArenas < POOL_MAX_ARENAS ? MapArena(Pool->ArenaSize, &Huge) : NULL;
+		if (!Arena)
+		{
+			return NULL;
+		}
+		if (Pool->Node >= 0)
+		{
+			BindToNode(Arena, Pool->ArenaSize, Pool->Node);
+		}
+		Pool->Arenas[Pool->NumArenas++] = Arena;
+		Pool->HugeArenas += Huge;
+		Pool->Bump = Arena;
+		Pool->BumpEnd = Arena + Pool->ArenaSize;
+	}
+
+	Instance = (struct instance*)Pool->Bump;
+	Pool->Bump += Pool->SlotSize;
+	Pool->Live++;
+	return Instance;
+}
+
+// O(1), the slot goes on the free list. Arenas are only returned by DestroyInstancePool().
+void FreeInstance(struct instance_pool* Pool, struct instance* Instance)
+{
+	memcpy(&Instance->cpu, &Pool->FreeList, sizeof(Pool->FreeList));
+	Pool->FreeList = Instance;
+	Pool->Live--;
+}
+
+// Every instance of the pool is gone afterwards, the pool can be used again
+void DestroyInstancePool(struct instance_pool* Pool)
+{
+	const int Node = Pool->Node;
+	for (int i = 0; i < Pool->NumArenas; i++)
+	{
+		UnmapArena(Pool->Arenas[i], Pool->ArenaSize);
+	}
+	InitInstancePool(Pool, Pool->ArenaSize);
+	Pool->Node = Node;
+}
@@ -0,0 +1,220 @@
+#include "6502.h"
+
+#define RECORDER_MAGIC "H6RL"
+#define RECORDER_VERSION 1
+
+
+static void PutVarint(FILE* Stream, uint64_t Value)
+{
+	while (Value >= 0x80)
+	{
+		putc((Value & 0x7F) | 0x80, Stream);
+		Value >>= 7;
+	}
+	putc((int)Value, Stream);
+}
+
+static bool GetVarint(FILE* Stream, uint64_t* Value)
+{
+	*Value = 0;
+	for (int Shift = 0; Shift < 64; Shift += 7)
+	{
+		const int c = getc(Stream);
+		if (c == EOF)
+		{
+			return false;
+		}
+		*Value |= (uint64_t)(c & 0x7F) << Shift;
+		if (!(c & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static void PutRecord(struct recorder* Recorder, const byte Type, const uint64_t Cycle, const word Address, const byte Value)
+{
+	putc(Type, Recorder->Stream);
+	PutVarint(Recorder->Stream, Cycle - Recorder->LastCycle);
+	Recorder->LastCycle = Cycle;
+
+	switch (Type)
+	{
+	case INPUT_READ:
+	case INPUT_IRQ:
+	{
+		putc(Value, Recorder->Stream);
+	} break;
+	case INPUT_WRITE:
+	{
+		putc(Address & 0xFF, Recorder->Stream);
+		putc(Address >> 8, Recorder->Stream);
+		putc(Value, Recorder->Stream);
+	} break;
+	}
+}
+
+static void LoadNextRecord(struct recorder* Recorder)
+{
+	struct input* Next = &Recorder->Next;
+	uint64_t Delta;
+	const int Type = getc(Recorder->Stream);
+
+	Recorder->HasNext = false;
+	if (Type == EOF || !GetVarint(Recorder->Stream, &Delta))
+	{
+		return;
+	}
+
+	Next->Type = Type;
+	Next->Cycle = Recorder->LastCycle + Delta;
+	Next->Address = 0;
+	Next->Value = 0;
+	Recorder->LastCycle = Next->Cycle;
+
+	switch (Type)
+	{
+	case INPUT_READ:
+	case INPUT_IRQ:
+	{
+		Next->Value = getc(Recorder->Stream);
+	} break;
+	case INPUT_WRITE:
+	{
+		Next->Address = getc(Recorder->Stream);
+		Next->Address |= getc(Recorder->Stream) << 8;
+		Next->Value = getc(Recorder->Stream);
+	} break;
+	}
+	Recorder->HasNext = !feof(Recorder->Stream);
+}
+
+bool StartRecording(struct recorder* Recorder, struct memory* mem, FILE* Stream)
+{
+	memset(Recorder, 0, sizeof(*Recorder));
+	Recorder->Stream = Stream;
+	Recorder->LastCycle = mem->Clock;
+	Recorder->LastIrqLines = mem->IrqLines;
+
+	fwrite(RECORDER_MAGIC, 1, 4, Stream);
+	putc(RECORDER_VERSION, Stream);
+	for (int i = 0; i < 8; i++)
+	{
+		putc((mem->Clock >> (i * 8)) & 0xFF, Stream);
+	}
+
+	mem->Recorder = Recorder;
+	return !ferror(Stream);
+}
+
+// The host restores the state the recording started from, Execute() then reproduces the
+// session without touching the devices and without any wall-clock pacing
+bool StartReplay(struct recorder* Recorder, struct memory* mem, FILE* Stream)
+{
+	char Magic[4];
+	memset(Recorder, 0, sizeof(*Recorder));
+	Recorder->Stream = Stream;
+	Recorder->Replaying = true;
+
+	if (fread(Magic, 1, 4, Stream) != 4 || memcmp(Magic, RECORDER_MAGIC, 4) || getc(Stream) != RECORDER_VERSION)
+	{
+		return false;
+	}
+	for (int i = 0; i < 8; i++)
+	{
+		const int c = getc(Stream);
+		if (c == EOF)
+		{
+			return false;
+		}
+		Recorder->LastCycle |= (uint64_t)c << (i * 8);
+	}
+
+	mem->Clock = Recorder->LastCycle;
+	mem->Recorder = Recorder;
+	LoadNextRecord(Recorder);
+	return true;
+}
+
+void StopRecorder(struct memory* mem)
+{
+	if (mem->Recorder && !mem->Recorder->Replaying)
+	{
+		fflush(mem->Recorder->Stream);
+	}
+	mem->Recorder = NULL;
+}
+
+// Host-side memory poke between Execute() calls, logged so that replays see it at the same cycle
+void InjectWrite(struct memory* mem, const word Address, const byte Value)
+{
+	if (mem->Recorder && mem->Recorder->Replaying)
+	{
+		return;
+	}
+	if (mem->Recorder)
+	{
+		PutRecord(mem->Recorder, INPUT_WRITE, mem->Clock, Address, Value);
+	}
+	StoreByte(mem, Address, Value);
+}
+
+void RecorderRecordRead(struct memory* mem, const byte Data, const uint64_t Now)
+{
+	PutRecord(mem->Recorder, INPUT_READ, Now, 0, Data);
+}
+
+byte RecorderReplayRead(struct memory* mem, const word Address)
+{
+	struct recorder* Recorder = mem->Recorder;
+	if (!Recorder->HasNext || Recorder->Next.Type != INPUT_READ)
+	{
+		return mem->Data[Address];	// the guest diverged from the recording
+	}
+
+	const byte Data = Recorder->Next.Value;
+	LoadNextRecord(Recorder);
+	return Data;
+}
+
+// Slice boundary hook, returns the cycle of the next record the dispatch loop has to stop at
+uint64_t RecorderTick(struct memory* mem, const uint64_t Now)
+{
+	struct recorder* Recorder = mem->Recorder;
+
+	if (!Recorder->Replaying)
+	{
+		if (mem->IrqLines != Recorder->LastIrqLines)
+		{
+			PutRecord(Recorder, INPUT_IRQ, Now, 0, mem->IrqLines);
+			Recorder->LastIrqLines = mem->IrqLines;
+		}
+		if (mem->NmiPending)
+		{
+			PutRecord(Recorder, INPUT_NMI, Now, 0, 0);
+		}
+		return NO_EVENT;
+	}
+
+	while (Recorder->HasNext && Recorder->Next.Type != INPUT_READ && Recorder->Next.Cycle <= Now)
+	{
+		switch (Recorder->Next.Type)
+		{
+		case INPUT_IRQ:
+		{
+			mem->IrqLines = Recorder->Next.Value;
+		} break;
+		case INPUT_NMI:
+		{
+			mem->NmiPending = 1;
+		} break;
+		case INPUT_WRITE:
+		{
+			StoreByte(mem, Recorder->Next.Address, Recorder->Next.Value);
+		} break;
+		}
+		LoadNextRecord(Recorder);
+	}
+	return Recorder->HasNext && Recorder->Next.Cycle > Now ? Recorder->Next.Cycle : NO_EVENT;
+}
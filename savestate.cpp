@@ -0,0 +1,394 @@
+#include "6502.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SAVESTATE_MAGIC "H6SS"
+#define SAVESTATE_COMPRESSED 0x0001
+
+enum PAGE_RECORD
+{
+	RECORD_ZERO = 0,			// page is all zero, no payload
+	RECORD_RAW,				// 256 bytes follow
+	RECORD_LZ				// 16-bit length followed by LZ tokens
+};
+
+
+static void PutWord(byte* Out, const word Value)
+{
+	Out[0] = Value & 0xFF;
+	Out[1] = Value >> 8;
+}
+
+static word GetWord(const byte* In)
+{
+	return In[0] | (In[1] << 8);
+}
+
+static bool IsZeroPage(const byte* Page)
+{
+	static const byte Zero[PAGE_SIZE] = { 0 };
+	return !memcmp(Page, Zero, PAGE_SIZE);
+}
+
+static size_t PutLiterals(byte* Out, const byte* In, size_t Count)
+{
+	size_t o = 0;
+	while (Count)
+	{
+		const size_t Run = Count > 128 ? 128 : Count;
+		Out[o++] = (byte)(Run - 1);
+		memcpy(Out + o, In, Run);
+		o += Run;
+		In += Run;
+		Count -= Run;
+	}
+	return o;
+}
+
+// LZ77 inside one page: 0x00-0x7F = 1-128 literals follow, 0x80-0xFF = match of 3-130
+// bytes at the distance given by the next byte + 1. Returns 0 if the page doesn't shrink.
+static size_t CompressPage(const byte* In, byte* Out)
+{
+	int16_t Last[256];
+	size_t o = 0;
+	int Literal = 0;
+	int i = 0;
+
+	memset(Last, 0xFF, sizeof(Last));
+	while (i + 3 <= PAGE_SIZE)
+	{
+		const byte Hash = In[i] ^ (In[i + 1] << 3) ^ (In[i + 2] << 5) ^ (In[i + 2] >> 3);
+		const int Candidate = Last[Hash];
+		Last[Hash] = i;
+
+		if (Candidate >= 0 && !memcmp(In + Candidate, In + i, 3))
+		{
+			int Length = 3;
+			while (i + Length < PAGE_SIZE && Length < 130 && In[Candidate + Length] == In[i + Length])
+			{
+				Length++;
+			}
+
+			o += PutLiterals(Out + o, In + Literal, i - Literal);
+			Out[o++] = 0x80 | (Length - 3);
+			Out[o++] = (byte)(i - Candidate - 1);
+			if (o >= PAGE_SIZE)
+			{
+				return 0;
+			}
+
+			i += Length;
+			Literal = i;
+			continue;
+		}
+		i++;
+	}
+
+	o += PutLiterals(Out + o, In + Literal, PAGE_SIZE - Literal);
+	return o < PAGE_SIZE ? o : 0;
+}
+
+// Out can be NULL to only check In
+static bool DecompressPage(const byte* In, const size_t Size, byte* Out)
+{
+	size_t p = 0;
+	size_t o = 0;
+
+	while (p < Size)
+	{
+		const byte Token = In[p++];
+		if (Token & 0x80)
+		{
+			const size_t Length = (Token & 0x7F) + 3;
+			if (p >= Size)
+			{
+				return false;
+			}
+			const size_t Distance = In[p++] + 1;
+			if (Distance > o || o + Length > PAGE_SIZE)
+			{
+				return false;
+			}
+			for (size_t k = 0; Out && k < Length; k++)
+			{
+				Out[o + k] = Out[o + k - Distance];
+			}
+			o += Length;
+		}
+		else
+		{
+			const size_t Run = Token + 1;
+			if (p + Run > Size || o + Run > PAGE_SIZE)
+			{
+				return false;
+			}
+			if (Out)
+			{
+				memcpy(Out + o, In + p, Run);
+			}
+			p += Run;
+			o += Run;
+		}
+	}
+	return o == PAGE_SIZE;
+}
+
+// The page records starting at p, decoded into Data or only checked if Data is NULL
+static bool DecodePages(const byte* Buffer, const size_t Size, size_t p, byte* Data)
+{
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		byte* Out = Data ? &Data[Page << 8] : NULL;
+		if (p >= Size)
+		{
+			return false;
+		}
+
+		switch (Buffer[p++])
+		{
+		case RECORD_ZERO:
+		{
+			if (Out)
+			{
+				memset(Out, 0, PAGE_SIZE);
+			}
+		} break;
+		case RECORD_RAW:
+		{
+			if (p + PAGE_SIZE > Size)
+			{
+				return false;
+			}
+			if (Out)
+			{
+				memcpy(Out, Buffer + p, PAGE_SIZE);
+			}
+			p += PAGE_SIZE;
+		} break;
+		case RECORD_LZ:
+		{
+			if (p + 2 > Size)
+			{
+				return false;
+			}
+			const size_t Length = GetWord(Buffer + p);
+			if (p + 2 + Length > Size || !DecompressPage(Buffer + p + 2, Length, Out))
+			{
+				return false;
+			}
+			p += 2 + Length;
+		} break;
+		default:
+		{
+			return false;
+		}
+		}
+	}
+	return true;
+}
+
+// Buffer needs SAVESTATE_MAX_SIZE bytes in the worst case, returns 0 if it is too small
+size_t SaveState(const struct CPU* cpu, const struct memory* mem, byte* Buffer, const size_t Capacity, const bool Compress)
+{
+	byte Page[PAGE_SIZE + 256];
+	size_t o = 0;
+
+	if (Capacity < (Compress ? SAVESTATE_MAX_SIZE : 64 + MAX_MEM) || (mem->Mapper && mem->Mapper->Writable))
+	{
+		return 0;
+	}
+
+	memcpy(Buffer, SAVESTATE_MAGIC, 4);
+	PutWord(Buffer + 4, SAVESTATE_VERSION);
+	PutWord(Buffer + 6, Compress ? SAVESTATE_COMPRESSED : 0);
+	o = 10;
+
+	PutWord(Buffer + o, cpu->pc);
+	o += 2;
+	Buffer[o++] = cpu->sp;
+	Buffer[o++] = cpu->acc;
+	Buffer[o++] = cpu->x;
+	Buffer[o++] = cpu->y;
+	Buffer[o++] = sizeof(cpu->Flags);
+	memcpy(Buffer + o, cpu->Flags, sizeof(cpu->Flags));
+	o += sizeof(cpu->Flags);
+	for (int i = 0; i < 8; i++)
+	{
+		Buffer[o++] = (mem->Clock >> (i * 8)) & 0xFF;
+	}
+	Buffer[o++] = mem->IrqLines;
+	Buffer[o++] = mem->NmiPending;
+	Buffer[o++] = mem->Mapper ? mem->Mapper->NumSlots : 0;
+	for (int i = 0; mem->Mapper && i < mem->Mapper->NumSlots; i++)
+	{
+		PutWord(Buffer + o, (word)mem->Mapper->Slots[i].Bank);
+		o += 2;
+	}
+	PutWord(Buffer + 8, (word)(o - 10));	// register block size, newer readers may append fields
+
+	if (!Compress)
+	{
+		memcpy(Buffer + o, mem->Data, MAX_MEM);
+		return o + MAX_MEM;
+	}
+
+	for (int p = 0; p < NUM_PAGES; p++)
+	{
+		const byte* Data = &mem->Data[p << 8];
+		if (IsZeroPage(Data))
+		{
+			Buffer[o++] = RECORD_ZERO;
+			continue;
+		}
+
+		const size_t Size = CompressPage(Data, Page);
+		if (Size)
+		{
+			Buffer[o++] = RECORD_LZ;
+			PutWord(Buffer + o, (word)Size);
+			memcpy(Buffer + o + 2, Page, Size);
+			o += 2 + Size;
+		}
+		else
+		{
+			Buffer[o++] = RECORD_RAW;
+			memcpy(Buffer + o, Data, PAGE_SIZE);
+			o += PAGE_SIZE;
+		}
+	}
+	return o;
+}
+
+// Decodes straight into mem page by page. Devices, breakpoints, scheduler events and the
+// mapper are host configuration and are left as they are, only the selected banks are
+// restored. The state is checked as a whole first, a truncated or corrupt one changes
+// nothing. False for one of those, or if the state's slots don't match the mapper attached
+// to mem, or its banks are writable.
+bool LoadState(struct CPU* cpu, struct memory* mem, const byte* Buffer, const size_t Size)
+{
+	if (Size < 10 || memcmp(Buffer, SAVESTATE_MAGIC, 4) || GetWord(Buffer + 4) != SAVESTATE_VERSION)
+	{
+		return false;
+	}
+
+	const bool Compressed = GetWord(Buffer + 6) & SAVESTATE_COMPRESSED;
+	const size_t Registers = GetWord(Buffer + 8);
+	const byte* Block = Buffer + 10;
+	if (10 + Registers > Size || Registers < 7 + sizeof(cpu->Flags) + 10 || Block[6] != sizeof(cpu->Flags))
+	{
+		return false;
+	}
+
+	const size_t BankBlock = 7 + sizeof(cpu->Flags) + 10;		// absent in states written before banks were saved
+	const int NumSlots = Registers > BankBlock ? Block[BankBlock] : 0;
+	if ((mem->Mapper ? mem->Mapper->NumSlots : 0) != NumSlots || (NumSlots && Registers < BankBlock + 1 + 2 * (size_t)NumSlots)
+		|| (mem->Mapper && mem->Mapper->Writable))
+	{
+		return false;
+	}
+	const size_t p = 10 + Registers;
+	if (Compressed ? !DecodePages(Buffer, Size, p, NULL) : p + MAX_MEM > Size)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < NumSlots; i++)
+	{
+		SwitchBank(mem->Mapper, i, GetWord(Block + BankBlock + 1 + 2 * i));
+	}
+
+	cpu->pc = GetWord(Block);
+	cpu->sp = Block[2];
+	cpu->acc = Block[3];
+	cpu->x = Block[4];
+	cpu->y = Block[5];
+	memcpy(cpu->Flags, Block + 7, sizeof(cpu->Flags));
+	Block += 7 + sizeof(cpu->Flags);
+	mem->Clock = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		mem->Clock |= (uint64_t)Block[i] << (i * 8);
+	}
+	mem->IrqLines = Block[8];
+	mem->NmiPending = Block[9];
+
+	if (Compressed)
+	{
+		DecodePages(Buffer, Size, p, mem->Data);
+	}
+	else
+	{
+		memcpy(mem->Data, Buffer + p, MAX_MEM);
+	}
+	RehashMemory(mem);
+	return true;
+}
+
+bool SaveStateFile(const struct CPU* cpu, const struct memory* mem, const char* Path, const bool Compress)
+{
+	byte* Buffer = (byte*)malloc(SAVESTATE_MAX_SIZE);
+	if (!Buffer)
+	{
+		return false;
+	}
+
+	const size_t Size = SaveState(cpu, mem, Buffer, SAVESTATE_MAX_SIZE, Compress);
+	FILE* File = fopen(Path, "wb");
+	bool Saved = File && Size && fwrite(Buffer, 1, Size, File) == Size;
+	if (File && fclose(File))
+	{
+		Saved = false;
+	}
+
+	free(Buffer);
+	return Saved;
+}
+
+// Maps the file read-only and decodes from the mapping, an uncompressed state costs one memcpy
+bool LoadStateFile(struct CPU* cpu, struct memory* mem, const char* Path)
+{
+#ifdef _WIN32
+	FILE* File = fopen(Path, "rb");
+	if (!File)
+	{
+		return false;
+	}
+	byte* Buffer = (byte*)malloc(SAVESTATE_MAX_SIZE);
+	const size_t Size = Buffer ? fread(Buffer, 1, SAVESTATE_MAX_SIZE, File) : 0;
+	fclose(File);
+
+	const bool Loaded = Size && LoadState(cpu, mem, Buffer, Size);
+	free(Buffer);
+	return Loaded;
+#else
+	const int File = open(Path, O_RDONLY);
+	struct stat Info;
+	if (File < 0)
+	{
+		return false;
+	}
+	if (fstat(File, &Info) || Info.st_size <= 0)
+	{
+		close(File);
+		return false;
+	}
+
+	void* Mapping = mmap(NULL, Info.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+	close(File);
+	if (Mapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const bool Loaded = LoadState(cpu, mem, (const byte*)Mapping, Info.st_size);
+	munmap(Mapping, Info.st_size);
+	return Loaded;
+#endif
+}
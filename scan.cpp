@@ -0,0 +1,388 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>			// before 6502.h, like the standard headers
+#define SIMD_X86
+#endif
+#include "6502.h"
+
+#define SCAN_BLOCK 64			// addresses per candidate word and per kernel call
+
+// Bit i is set if the pattern's two anchor bytes match at p + i
+typedef uint64_t (*AnchorFunction)(const byte*, const int, const byte, const int, const byte);
+// Bit i is set if Now[i] passes the filter
+typedef uint64_t (*FilterFunction)(const byte*, const byte*, const int, const byte);
+
+
+static int LowestBit(const uint64_t Bits)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(Bits);
+#else
+	int Bit = 0;
+	while (!((Bits >> Bit) & 1))
+	{
+		Bit++;
+	}
+	return Bit;
+#endif
+}
+
+static int CountBits(uint64_t Bits)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(Bits);
+#else
+	int Count = 0;
+	for (; Bits; Bits &= Bits - 1)
+	{
+		Count++;
+	}
+	return Count;
+#endif
+}
+
+static int HexDigit(const char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+// "A9 ?? 8D 00 ??": two hex digits per byte, "??" for any byte, spaces optional
+bool ParsePattern(struct scan_pattern* Pattern, const char* Text)
+{
+	Pattern->Length = 0;
+	while (*Text)
+	{
+		if (*Text == ' ')
+		{
+			Text++;
+			continue;
+		}
+		if (Pattern->Length == SCAN_MAX_PATTERN || !Text[1])
+		{
+			return false;
+		}
+
+		const int High = HexDigit(Text[0]);
+		const int Low = HexDigit(Text[1]);
+		if (Text[0] == '?' && Text[1] == '?')
+		{
+			Pattern->Bytes[Pattern->Length] = 0;
+			Pattern->Mask[Pattern->Length] = 0x00;
+		}
+		else if (High >= 0 && Low >= 0)
+		{
+			Pattern->Bytes[Pattern->Length] = (byte)(High << 4 | Low);
+			Pattern->Mask[Pattern->Length] = 0xFF;
+		}
+		else
+		{
+			return false;
+		}
+		Pattern->Length++;
+		Text += 2;
+	}
+	return Pattern->Length > 0;
+}
+
+static bool Matches(const int Filter, const byte Now, const byte Before, const byte Value)
+{
+	switch (Filter)
+	{
+	case SCAN_EQUAL: return Now == Value;
+	case SCAN_NOT_EQUAL: return Now != Value;
+	case SCAN_CHANGED: return Now != Before;
+	case SCAN_UNCHANGED: return Now == Before;
+	case SCAN_INCREASED: return Now > Before;
+	case SCAN_DECREASED: return Now < Before;
+	}
+	return false;
+}
+
+static uint64_t AnchorScalar(const byte* p, const int First, const byte FirstValue, const int Last, const byte LastValue)
+{
+	uint64_t Mask = 0;
+	for (int i = 0; i < SCAN_BLOCK; i++)
+	{
+		if (p[i + First] == FirstValue && p[i + Last] == LastValue)
+		{
+			Mask |= 1ull << i;
+		}
+	}
+	return Mask;
+}
+
+static uint64_t FilterScalar(const byte* Now, const byte* Before, const int Filter, const byte Value)
+{
+	uint64_t Mask = 0;
+	for (int i = 0; i < SCAN_BLOCK; i++)
+	{
+		if (Matches(Filter, Now[i], Before[i], Value))
+		{
+			Mask |= 1ull << i;
+		}
+	}
+	return Mask;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("sse2"))) static uint64_t AnchorSse2(const byte* p, const int First, const byte FirstValue, const int Last, const byte LastValue)
+{
+	const __m128i a = _mm_set1_epi8((char)FirstValue);
+	const __m128i b = _mm_set1_epi8((char)LastValue);
+	uint64_t Mask = 0;
+	for (int i = 0; i < SCAN_BLOCK; i += 16)
+	{
+		const __m128i x = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + First)), a);
+		const __m128i y = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + Last)), b);
+		Mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_and_si128(x, y)) << i;
+	}
+	return Mask;
+}
+
+// Bytes that pass are 0xFF. Unsigned compares go through min/max: Now > Before when
+// max(Now, Before) isn't Before.
+__attribute__((target("sse2"))) static __m128i FilterVectorSse2(const __m128i Now, const __m128i Before, const int Filter, const __m128i Value)
+{
+	const __m128i Ones = _mm_set1_epi8(-1);
+	switch (Filter)
+	{
+	case SCAN_EQUAL: return _mm_cmpeq_epi8(Now, Value);
+	case SCAN_NOT_EQUAL: return _mm_xor_si128(_mm_cmpeq_epi8(Now, Value), Ones);
+	case SCAN_CHANGED: return _mm_xor_si128(_mm_cmpeq_epi8(Now, Before), Ones);
+	case SCAN_UNCHANGED: return _mm_cmpeq_epi8(Now, Before);
+	case SCAN_INCREASED: return _mm_xor_si128(_mm_cmpeq_epi8(_mm_max_epu8(Now, Before), Before), Ones);
+	case SCAN_DECREASED: return _mm_xor_si128(_mm_cmpeq_epi8(_mm_min_epu8(Now, Before), Before), Ones);
+	}
+	return _mm_setzero_si128();
+}
+
+__attribute__((target("sse2"))) static uint64_t FilterSse2(const byte* Now, const byte* Before, const int Filter, const byte Value)
+{
+	const __m128i v = _mm_set1_epi8((char)Value);
+	uint64_t Mask = 0;
+	for (int i = 0; i < SCAN_BLOCK; i += 16)
+	{
+		const __m128i x = _mm_loadu_si128((const __m128i*)(Now + i));
+		const __m128i y = _mm_loadu_si128((const __m128i*)(Before + i));
+		Mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(FilterVectorSse2(x, y, Filter, v)) << i;
+	}
+	return Mask;
+}
+
+__attribute__((target("avx2"))) static uint64_t AnchorAvx2(const byte* p, const int First, const byte FirstValue, const int Last, const byte LastValue)
+{
+	const __m256i a = _mm256_set1_epi8((char)FirstValue);
+	const __m256i b = _mm256_set1_epi8((char)LastValue);
+	uint64_t Mask = 0;
+	for (int i = 0; i < SCAN_BLOCK; i += 32)
+	{
+		const __m256i x = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + First)), a);
+		const __m256i y = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + Last)), b);
+		Mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_and_si256(x, y)) << i;
+	}
+	return Mask;
+}
+
+__attribute__((target("avx2"))) static __m256i FilterVectorAvx2(const __m256i Now, const __m256i Before, const int Filter, const __m256i Value)
+{
+	const __m256i Ones = _mm256_set1_epi8(-1);
+	switch (Filter)
+	{
+	case SCAN_EQUAL: return _mm256_cmpeq_epi8(Now, Value);
+	case SCAN_NOT_EQUAL: return _mm256_xor_si256(_mm256_cmpeq_epi8(Now, Value), Ones);
+	case SCAN_CHANGED: return _mm256_xor_si256(_mm256_cmpeq_epi8(Now, Before), Ones);
+	case SCAN_UNCHANGED: return _mm256_cmpeq_epi8(Now, Before);
+	case SCAN_INCREASED: return _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(Now, Before), Before), Ones);
+	case SCAN_DECREASED: return _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(Now, Before), Before), Ones);
+	}
+	return _mm256_setzero_si256();
+}
+
+__attribute__((target("avx2"))) static uint64_t FilterAvx2(const byte* Now, const byte* Before, const int Filter, const byte Value)
+{
+	const __m256i v = _mm256_set1_epi8((char)Value);
+	uint64_t Mask = 0;
+	for (int i = 0; i < SCAN_BLOCK; i += 32)
+	{
+		const __m256i x = _mm256_loadu_si256((const __m256i*)(Now + i));
+		const __m256i y = _mm256_loadu_si256((const __m256i*)(Before + i));
+		Mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(FilterVectorAvx2(x, y, Filter, v)) << i;
+	}
+	return Mask;
+}
+#endif
+
+static AnchorFunction AnchorKernel()
+{
+#ifdef SIMD_X86
+	const int Level = SimdLevel();
+	if (Level == SIMD_AVX2)
+	{
+		return AnchorAvx2;
+	}
+	if (Level == SIMD_SSE2)
+	{
+		return AnchorSse2;
+	}
+#endif
+	return AnchorScalar;
+}
+
+static FilterFunction FilterKernel()
+{
+#ifdef SIMD_X86
+	const int Level = SimdLevel();
+	if (Level == SIMD_AVX2)
+	{
+		return FilterAvx2;
+	}
+	if (Level == SIMD_SSE2)
+	{
+		return FilterSse2;
+	}
+#endif
+	return FilterScalar;
+}
+
+static bool PatternAt(const byte* Data, const struct scan_pattern* Pattern)
+{
+	for (int i = 0; i < Pattern->Length; i++)
+	{
+		if ((Data[i] ^ Pattern->Bytes[i]) & Pattern->Mask[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static int AddMatch(struct scan_match* Matches, const int Max, const int Found, const int Instance, const int Address)
+{
+	if (Found < Max)
+	{
+		Matches[Found].Instance = Instance;
+		Matches[Found].Address = Address;
+	}
+	return Found + 1;
+}
+
+// Data, or what the CPU sees in View if banks are mapped in
+static const byte* Visible(const struct memory* mem, byte* View)
+{
+	if (!mem->Mapper)
+	{
+		return mem->Data;
+	}
+	MapperView(mem, View);
+	return View;
+}
+
+// Every address in every instance the pattern starts at, without wrapping past 0xFFFF. The
+// first and the last exact byte are compared 64 addresses at a time, only their common hits
+// are checked in full. Returns the number of matches, only the first Max are stored.
+int FindPattern(const struct memory* const* Instances, const int NumInstances, const struct scan_pattern* Pattern,
+	struct scan_match* Matches, const int Max)
+{
+	const AnchorFunction Anchor = AnchorKernel();
+	int First = -1;
+	int Last = -1;
+	for (int i = 0; i < Pattern->Length; i++)
+	{
+		if (Pattern->Mask[i] == 0xFF)
+		{
+			First = First < 0 ? i : First;
+			Last = i;
+		}
+	}
+
+	int Found = 0;
+	const int End = MAX_MEM - Pattern->Length + 1;		// one past the last start address
+	byte View[MAX_MEM];
+	for (int Instance = 0; Instance < NumInstances; Instance++)
+	{
+		const byte* Data = Visible(Instances[Instance], View);
+		int Address = 0;
+		if (First >= 0)
+		{
+			for (; Address + SCAN_BLOCK + Pattern->Length <= MAX_MEM; Address += SCAN_BLOCK)
+			{
+				for (uint64_t Hits = Anchor(Data + Address, First, Pattern->Bytes[First], Last, Pattern->Bytes[Last]); Hits; Hits &= Hits - 1)
+				{
+					const int Hit = Address + LowestBit(Hits);
+					if (PatternAt(Data + Hit, Pattern))
+					{
+						Found = AddMatch(Matches, Max, Found, Instance, Hit);
+					}
+				}
+			}
+		}
+		for (; Address < End; Address++)
+		{
+			if (PatternAt(Data + Address, Pattern))
+			{
+				Found = AddMatch(Matches, Max, Found, Instance, Address);
+			}
+		}
+	}
+	return Found;
+}
+
+// Every address is a candidate and the snapshot is taken from mem
+void StartScan(struct scan* Scan, const struct memory* mem)
+{
+	memset(Scan->Candidates, 0xFF, sizeof(Scan->Candidates));
+	Scan->Count = MAX_MEM;
+	byte View[MAX_MEM];
+	memcpy(Scan->Snapshot, Visible(mem, View), MAX_MEM);
+}
+
+// Keeps the candidates whose byte in mem passes Filter, then takes the next snapshot. mem
+// doesn't have to be the instance the scan started on, the change filters then compare
+// two instances. Returns the candidates left.
+uint32_t FilterScan(struct scan* Scan, const struct memory* mem, const int Filter, const byte Value)
+{
+	const FilterFunction Kernel = FilterKernel();
+	byte View[MAX_MEM];
+	const byte* Data = Visible(mem, View);
+	uint32_t Count = 0;
+	for (int Block = 0; Block < MAX_MEM / SCAN_BLOCK; Block++)
+	{
+		if (Scan->Candidates[Block])
+		{
+			Scan->Candidates[Block] &= Kernel(&Data[Block * SCAN_BLOCK], &Scan->Snapshot[Block * SCAN_BLOCK], Filter, Value);
+			Count += CountBits(Scan->Candidates[Block]);
+		}
+	}
+	memcpy(Scan->Snapshot, Data, MAX_MEM);
+	Scan->Count = Count;
+	return Count;
+}
+
+// Candidate addresses in order, returns how many there are, only the first Max are stored
+int ScanResults(const struct scan* Scan, word* Addresses, const int Max)
+{
+	int Found = 0;
+	for (int Block = 0; Block < MAX_MEM / SCAN_BLOCK; Block++)
+	{
+		for (uint64_t Bits = Scan->Candidates[Block]; Bits; Bits &= Bits - 1)
+		{
+			if (Found < Max)
+			{
+				Addresses[Found] = Block * SCAN_BLOCK + LowestBit(Bits);
+			}
+			Found++;
+		}
+	}
+	return Found;
+}
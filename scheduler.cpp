@@ -0,0 +1,87 @@
+#include "6502.h"
+
+
+static void UpdateNextEvent(struct memory* mem)
+{
+	mem->NextEvent = NO_EVENT;
+	for (int i = 0; i < MAX_EVENTS; i++)
+	{
+		if (mem->Events[i].Handler && mem->Events[i].When < mem->NextEvent)
+		{
+			mem->NextEvent = mem->Events[i].When;
+		}
+	}
+}
+
+void YieldToScheduler(struct memory* mem)
+{
+	mem->Deadline = 0;	// the running slice ends after the current instruction
+}
+
+int ScheduleEvent(struct memory* mem, const uint64_t When, EventHandler Handler, void* Context)
+{
+	for (int i = 0; i < MAX_EVENTS; i++)
+	{
+		if (!mem->Events[i].Handler)
+		{
+			mem->Events[i].When = When;
+			mem->Events[i].Handler = Handler;
+			mem->Events[i].Context = Context;
+
+			if (When < mem->NextEvent)
+			{
+				mem->NextEvent = When;
+			}
+			if (When < mem->Deadline)
+			{
+				mem->Deadline = When;
+			}
+			return i;
+		}
+	}
+	return -1;
+}
+
+void CancelEvent(struct memory* mem, const int Slot)
+{
+	if (Slot < 0 || Slot >= MAX_EVENTS)
+	{
+		return;
+	}
+	mem->Events[Slot].Handler = NULL;
+	UpdateNextEvent(mem);
+}
+
+void RunDueEvents(struct memory* mem, const uint64_t Now)
+{
+	while (mem->NextEvent <= Now)
+	{
+		for (int i = 0; i < MAX_EVENTS; i++)
+		{
+			struct event Event = mem->Events[i];
+			if (Event.Handler && Event.When <= Now)
+			{
+				mem->Events[i].Handler = NULL;		// the handler may reschedule itself into this slot
+				Event.Handler(mem, Now, Event.Context);
+			}
+		}
+		UpdateNextEvent(mem);
+	}
+}
+
+void AssertIrq(struct memory* mem, const byte Source)
+{
+	mem->IrqLines |= Source;
+	YieldToScheduler(mem);
+}
+
+void ReleaseIrq(struct memory* mem, const byte Source)
+{
+	mem->IrqLines &= ~Source;
+}
+
+void TriggerNmi(struct memory* mem)
+{
+	mem->NmiPending = 1;
+	YieldToScheduler(mem);
+}
@@ -0,0 +1,244 @@
+#include "6502.h"
+#include <stddef.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(struct shared_header) <= SHARED_HEADER_SIZE, "the header has to fit its page");
+
+#define SHARED_FRAMES_SIZE (2 * MAX_MEM)
+
+
+// Creates and maps the segment, mem inside it is all zero. Name is a POSIX shared memory name
+// ("/something") viewers can open; NULL makes an anonymous memfd, which viewers get as the
+// descriptor itself (passed over a socket, or /proc/<pid>/fd/<Fd>). The size is sealed where
+// memfds allow it, so no viewer can truncate the segment under the emulator.
+bool CreateSharedMemory(struct shared_memory* Shared, const char* Name)
+{
+	memset(Shared, 0, sizeof(*Shared));
+	Shared->Fd = -1;
+#ifdef _WIN32
+	(void)Name;
+	return false;
+#else
+	const long PageSize = sysconf(_SC_PAGESIZE);
+	Shared->Size = (SHARED_HEADER_SIZE + SHARED_FRAMES_SIZE + sizeof(struct memory) + PageSize - 1) & ~(size_t)(PageSize - 1);
+	if (Name)
+	{
+		if (strlen(Name) >= sizeof(Shared->Name))
+		{
+			return false;
+		}
+		strcpy(Shared->Name, Name);
+		Shared->Fd = shm_open(Name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	}
+	else
+	{
+#ifdef MFD_ALLOW_SEALING
+		Shared->Fd = memfd_create("h6502", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#endif
+	}
+	if (Shared->Fd < 0 || ftruncate(Shared->Fd, Shared->Size))
+	{
+		DestroySharedMemory(Shared);
+		return false;
+	}
+#ifdef F_SEAL_SHRINK
+	if (!Name)
+	{
+		fcntl(Shared->Fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+	}
+#endif
+
+	void* Mapping = mmap(NULL, Shared->Size, PROT_READ | PROT_WRITE, MAP_SHARED, Shared->Fd, 0);
+	if (Mapping == MAP_FAILED)
+	{
+		DestroySharedMemory(Shared);
+		return false;
+	}
+	Shared->Mapping = (byte*)Mapping;
+	Shared->mem = (struct memory*)(Shared->Mapping + SHARED_HEADER_SIZE + SHARED_FRAMES_SIZE);
+
+	struct shared_header* Header = (struct shared_header*)Shared->Mapping;
+	Header->Version = SHARED_VERSION;
+	Header->DataOffset = SHARED_HEADER_SIZE + SHARED_FRAMES_SIZE + offsetof(struct memory, Data);
+	Header->DataSize = MAX_MEM;
+	Header->Interval = SHARED_INTERVAL;
+	for (int i = 0; i < 2; i++)
+	{
+		Header->Frames[i].DataOffset = SHARED_HEADER_SIZE + i * MAX_MEM;
+	}
+	memcpy(Header->Magic, SHARED_MAGIC, 4);	// last, a viewer polling for it sees the rest
+	return true;
+#endif
+}
+
+// After ResetCpu(), which detaches it like the other attachments. Publishes the state right
+// away and then every Interval cycles, 0 takes SHARED_INTERVAL.
+void AttachSharedMemory(struct shared_memory* Shared, const struct CPU* cpu, const uint64_t Interval)
+{
+	struct shared_header* Header = (struct shared_header*)Shared->Mapping;
+	Header->Interval = Interval ? Interval : SHARED_INTERVAL;
+	Shared->mem->Shared = Header;
+	PublishShared(cpu, Shared->mem);
+}
+
+// Viewers keep their mappings, a named segment is unlinked
+void DestroySharedMemory(struct shared_memory* Shared)
+{
+#ifndef _WIN32
+	if (Shared->Mapping)
+	{
+		munmap(Shared->Mapping, Shared->Size);
+	}
+	if (Shared->Fd >= 0)
+	{
+		close(Shared->Fd);
+		if (Shared->Name[0])
+		{
+			shm_unlink(Shared->Name);
+		}
+	}
+#endif
+	memset(Shared, 0, sizeof(*Shared));
+	Shared->Fd = -1;
+}
+
+// Copies the state as of cycle Now into the older frame, which becomes the newest. The release
+// fence keeps the copy after the odd Generation, the release stores keep it before the even one
+// and the frame before Published.
+static void Publish(const struct CPU* cpu, struct memory* mem, const uint64_t Now)
+{
+	struct shared_header* Header = mem->Shared;
+#ifndef _WIN32
+	const uint64_t Published = __atomic_load_n(&Header->Published, __ATOMIC_RELAXED);
+	struct shared_frame* Frame = &Header->Frames[(Published + 1) & 1];
+	const uint64_t Generation = __atomic_load_n(&Frame->Generation, __ATOMIC_RELAXED);
+	__atomic_store_n(&Frame->Generation, Generation + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy((byte*)Header + Frame->DataOffset, mem->Data, MAX_MEM);
+	Frame->Clock = Now;
+	Frame->cpu = *cpu;
+	__atomic_store_n(&Frame->Generation, Generation + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&Header->Published, Published + 1, __ATOMIC_RELEASE);
+#else
+	(void)cpu;
+#endif
+	Header->NextPublish = Now + Header->Interval;
+}
+
+// Between Execute() calls, for host stores viewers should see before the next interval is up
+void PublishShared(const struct CPU* cpu, struct memory* mem)
+{
+	Publish(cpu, mem, mem->Clock);
+}
+
+// Slice boundary hook, publishes once an interval is up. Returns the cycle the next publish is
+// due at so the dispatch loop stops there.
+uint64_t SharedTick(const struct CPU* cpu, struct memory* mem, const uint64_t Now)
+{
+	if (Now >= mem->Shared->NextPublish)
+	{
+		Publish(cpu, mem, Now);
+	}
+	return mem->Shared->NextPublish;
+}
+
+// Maps a segment read only, by Name or, if Name is NULL, through Fd (which stays the caller's).
+// False if it isn't a segment of this build's layout.
+bool OpenSharedView(struct shared_view* View, const char* Name, const int Fd)
+{
+	memset(View, 0, sizeof(*View));
+	View->Fd = -1;
+#ifdef _WIN32
+	(void)Name;
+	(void)Fd;
+	return false;
+#else
+	View->Fd = Name ? shm_open(Name, O_RDONLY, 0) : dup(Fd);
+	struct stat Status;
+	if (View->Fd < 0 || fstat(View->Fd, &Status) || (size_t)Status.st_size < SHARED_HEADER_SIZE + SHARED_FRAMES_SIZE + sizeof(struct memory))
+	{
+		CloseSharedView(View);
+		return false;
+	}
+	View->Size = Status.st_size;
+
+	void* Mapping = mmap(NULL, View->Size, PROT_READ, MAP_SHARED, View->Fd, 0);
+	if (Mapping == MAP_FAILED)
+	{
+		CloseSharedView(View);
+		return false;
+	}
+	View->Mapping = (const byte*)Mapping;
+	View->Header = (const struct shared_header*)View->Mapping;
+	if (memcmp(View->Header->Magic, SHARED_MAGIC, 4) || View->Header->Version != SHARED_VERSION
+		|| View->Header->DataOffset + (size_t)View->Header->DataSize > View->Size
+		|| View->Header->Frames[0].DataOffset + (size_t)View->Header->DataSize > View->Size
+		|| View->Header->Frames[1].DataOffset + (size_t)View->Header->DataSize > View->Size)
+	{
+		CloseSharedView(View);
+		return false;
+	}
+	View->Data = View->Mapping + View->Header->DataOffset;
+	return true;
+#endif
+}
+
+void CloseSharedView(struct shared_view* View)
+{
+#ifndef _WIN32
+	if (View->Mapping)
+	{
+		munmap((void*)View->Mapping, View->Size);
+	}
+	if (View->Fd >= 0)
+	{
+		close(View->Fd);
+	}
+#endif
+	memset(View, 0, sizeof(*View));
+	View->Fd = -1;
+}
+
+// Copies Data (Header->DataSize bytes), the registers and the clock of the newest frame. One
+// attempt, false if the emulator got around to rewriting the frame meanwhile: the caller
+// retries, the emulator doesn't wait. cpu and Clock may be NULL.
+bool SharedSnapshot(const struct shared_view* View, byte* Data, struct CPU* cpu, uint64_t* Clock)
+{
+#ifdef _WIN32
+	(void)View;
+	(void)Data;
+	(void)cpu;
+	(void)Clock;
+	return false;
+#else
+	const struct shared_frame* Frame = &View->Header->Frames[__atomic_load_n(&View->Header->Published, __ATOMIC_ACQUIRE) & 1];
+	const uint64_t Before = __atomic_load_n(&Frame->Generation, __ATOMIC_ACQUIRE);
+	if ((Before & 1) || !Before)
+	{
+		return false;			// being written, or nothing published yet
+	}
+	memcpy(Data, View->Mapping + Frame->DataOffset, View->Header->DataSize);
+	const struct CPU Registers = Frame->cpu;
+	const uint64_t Now = Frame->Clock;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&Frame->Generation, __ATOMIC_RELAXED) != Before)
+	{
+		return false;
+	}
+	if (cpu)
+	{
+		*cpu = Registers;
+	}
+	if (Clock)
+	{
+		*Clock = Now;
+	}
+	return true;
+#endif
+}
@@ -0,0 +1,38 @@
+#include "6502.h"
+
+static int Level = -1;			// SIMD_LEVEL in use, -1 until the first kernel asks
+
+
+static int BestSimdLevel()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return SIMD_AVX2;
+	}
+	if (__builtin_cpu_supports("sse2"))
+	{
+		return SIMD_SSE2;
+	}
+#endif
+	return SIMD_SCALAR;
+}
+
+int SimdLevel()
+{
+	if (Level < 0)
+	{
+		Level = BestSimdLevel();
+	}
+	return Level;
+}
+
+// Caps the kernels at Wanted, or at what the host supports if that is less. Returns the
+// level in effect. There is no reason to call it other than testing the fallbacks.
+int SetSimdLevel(const int Wanted)
+{
+	const int Best = BestSimdLevel();
+	Level = Wanted < Best ? Wanted : Best;
+	return Level;
+}
@@ -0,0 +1,285 @@
+#include "6502.h"
+
+#define STATS_PROBES 8		// linear probes before a 3-gram is dropped
+
+enum ADDRESSING
+{
+	MODE_NONE = 0,
+	MODE_ZP,
+	MODE_ZPX,
+	MODE_ZPY,
+	MODE_ABS,
+	MODE_ABSX,
+	MODE_ABSY,
+	MODE_INDX,
+	MODE_INDY,
+	MODE_IND,
+	MODE_BRANCH
+};
+
+
+// Data addressing mode of an opcode, MODE_NONE for implied, immediate, stack and jumps
+// that don't read memory
+static int Addressing(const byte Opcode)
+{
+	switch (Opcode)
+	{
+	case LDA_ZP: case LDX_ZP: case LDY_ZP: case STA_ZP: case STX_ZP: case STY_ZP:
+	case AND_ZP: case OR_ZP: case EOR_ZP:
+	{
+		return MODE_ZP;
+	}
+	case LDA_ZPX: case LDY_ZPX: case STA_ZPX: case STY_ZPX:
+	case AND_ZPX: case OR_ZPX: case EOR_ZPX:
+	{
+		return MODE_ZPX;
+	}
+	case LDX_ZPY: case STX_ZPY:
+	{
+		return MODE_ZPY;
+	}
+	case LDA_ABS: case LDX_ABS: case LDY_ABS: case STA_ABS: case STX_ABS: case STY_ABS:
+	case AND_ABS: case OR_ABS: case EOR_ABS:
+	{
+		return MODE_ABS;
+	}
+	case LDA_ABSX: case LDY_ABSX: case STA_ABSX:
+	case AND_ABSX: case OR_ABSX: case EOR_ABSX:
+	{
+		return MODE_ABSX;
+	}
+	case LDA_ABSY: case LDX_ABSY: case STA_ABSY:
+	case AND_ABSY: case OR_ABSY: case EOR_ABSY:
+	{
+		return MODE_ABSY;
+	}
+	case LDA_INDX: case STA_INDX: case AND_INDX: case OR_INDX: case EOR_INDX:
+	{
+		return MODE_INDX;
+	}
+	case LDA_INDY: case STA_INDY: case AND_INDY: case OR_INDY: case EOR_INDY:
+	{
+		return MODE_INDY;
+	}
+	case JMP_IND:
+	{
+		return MODE_IND;
+	}
+	case BEQ: case BNE:
+	{
+		return MODE_BRANCH;
+	}
+	default:
+	{
+		return MODE_NONE;
+	}
+	}
+}
+
+static byte Peek(const struct memory* mem, const word Address)
+{
+	return mem->PageFlags[Address >> 8] & PAGE_BANK ? MapperRead(mem, Address) : mem->Data[Address];
+}
+
+static word Peek16(const struct memory* mem, const word Address)
+{
+	return Peek(mem, Address) | (Peek(mem, (word)(Address + 1)) << 8);
+}
+
+// Slot holding Key or the free slot it goes into, -1 if its probe run is full
+static int FindTriple(const struct stats* Stats, const uint32_t Key)
+{
+	const uint32_t Slot = (Key * 2654435761u) >> 20;
+	for (int Probe = 0; Probe < STATS_PROBES; Probe++)
+	{
+		const int i = (Slot + Probe) & (STATS_TRIPLES - 1);
+		if (Stats->Triples[i].Key == Key || !Stats->Triples[i].Key)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void CountTriple(struct stats* Stats, const uint32_t Key)
+{
+	const int i = FindTriple(Stats, Key);
+	if (i < 0)
+	{
+		Stats->TriplesDropped++;
+		return;
+	}
+	Stats->Triples[i].Key = Key;
+	Stats->Triples[i].Count++;
+}
+
+static void CountAccess(struct stats* Stats, const int Mode, const word Address)
+{
+	Stats->Pages[Mode][Address >> 8]++;
+	if (Mode == STAT_ZERO_PAGE)
+	{
+		Stats->ZeroPage[Address]++;
+	}
+}
+
+static void CountIndexed(struct stats* Stats, const int Mode, const word Base, const byte Index)
+{
+	Stats->Indexed[Mode]++;
+	if ((Base & 0xFF) + Index > 0xFF)
+	{
+		Stats->PageCrosses[Mode]++;
+	}
+	CountAccess(Stats, Mode, Base + Index);
+}
+
+void AttachStats(struct stats* Stats, struct memory* mem)
+{
+	memset(Stats, 0, sizeof(*Stats));
+	mem->Stats = Stats;
+}
+
+void DetachStats(struct memory* mem)
+{
+	mem->Stats = NULL;
+}
+
+// Called once an opcode is fetched, before it runs: cpu->pc is on the operand. Effective
+// addresses are worked out from the memory array and the mapped-in banks, without touching
+// devices or the cycle count, so collecting doesn't change what the guest sees.
+void CollectStats(const struct CPU* cpu, struct memory* mem, const byte Opcode)
+{
+	struct stats* Stats = mem->Stats;
+	if (Stats->Instructions >= 1)
+	{
+		Stats->Pairs[Stats->Last[1]][Opcode]++;
+	}
+	if (Stats->Instructions >= 2)
+	{
+		CountTriple(Stats, 1u << 24 | Stats->Last[0] << 16 | Stats->Last[1] << 8 | Opcode);
+	}
+	Stats->Last[0] = Stats->Last[1];
+	Stats->Last[1] = Opcode;
+	Stats->Instructions++;
+
+	const byte Operand = Peek(mem, cpu->pc);
+	switch (Addressing(Opcode))
+	{
+	case MODE_ZP:
+	{
+		CountAccess(Stats, STAT_ZERO_PAGE, Operand);
+	} break;
+	case MODE_ZPX:
+	{
+		CountAccess(Stats, STAT_ZERO_PAGE, (byte)(Operand + cpu->x));
+	} break;
+	case MODE_ZPY:
+	{
+		CountAccess(Stats, STAT_ZERO_PAGE, (byte)(Operand + cpu->y));
+	} break;
+	case MODE_ABS:
+	{
+		CountAccess(Stats, STAT_ABSOLUTE, Peek16(mem, cpu->pc));
+	} break;
+	case MODE_ABSX:
+	{
+		CountIndexed(Stats, STAT_ABSOLUTE, Peek16(mem, cpu->pc), cpu->x);
+	} break;
+	case MODE_ABSY:
+	{
+		CountIndexed(Stats, STAT_ABSOLUTE, Peek16(mem, cpu->pc), cpu->y);
+	} break;
+	case MODE_INDX:
+	{
+		const byte Pointer = Operand + cpu->x;
+		CountAccess(Stats, STAT_INDIRECT, Peek(mem, Pointer) | (Peek(mem, (byte)(Pointer + 1)) << 8));
+	} break;
+	case MODE_INDY:
+	{
+		CountIndexed(Stats, STAT_INDIRECT, Peek(mem, Operand) | (Peek(mem, (byte)(Operand + 1)) << 8), cpu->y);
+	} break;
+	case MODE_IND:
+	{
+		CountAccess(Stats, STAT_INDIRECT, Peek16(mem, cpu->pc));
+	} break;
+	case MODE_BRANCH:
+	{
+		Stats->Branches++;
+		if (cpu->Flags[zeroFlag] == (Opcode == BEQ))
+		{
+			const word Next = cpu->pc + 1;
+			Stats->BranchesTaken++;
+			if (((word)(Next + (int8_t)Operand) >> 8) != (Next >> 8))
+			{
+				Stats->BranchCrosses++;
+			}
+		}
+	} break;
+	}
+}
+
+uint64_t TripleCount(const struct stats* Stats, const byte First, const byte Second, const byte Third)
+{
+	const int i = FindTriple(Stats, 1u << 24 | First << 16 | Second << 8 | Third);
+	return i < 0 ? 0 : Stats->Triples[i].Count;
+}
+
+// One CSV record per non-zero counter:
+//
+//	instructions,<count>
+//	pair,<op>,<op>,<count>				opcodes in hex
+//	triple,<op>,<op>,<op>,<count>
+//	triples_dropped,<count>
+//	page,<zp|abs|ind>,<page>,<count>
+//	zeropage,<address>,<count>
+//	cross,<zp|abs|ind>,<indexed>,<crossed>
+//	branch,<executed>,<taken>,<crossed>
+bool WriteStats(const struct stats* Stats, FILE* Stream)
+{
+	static const char* ModeNames[STAT_MODE_COUNT] = { "zp", "abs", "ind" };
+
+	fprintf(Stream, "instructions,%llu\n", (unsigned long long)Stats->Instructions);
+	for (int First = 0; First < 256; First++)
+	{
+		for (int Second = 0; Second < 256; Second++)
+		{
+			if (Stats->Pairs[First][Second])
+			{
+				fprintf(Stream, "pair,%02X,%02X,%llu\n", First, Second, (unsigned long long)Stats->Pairs[First][Second]);
+			}
+		}
+	}
+	for (int i = 0; i < STATS_TRIPLES; i++)
+	{
+		const struct stats_triple* Triple = &Stats->Triples[i];
+		if (Triple->Key)
+		{
+			fprintf(Stream, "triple,%02X,%02X,%02X,%llu\n", (Triple->Key >> 16) & 0xFF, (Triple->Key >> 8) & 0xFF, Triple->Key & 0xFF,
+				(unsigned long long)Triple->Count);
+		}
+	}
+	fprintf(Stream, "triples_dropped,%llu\n", (unsigned long long)Stats->TriplesDropped);
+	for (int Mode = 0; Mode < STAT_MODE_COUNT; Mode++)
+	{
+		for (int Page = 0; Page < NUM_PAGES; Page++)
+		{
+			if (Stats->Pages[Mode][Page])
+			{
+				fprintf(Stream, "page,%s,%02X,%llu\n", ModeNames[Mode], Page, (unsigned long long)Stats->Pages[Mode][Page]);
+			}
+		}
+	}
+	for (int Address = 0; Address < PAGE_SIZE; Address++)
+	{
+		if (Stats->ZeroPage[Address])
+		{
+			fprintf(Stream, "zeropage,%02X,%llu\n", Address, (unsigned long long)Stats->ZeroPage[Address]);
+		}
+	}
+	for (int Mode = 0; Mode < STAT_MODE_COUNT; Mode++)
+	{
+		fprintf(Stream, "cross,%s,%llu,%llu\n", ModeNames[Mode], (unsigned long long)Stats->Indexed[Mode], (unsigned long long)Stats->PageCrosses[Mode]);
+	}
+	fprintf(Stream, "branch,%llu,%llu,%llu\n", (unsigned long long)Stats->Branches, (unsigned long long)Stats->BranchesTaken,
+		(unsigned long long)Stats->BranchCrosses);
+	return !ferror(Stream);
+}
@@ -0,0 +1,373 @@
+#include "6502.h"
+
+
+static struct snapshot* Snapshot(struct timeline* Timeline, const uint64_t Number)
+{
+	return &Timeline->Snapshots[Number % TIMELINE_SNAPSHOTS];
+}
+
+static void TrackAllPages(struct memory* mem)
+{
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		mem->PageFlags[Page] |= PAGE_TRACK;
+	}
+}
+
+static void DropOldestSnapshot(struct timeline* Timeline)
+{
+	if (Timeline->OldestSnapshot == Timeline->NewestSnapshot)
+	{
+		Timeline->HasSnapshots = false;	// nothing left to rewind to until the next snapshot
+		return;
+	}
+	Timeline->OldestSnapshot++;
+}
+
+static void TakeSnapshot(struct CPU* cpu, struct memory* mem, const uint64_t Now)
+{
+	struct timeline* Timeline = mem->Timeline;
+
+	if (!Timeline->HasSnapshots)
+	{
+		Timeline->OldestSnapshot = Timeline->NewestSnapshot = 0;
+		Timeline->HasSnapshots = true;
+	}
+	else
+	{
+		Timeline->NewestSnapshot++;
+		if (Timeline->NewestSnapshot - Timeline->OldestSnapshot >= TIMELINE_SNAPSHOTS)
+		{
+			Timeline->OldestSnapshot++;
+		}
+	}
+
+	struct snapshot* Newest = Snapshot(Timeline, Timeline->NewestSnapshot);
+	Newest->Cycle = Now;
+	Newest->cpu = *cpu;
+	Newest->IrqLines = mem->IrqLines;
+	Newest->NmiPending = mem->NmiPending;
+	Newest->InputRead = Timeline->Replaying ? Timeline->ReplayRead : Timeline->InputHead;
+	Newest->InputIrq = Timeline->Replaying ? Timeline->ReplayIrq : Timeline->InputHead;
+	Newest->Page = Timeline->PageHead;
+	for (int i = 0; mem->Mapper && i < mem->Mapper->NumSlots; i++)
+	{
+		Newest->Banks[i] = mem->Mapper->Slots[i].Bank;
+	}
+
+	Timeline->NextSnapshot = Now + Timeline->Interval;
+	TrackAllPages(mem);
+}
+
+static uint64_t OldestInput(const struct snapshot* Snapshot)
+{
+	return Snapshot->InputRead < Snapshot->InputIrq ? Snapshot->InputRead : Snapshot->InputIrq;
+}
+
+static void AppendInput(struct timeline* Timeline, const uint64_t Cycle, const word Address, const byte Value, const byte Type)
+{
+	while (Timeline->HasSnapshots && Timeline->InputHead - OldestInput(Snapshot(Timeline, Timeline->OldestSnapshot)) >= TIMELINE_INPUTS)
+	{
+		DropOldestSnapshot(Timeline);
+	}
+
+	struct input* Input = &Timeline->Inputs[Timeline->InputHead++ % TIMELINE_INPUTS];
+	Input->Cycle = Cycle;
+	Input->Address = Address;
+	Input->Value = Value;
+	Input->Type = Type;
+}
+
+// Called from BusWrite on the first write to a page after a snapshot
+void TimelineSavePage(struct memory* mem, const word Address)
+{
+	struct timeline* Timeline = mem->Timeline;
+	const byte Page = Address >> 8;
+
+	mem->PageFlags[Page] &= ~PAGE_TRACK;
+	if (!Timeline || !Timeline->HasSnapshots)
+	{
+		return;
+	}
+
+	while (Timeline->HasSnapshots && Timeline->PageHead - Snapshot(Timeline, Timeline->OldestSnapshot)->Page >= TIMELINE_PAGES)
+	{
+		DropOldestSnapshot(Timeline);
+	}
+
+	const uint64_t Slot = Timeline->PageHead++ % TIMELINE_PAGES;
+	Timeline->PageNumbers[Slot] = Page;
+	memcpy(Timeline->Pages[Slot], &mem->Data[Page << 8], PAGE_SIZE);
+}
+
+void RecordRead(struct memory* mem, const word Address, const byte Data, const uint64_t Now)
+{
+	AppendInput(mem->Timeline, Now, Address, Data, INPUT_READ);
+}
+
+byte ReplayRead(struct memory* mem, const word Address)
+{
+	struct timeline* Timeline = mem->Timeline;
+	while (Timeline->ReplayRead < Timeline->InputHead)
+	{
+		const struct input* Input = &Timeline->Inputs[Timeline->ReplayRead++ % TIMELINE_INPUTS];
+		if (Input->Type == INPUT_READ)
+		{
+			return Input->Value;
+		}
+	}
+	return mem->Data[Address];
+}
+
+// Slice boundary hook: logs or replays interrupt line changes and takes due snapshots.
+// Returns the next cycle the dispatch loop has to come back at.
+uint64_t TimelineTick(struct CPU* cpu, struct memory* mem, const uint64_t Now)
+{
+	struct timeline* Timeline = mem->Timeline;
+	uint64_t Next = NO_EVENT;
+
+	if (Timeline->Replaying && Now >= Timeline->Present)
+	{
+		Timeline->Replaying = false;
+		Timeline->ReplayRead = Timeline->ReplayIrq = Timeline->InputHead;
+		Timeline->LastIrqLines = mem->IrqLines = Timeline->PresentIrqLines;
+		mem->NmiPending = Timeline->PresentNmiPending;
+		if (!DevicesFrozen(mem))
+		{
+			RunDueEvents(mem, Now);
+		}
+	}
+
+	if (Timeline->Replaying)
+	{
+		while (Timeline->ReplayIrq < Timeline->InputHead)
+		{
+			const struct input* Input = &Timeline->Inputs[Timeline->ReplayIrq % TIMELINE_INPUTS];
+			if (Input->Type != INPUT_READ)
+			{
+				if (Input->Cycle > Now)
+				{
+					Next = Input->Cycle;
+					break;
+				}
+				if (Input->Type == INPUT_IRQ)
+				{
+					mem->IrqLines = Input->Value;
+				}
+				else
+				{
+					mem->NmiPending = 1;
+				}
+			}
+			Timeline->ReplayIrq++;
+		}
+		Timeline->LastIrqLines = mem->IrqLines;
+		Next = Timeline->Present < Next ? Timeline->Present : Next;
+	}
+	else
+	{
+		if (mem->IrqLines != Timeline->LastIrqLines)
+		{
+			AppendInput(Timeline, Now, 0, mem->IrqLines, INPUT_IRQ);
+			Timeline->LastIrqLines = mem->IrqLines;
+		}
+		if (mem->NmiPending)
+		{
+			AppendInput(Timeline, Now, 0, 1, INPUT_NMI);
+		}
+		Timeline->Present = Now;
+		Next = DevicesFrozen(mem) ? NO_EVENT : mem->NextEvent;
+	}
+
+	if (Now >= Timeline->NextSnapshot)
+	{
+		TakeSnapshot(cpu, mem, Now);
+	}
+	return Timeline->NextSnapshot < Next ? Timeline->NextSnapshot : Next;
+}
+
+// False with writable banks attached: stores to them don't leave undo pages
+bool AttachTimeline(struct timeline* Timeline, struct CPU* cpu, struct memory* mem, const uint64_t Interval)
+{
+	if (mem->Mapper && mem->Mapper->Writable)
+	{
+		return false;
+	}
+	memset(Timeline, 0, sizeof(*Timeline));
+	Timeline->Interval = Interval;
+	Timeline->LastIrqLines = mem->IrqLines;
+	Timeline->Present = mem->Clock;
+
+	mem->Timeline = Timeline;
+	TakeSnapshot(cpu, mem, mem->Clock);
+	return true;
+}
+
+void DetachTimeline(struct memory* mem)
+{
+	for (int Page = 0; Page < NUM_PAGES; Page++)
+	{
+		mem->PageFlags[Page] &= ~PAGE_TRACK;
+	}
+	mem->Timeline = NULL;
+}
+
+// Rewinds memory through the undo pages of every snapshot newer than Number, newest first
+static void RestoreSnapshot(struct CPU* cpu, struct memory* mem, const uint64_t Number)
+{
+	struct timeline* Timeline = mem->Timeline;
+
+	if (!Timeline->Replaying)
+	{
+		Timeline->Present = mem->Clock;
+		Timeline->PresentIrqLines = mem->IrqLines;
+		Timeline->PresentNmiPending = mem->NmiPending;
+	}
+
+	for (uint64_t Page = Timeline->PageHead; Page > Snapshot(Timeline, Number)->Page; Page--)
+	{
+		const uint64_t Slot = (Page - 1) % TIMELINE_PAGES;
+		const word Base = Timeline->PageNumbers[Slot] << 8;
+		HashRange(mem, Base, PAGE_SIZE);
+		memcpy(&mem->Data[Base], Timeline->Pages[Slot], PAGE_SIZE);
+		HashRange(mem, Base, PAGE_SIZE);
+	}
+
+	const struct snapshot* Restored = Snapshot(Timeline, Number);
+	Timeline->PageHead = Restored->Page;
+	Timeline->NewestSnapshot = Number;
+	Timeline->NextSnapshot = Restored->Cycle + Timeline->Interval;
+	Timeline->ReplayRead = Restored->InputRead;
+	Timeline->ReplayIrq = Restored->InputIrq;
+	Timeline->LastIrqLines = Restored->IrqLines;
+	Timeline->Replaying = Restored->Cycle < Timeline->Present;
+
+	*cpu = Restored->cpu;
+	mem->Clock = Restored->Cycle;
+	mem->IrqLines = Restored->IrqLines;
+	mem->NmiPending = Restored->NmiPending;
+	mem->StopReason = STOP_NONE;
+	for (int i = 0; mem->Mapper && i < mem->Mapper->NumSlots; i++)
+	{
+		if (mem->Mapper->Slots[i].Bank != Restored->Banks[i])
+		{
+			SwitchBank(mem->Mapper, i, Restored->Banks[i]);
+		}
+	}
+	TrackAllPages(mem);
+}
+
+// Newest snapshot taken strictly before Cycle (or at it if Inclusive), -1 if there is none
+static int64_t FindSnapshot(struct timeline* Timeline, const uint64_t Cycle, const bool Inclusive)
+{
+	if (!Timeline->HasSnapshots)
+	{
+		return -1;
+	}
+	for (uint64_t Number = Timeline->NewestSnapshot + 1; Number > Timeline->OldestSnapshot; Number--)
+	{
+		const uint64_t SnapshotCycle = Snapshot(Timeline, Number - 1)->Cycle;
+		if (SnapshotCycle < Cycle || (Inclusive && SnapshotCycle == Cycle))
+		{
+			return Number - 1;
+		}
+	}
+	return -1;
+}
+
+static void RunTo(struct CPU* cpu, struct memory* mem, const uint64_t Target)
+{
+	while (mem->Clock < Target)
+	{
+		Execute(cpu, mem, Target - mem->Clock);
+	}
+}
+
+// Lands on the first instruction boundary at or after Target
+bool SeekToCycle(struct CPU* cpu, struct memory* mem, const uint64_t Target)
+{
+	if (!mem->Timeline)
+	{
+		return false;
+	}
+	if (Target < mem->Clock)
+	{
+		const int64_t Number = FindSnapshot(mem->Timeline, Target, true);
+		if (Number < 0)
+		{
+			return false;
+		}
+		RestoreSnapshot(cpu, mem, Number);
+	}
+	RunTo(cpu, mem, Target);
+	return true;
+}
+
+bool ReverseStep(struct CPU* cpu, struct memory* mem)
+{
+	const uint64_t Now = mem->Clock;
+	if (!mem->Timeline)
+	{
+		return false;
+	}
+
+	const int64_t Number = FindSnapshot(mem->Timeline, Now, false);
+	if (Number < 0)
+	{
+		return false;
+	}
+	RestoreSnapshot(cpu, mem, Number);
+
+	uint64_t Previous = mem->Clock;
+	while (mem->Clock < Now)
+	{
+		Previous = mem->Clock;
+		Execute(cpu, mem, 1);
+	}
+	return SeekToCycle(cpu, mem, Previous);
+}
+
+// Runs backwards to the most recent breakpoint or watchpoint hit before the current cycle
+bool ReverseContinue(struct CPU* cpu, struct memory* mem)
+{
+	const uint64_t Now = mem->Clock;
+	uint64_t End = Now;
+	if (!mem->Timeline)
+	{
+		return false;
+	}
+
+	for (;;)
+	{
+		const int64_t Number = FindSnapshot(mem->Timeline, End, false);
+		if (Number < 0)
+		{
+			SeekToCycle(cpu, mem, Now);
+			return false;
+		}
+		RestoreSnapshot(cpu, mem, Number);
+
+		uint64_t Hit = NO_EVENT;
+		byte Reason = STOP_NONE;
+		word Address = 0;
+		while (mem->Clock < End)
+		{
+			Execute(cpu, mem, End - mem->Clock);
+			if (mem->StopReason && mem->Clock < End)
+			{
+				Hit = mem->Clock;
+				Reason = mem->StopReason;
+				Address = mem->StopAddress;
+			}
+		}
+
+		if (Hit != NO_EVENT)
+		{
+			SeekToCycle(cpu, mem, Hit);
+			mem->StopReason = Reason;
+			mem->StopAddress = Address;
+			return true;
+		}
+		End = Snapshot(mem->Timeline, Number)->Cycle;
+	}
+}
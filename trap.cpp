@@ -0,0 +1,81 @@
+#include "6502.h"
+
+#define TRAP_CALL_CYCLES 12	// JSR + RTS
+
+
+static void UpdateTrapPage(struct memory* mem, const word Address)
+{
+	const int Page = Address >> 8;
+	mem->PageFlags[Page] &= ~PAGE_TRAP;
+
+	for (int i = 0; i < MAX_TRAPS; i++)
+	{
+		if (mem->Traps[i].Handler && (mem->Traps[i].Address >> 8) == Page)
+		{
+			mem->PageFlags[Page] |= PAGE_TRAP;
+		}
+	}
+}
+
+// A JSR to Address calls Handler instead of the guest routine and returns straight to the
+// caller, charging Cost cycles on top of the JSR/RTS pair. The handler sees the CPU with pc
+// already on the return address and may change registers, flags and memory (or pc, to
+// return elsewhere). Handlers run again when the timeline or an input log replays, so they
+// have to be deterministic. Returns the slot, or -1 if the table is full.
+int RegisterTrap(struct memory* mem, const word Address, TrapHandler Handler, const uint32_t Cost, void* Context)
+{
+	int Slot = -1;
+	for (int i = 0; i < MAX_TRAPS; i++)
+	{
+		if (mem->Traps[i].Handler && mem->Traps[i].Address == Address)
+		{
+			Slot = i;
+			break;
+		}
+		if (!mem->Traps[i].Handler && Slot < 0)
+		{
+			Slot = i;
+		}
+	}
+	if (Slot < 0)
+	{
+		return -1;
+	}
+
+	mem->Traps[Slot].Address = Address;
+	mem->Traps[Slot].Handler = Handler;
+	mem->Traps[Slot].Cost = Cost;
+	mem->Traps[Slot].Context = Context;
+	UpdateTrapPage(mem, Address);
+	return Slot;
+}
+
+void ClearTrap(struct memory* mem, const word Address)
+{
+	for (int i = 0; i < MAX_TRAPS; i++)
+	{
+		if (mem->Traps[i].Handler && mem->Traps[i].Address == Address)
+		{
+			memset(&mem->Traps[i], 0, sizeof(mem->Traps[i]));
+		}
+	}
+	UpdateTrapPage(mem, Address);
+}
+
+// Called by JSR once the target is fetched, only for pages with PAGE_TRAP set. Returns false
+// if Address has no trap and the guest routine has to run.
+bool RunTrap(struct CPU* cpu, struct memory* mem, const word Address, size_t* Cycles)
+{
+	for (int i = 0; i < MAX_TRAPS; i++)
+	{
+		const struct trap* Trap = &mem->Traps[i];
+		if (Trap->Handler && Trap->Address == Address)
+		{
+			StopLearning(mem);	// the handler's accesses can't be recorded
+			Trap->Handler(cpu, mem, Trap->Context);
+			*Cycles -= TRAP_CALL_CYCLES - 3 + Trap->Cost;	// the JSR opcode and target are already paid
+			return true;
+		}
+	}
+	return false;
+}
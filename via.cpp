@@ -0,0 +1,177 @@
+#include "6502.h"
+
+#define VIA_IRQ_T1 0x40
+#define VIA_IRQ_T2 0x20
+
+
+static void UpdateViaIrq(struct via* Via, struct memory* mem)
+{
+	if (Via->Ifr & Via->Ier & 0x7F)
+	{
+		Via->Ifr |= 0x80;
+		AssertIrq(mem, Via->IrqSource);
+	}
+	else
+	{
+		Via->Ifr &= 0x7F;
+		ReleaseIrq(mem, Via->IrqSource);
+	}
+}
+
+static word Timer1(const struct via* Via, const uint64_t Now)
+{
+	uint64_t Elapsed = Now - Via->Start1;
+	if (Via->Acr & 0x40)
+	{
+		Elapsed %= (uint64_t)Via->Reload1 + 2;	// free-run: N, N-1, ... 0, 0xFFFF, reload
+	}
+	return (word)(Via->Reload1 - Elapsed);
+}
+
+static word Timer2(const struct via* Via, const uint64_t Now)
+{
+	return (word)(Via->Reload2 - (Now - Via->Start2));
+}
+
+static void Timer1Underflow(struct memory* mem, uint64_t Now, void* Context)
+{
+	(void)Now;
+	struct via* Via = (struct via*)Context;
+	Via->Event1 = -1;
+	Via->Ifr |= VIA_IRQ_T1;
+
+	if (Via->Acr & 0x40)
+	{
+		Via->Start1 += (uint64_t)Via->Reload1 + 2;
+		Via->Reload1 = Via->Latch1;
+		Via->Event1 = ScheduleEvent(mem, Via->Start1 + Via->Reload1 + 1, Timer1Underflow, Via);
+	}
+	UpdateViaIrq(Via, mem);
+}
+
+static void Timer2Underflow(struct memory* mem, uint64_t Now, void* Context)
+{
+	(void)Now;
+	struct via* Via = (struct via*)Context;
+	Via->Event2 = -1;
+	Via->Ifr |= VIA_IRQ_T2;
+	UpdateViaIrq(Via, mem);
+}
+
+static byte ViaRead(struct memory* mem, const word Address, const uint64_t Now, void* Context)
+{
+	struct via* Via = (struct via*)Context;
+	if ((word)(Address - Via->Base) > 0xF)
+	{
+		return mem->Data[Address];
+	}
+
+	switch (Address & 0xF)
+	{
+	case VIA_T1CL:
+	{
+		Via->Ifr &= ~VIA_IRQ_T1;
+		UpdateViaIrq(Via, mem);
+		return Timer1(Via, Now) & 0xFF;
+	}
+	case VIA_T1CH: return Timer1(Via, Now) >> 8;
+	case VIA_T1LL: return Via->Latch1 & 0xFF;
+	case VIA_T1LH: return Via->Latch1 >> 8;
+	case VIA_T2CL:
+	{
+		Via->Ifr &= ~VIA_IRQ_T2;
+		UpdateViaIrq(Via, mem);
+		return Timer2(Via, Now) & 0xFF;
+	}
+	case VIA_T2CH: return Timer2(Via, Now) >> 8;
+	case VIA_ACR: return Via->Acr;
+	case VIA_IFR: return Via->Ifr;
+	case VIA_IER: return Via->Ier | 0x80;
+	default: return mem->Data[Address];
+	}
+}
+
+static void ViaWrite(struct memory* mem, const word Address, const byte Data, const uint64_t Now, void* Context)
+{
+	struct via* Via = (struct via*)Context;
+	if ((word)(Address - Via->Base) > 0xF)
+	{
+		StoreByte(mem, Address, Data);
+		return;
+	}
+
+	switch (Address & 0xF)
+	{
+	case VIA_T1CL:
+	case VIA_T1LL:
+	{
+		Via->Latch1 = (Via->Latch1 & 0xFF00) | Data;
+	} break;
+	case VIA_T1CH:
+	{
+		Via->Latch1 = (Via->Latch1 & 0x00FF) | (Data << 8);
+		Via->Reload1 = Via->Latch1;
+		Via->Start1 = Now;
+		Via->Ifr &= ~VIA_IRQ_T1;
+
+		CancelEvent(mem, Via->Event1);
+		Via->Event1 = ScheduleEvent(mem, Via->Start1 + Via->Reload1 + 1, Timer1Underflow, Via);
+		UpdateViaIrq(Via, mem);
+	} break;
+	case VIA_T1LH:
+	{
+		Via->Latch1 = (Via->Latch1 & 0x00FF) | (Data << 8);
+		Via->Ifr &= ~VIA_IRQ_T1;
+		UpdateViaIrq(Via, mem);
+	} break;
+	case VIA_T2CL:
+	{
+		Via->Latch2 = (Via->Latch2 & 0xFF00) | Data;
+	} break;
+	case VIA_T2CH:
+	{
+		Via->Reload2 = (Via->Latch2 & 0x00FF) | (Data << 8);
+		Via->Start2 = Now;
+		Via->Ifr &= ~VIA_IRQ_T2;
+
+		CancelEvent(mem, Via->Event2);
+		Via->Event2 = ScheduleEvent(mem, Via->Start2 + Via->Reload2 + 1, Timer2Underflow, Via);
+		UpdateViaIrq(Via, mem);
+	} break;
+	case VIA_ACR:
+	{
+		Via->Acr = Data;
+	} break;
+	case VIA_IFR:
+	{
+		Via->Ifr &= ~Data;
+		UpdateViaIrq(Via, mem);
+	} break;
+	case VIA_IER:
+	{
+		if (Data & 0x80)
+		{
+			Via->Ier |= Data & 0x7F;
+		}
+		else
+		{
+			Via->Ier &= ~Data;
+		}
+		UpdateViaIrq(Via, mem);
+	} break;
+	default:
+	{
+		StoreByte(mem, Address, Data);
+	} break;
+	}
+}
+
+void AttachVia(struct via* Via, struct memory* mem, const word Base, const byte IrqSource)
+{
+	memset(Via, 0, sizeof(*Via));
+	Via->Base = Base;
+	Via->IrqSource = IrqSource;
+	Via->Event1 = Via->Event2 = -1;
+
+	AttachDevice(mem, Base, 16, ViaRead, ViaWrite, Via);
+}